@@ -0,0 +1,242 @@
+/**
+ * Throughput of enqueueing and dequeueing 8-byte objects for every kind
+ * of fifo, and of passing them between two threads through `fifo_spsc_t`
+ * and through a bounded fifo under a mutex. Results are printed to stdout
+ * as a single JSON document:
+ *
+ *   {"suite": "fifo", "results": [{"name": "<name>", ...}, ...]}
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sched.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "fifo/fifo.h"
+#include "fifo/fifo_spsc.h"
+
+#define NS_PER_SECOND 1000000000
+
+#define OBJECTS_NUMBER   1000000
+#define SEGMENT_CAPACITY 1024
+
+/* objects kept in the fifo while enqueueing and dequeueing in turn */
+#define STEADY_DEPTH     64
+
+/* of fifos passing objects between threads */
+#define CHANNEL_CAPACITY 1024
+
+typedef fifo_ret_t (* fifo_create_t)(fifo_t ** p_fifo);
+
+static fifo_ret_t create_unbounded(fifo_t ** p_fifo)
+{
+  return FIFO_CREATE_FOR(p_fifo, uint64_t);
+}
+
+static fifo_ret_t create_bounded(fifo_t ** p_fifo)
+{
+  return FIFO_CREATE_BOUNDED_FOR(p_fifo, uint64_t, OBJECTS_NUMBER);
+}
+
+static fifo_ret_t create_segmented(fifo_t ** p_fifo)
+{
+  return FIFO_CREATE_SEGMENTED_FOR(p_fifo, uint64_t, SEGMENT_CAPACITY);
+}
+
+static uint64_t now_ns(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t) now.tv_sec * NS_PER_SECOND + (uint64_t) now.tv_nsec;
+}
+
+static void fail(const char * what)
+{
+  fprintf(stderr, "failed to %s\n", what);
+  exit(EXIT_FAILURE);
+}
+
+static void report(const char * name, const char * kind, size_t ops, uint64_t elapsed_ns)
+{
+  static const char * separator = "";
+
+  double seconds = (double) elapsed_ns / NS_PER_SECOND;
+
+  printf("%s\n  {\"name\": \"%s\", \"kind\": \"%s\", \"ops\": %zu, \"seconds\": %.6g, \"ops_per_sec\": %.6g}",
+         separator, name, kind, ops, seconds, seconds > 0 ? ops / seconds : 0);
+
+  separator = ",";
+}
+
+static void bench_fifo(const char * kind, fifo_create_t create)
+{
+  fifo_t * fifo = NULL;
+
+  uint64_t object = 0;
+
+  if (create(&fifo) != FIFO_SUCCESS) fail("create a fifo");
+
+  uint64_t started_ns = now_ns();
+
+  for (uint64_t i = 0; i < OBJECTS_NUMBER; i++)
+  {
+    if (fifo_enqueue(fifo, &i) != FIFO_SUCCESS) fail("enqueue");
+  }
+
+  report("fifo_enqueue", kind, OBJECTS_NUMBER, now_ns() - started_ns);
+
+  started_ns = now_ns();
+
+  for (size_t i = 0; i < OBJECTS_NUMBER; i++)
+  {
+    if (fifo_dequeue(fifo, &object) != FIFO_SUCCESS || object != i) fail("dequeue");
+  }
+
+  report("fifo_dequeue", kind, OBJECTS_NUMBER, now_ns() - started_ns);
+
+  for (uint64_t i = 0; i < STEADY_DEPTH; i++)
+  {
+    if (fifo_enqueue(fifo, &i) != FIFO_SUCCESS) fail("enqueue");
+  }
+
+  started_ns = now_ns();
+
+  for (uint64_t i = 0; i < OBJECTS_NUMBER; i++)
+  {
+    if (fifo_enqueue(fifo, &i) != FIFO_SUCCESS) fail("enqueue");
+    if (fifo_dequeue(fifo, &object) != FIFO_SUCCESS) fail("dequeue");
+  }
+
+  report("fifo_enqueue_dequeue", kind, 2 * OBJECTS_NUMBER, now_ns() - started_ns);
+
+  fifo_destroy(fifo);
+}
+
+static void * spsc_produce(void * arg)
+{
+  fifo_spsc_t * fifo = arg;
+
+  for (uint64_t i = 0; i < OBJECTS_NUMBER; )
+  {
+    if (fifo_spsc_enqueue(fifo, &i) == FIFO_SUCCESS) i++; else sched_yield();
+  }
+
+  return NULL;
+}
+
+static void bench_spsc(void)
+{
+  fifo_spsc_t * fifo = NULL;
+  pthread_t     producer;
+
+  if (FIFO_SPSC_CREATE_FOR(&fifo, uint64_t, CHANNEL_CAPACITY) != FIFO_SUCCESS) fail("create a fifo");
+
+  uint64_t started_ns = now_ns();
+
+  if (pthread_create(&producer, NULL, spsc_produce, fifo) != 0) fail("start a producer");
+
+  for (uint64_t i = 0; i < OBJECTS_NUMBER; )
+  {
+    uint64_t object = 0;
+
+    if (fifo_spsc_dequeue(fifo, &object) != FIFO_SUCCESS)
+    {
+      sched_yield();
+      continue;
+    }
+
+    if (object != i++) fail("dequeue");
+  }
+
+  report("fifo_pass", "spsc", OBJECTS_NUMBER, now_ns() - started_ns);
+
+  pthread_join(producer, NULL);
+
+  fifo_spsc_destroy(fifo);
+}
+
+typedef struct locked_fifo_s
+{
+  pthread_mutex_t mutex;
+  fifo_t        * fifo;
+} locked_fifo_t;
+
+static void * locked_produce(void * arg)
+{
+  locked_fifo_t * locked = arg;
+
+  for (uint64_t i = 0; i < OBJECTS_NUMBER; )
+  {
+    bool full = false;
+
+    pthread_mutex_lock(&locked->mutex);
+    {
+      full = fifo_enqueue(locked->fifo, &i) == FIFO_EFULL;
+    }
+    pthread_mutex_unlock(&locked->mutex);
+
+    if (full) sched_yield(); else i++;
+  }
+
+  return NULL;
+}
+
+static void bench_locked(void)
+{
+  locked_fifo_t locked;
+  pthread_t     producer;
+
+  if (FIFO_CREATE_BOUNDED_FOR(&locked.fifo, uint64_t, CHANNEL_CAPACITY) != FIFO_SUCCESS) fail("create a fifo");
+  if (pthread_mutex_init(&locked.mutex, NULL) != 0) fail("create a mutex");
+
+  uint64_t started_ns = now_ns();
+
+  if (pthread_create(&producer, NULL, locked_produce, &locked) != 0) fail("start a producer");
+
+  for (uint64_t i = 0; i < OBJECTS_NUMBER; )
+  {
+    uint64_t object = 0;
+    bool     taken  = false;
+
+    pthread_mutex_lock(&locked.mutex);
+    {
+      taken = !fifo_is_empty(locked.fifo) && fifo_dequeue(locked.fifo, &object) == FIFO_SUCCESS;
+    }
+    pthread_mutex_unlock(&locked.mutex);
+
+    if (!taken)
+    {
+      sched_yield();
+      continue;
+    }
+
+    if (object != i++) fail("dequeue");
+  }
+
+  report("fifo_pass", "locked", OBJECTS_NUMBER, now_ns() - started_ns);
+
+  pthread_join(producer, NULL);
+
+  pthread_mutex_destroy(&locked.mutex);
+  fifo_destroy(locked.fifo);
+}
+
+int main(void)
+{
+  printf("{\"suite\": \"fifo\", \"results\": [");
+
+  bench_fifo("unbounded", create_unbounded);
+  bench_fifo("bounded",   create_bounded);
+  bench_fifo("segmented", create_segmented);
+
+  bench_spsc();
+  bench_locked();
+
+  printf("\n]}\n");
+
+  return EXIT_SUCCESS;
+}
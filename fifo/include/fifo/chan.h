@@ -0,0 +1,88 @@
+#ifndef PTHEXERC_CHAN
+#define PTHEXERC_CHAN
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Bounded channel passing objects between any number of threads.
+ *
+ * Senders block while the channel is full and receivers block while it
+ * is empty. Each side counts its sleeping threads, so the other side
+ * signals only when someone sleeps, and wakes one thread per object sent
+ * or received.
+ *
+ * Once closed, the channel accepts nothing more, but what is already in
+ * it can still be received.
+ */
+typedef struct chan_s chan_t;
+
+typedef enum chan_ret_e
+{
+  CHAN_SUCCESS = 0,
+  CHAN_EAGAIN,     // failed to allocate memory
+  CHAN_EFULL,
+  CHAN_EEMPTY,
+  CHAN_ETIMEDOUT,
+  CHAN_ECLOSED,
+  CHAN_ESYSFAIL,
+} chan_ret_t;
+
+#define CHAN_CREATE_FOR(p_chan, type, capacity) \
+  chan_create((p_chan), sizeof(type), (capacity))
+
+/**
+ * The channel holds at most `capacity` objects.
+ */
+chan_ret_t chan_create(chan_t ** p_chan, size_t object_size, size_t capacity);
+
+/**
+ * Should be called when no thread uses the channel anymore.
+ */
+chan_ret_t chan_destroy(chan_t * chan);
+
+size_t chan_capacity(chan_t * chan);
+
+/**
+ * Blocks while the channel is full.
+ *
+ * @retval CHAN_ECLOSED  The channel is closed, before or while blocking.
+ */
+chan_ret_t chan_send(chan_t * chan, const void * p_object);
+
+/**
+ * Same as `chan_send()`, but returns CHAN_EFULL instead of blocking.
+ */
+chan_ret_t chan_try_send(chan_t * chan, const void * p_object);
+
+/**
+ * Same as `chan_send()`, but blocks for no longer than `timeout_ns`
+ * nanoseconds, then returns CHAN_ETIMEDOUT.
+ */
+chan_ret_t chan_send_timeout(chan_t * chan, const void * p_object, uint64_t timeout_ns);
+
+/**
+ * Blocks while the channel is empty.
+ *
+ * @retval CHAN_ECLOSED  The channel is closed and everything sent is received.
+ */
+chan_ret_t chan_recv(chan_t * chan, void * p_object);
+
+/**
+ * Same as `chan_recv()`, but returns CHAN_EEMPTY instead of blocking.
+ */
+chan_ret_t chan_try_recv(chan_t * chan, void * p_object);
+
+/**
+ * Same as `chan_recv()`, but blocks for no longer than `timeout_ns`
+ * nanoseconds, then returns CHAN_ETIMEDOUT.
+ */
+chan_ret_t chan_recv_timeout(chan_t * chan, void * p_object, uint64_t timeout_ns);
+
+/**
+ * Makes senders fail with CHAN_ECLOSED, and receivers too once the channel
+ * is drained. Wakes up every blocked thread. Closing again does nothing.
+ */
+chan_ret_t chan_close(chan_t * chan);
+
+#endif
@@ -10,19 +10,129 @@ typedef enum fifo_ret_e
 {
   FIFO_SUCCESS = 0,
   FIFO_EAGAIN,
+  FIFO_EFULL,
+  FIFO_ENOTSUP,
+  FIFO_EEMPTY,
 } fifo_ret_t;
 
+/**
+ * Memory of a fifo's nodes, segments and ring buffer comes from `alloc`
+ * and goes back to `free` with the same size. It is called by the thread
+ * using the fifo, only as long as the fifo lives.
+ */
+typedef struct fifo_allocator_s
+{
+  void * (* alloc)(size_t size, void * context);
+  void   (* free)(void * memory, size_t size, void * context);
+
+  void   * context;
+} fifo_allocator_t;
+
+typedef struct fifo_config_s
+{
+  size_t object_size;
+
+  /* Stores objects inline in one ring buffer of this capacity, see
+   * `fifo_create_bounded()`. 0 makes the fifo unbounded. */
+  size_t capacity;
+
+  /* Makes an unbounded fifo allocate storage in segments, see
+   * `fifo_create_segmented()`. 0 allocates a node per object. */
+  size_t segment_capacity;
+
+  fifo_allocator_t allocator;
+} fifo_config_t;
+
 #define FIFO_CREATE_FOR(p_fifo, type) \
   fifo_create_for_object_size((p_fifo), sizeof(type))
 
+#define FIFO_CREATE_BOUNDED_FOR(p_fifo, type, capacity) \
+  fifo_create_bounded((p_fifo), sizeof(type), (capacity))
+
+#define FIFO_CREATE_SEGMENTED_FOR(p_fifo, type, segment_capacity) \
+  fifo_create_segmented((p_fifo), sizeof(type), (segment_capacity))
+
+/**
+ * Configures an unbounded fifo allocating a node per object with malloc().
+ */
+void fifo_config_init(fifo_config_t * config, size_t object_size);
+
+/**
+ * Creates a fifo of any kind, see the specific functions below.
+ * At most one of `capacity` and `segment_capacity` may be set.
+ */
+fifo_ret_t fifo_create(fifo_t ** p_fifo, const fifo_config_t * config);
+
 fifo_ret_t fifo_create_for_object_size(fifo_t ** p_fifo, size_t object_size);
 
+/**
+ * Creates a fifo that stores objects inline in one contiguous ring buffer.
+ *
+ * `capacity` is rounded up to a power of two, see `fifo_capacity()`.
+ * Enqueueing into a full fifo returns FIFO_EFULL and leaves it unchanged.
+ */
+fifo_ret_t fifo_create_bounded(fifo_t ** p_fifo, size_t object_size, size_t capacity);
+
+/**
+ * Creates an unbounded fifo that allocates storage in segments holding
+ * `segment_capacity` objects each. A few drained segments are kept and
+ * reused, so the allocator is hit roughly once per `segment_capacity`
+ * enqueued objects.
+ */
+fifo_ret_t fifo_create_segmented(fifo_t ** p_fifo, size_t object_size, size_t segment_capacity);
+
 fifo_ret_t fifo_destroy(fifo_t * fifo);
 
 bool fifo_is_empty(fifo_t * fifo);
+bool fifo_is_full(fifo_t * fifo);
+
+/**
+ * Returns 0 for unbounded fifos.
+ */
+size_t fifo_capacity(fifo_t * fifo);
 
 fifo_ret_t fifo_enqueue(fifo_t * fifo, const void * p_object);
 fifo_ret_t fifo_dequeue(fifo_t * fifo, void * p_object);
 
+/*
+ * In-place access, so objects are constructed and consumed right in
+ * the fifo's storage with no copying. Supported by bounded and segmented
+ * fifos, others return FIFO_ENOTSUP.
+ */
+
+/**
+ * Reserves room for an object at the tail, `*p_slot` points to it.
+ * The object becomes a part of the fifo once `fifo_enqueue_commit()`
+ * is called, nothing else may be enqueued or dequeued before that.
+ *
+ * Reserving again before committing returns the same room.
+ *
+ * @retval FIFO_SUCCESS  Room is reserved.
+ * @retval FIFO_EFULL    Bounded fifo is full.
+ * @retval FIFO_EAGAIN   Failed to allocate a segment.
+ * @retval FIFO_ENOTSUP  Not supported by the kind of fifo.
+ */
+fifo_ret_t fifo_enqueue_reserve(fifo_t * fifo, void ** p_slot);
+
+/**
+ * Enqueues the object constructed in the reserved room.
+ */
+fifo_ret_t fifo_enqueue_commit(fifo_t * fifo);
+
+/**
+ * Points `*p_object` to the object at the head, which stays in the fifo
+ * till `fifo_dequeue_release()`. Nothing may be dequeued before that.
+ * The fifo should not be empty, as for `fifo_dequeue()`.
+ *
+ * @retval FIFO_SUCCESS  The object is at `*p_object`.
+ * @retval FIFO_ENOTSUP  Not supported by the kind of fifo.
+ */
+fifo_ret_t fifo_dequeue_peek(fifo_t * fifo, void ** p_object);
+
+/**
+ * Dequeues the object at the head, which must not be used anymore.
+ */
+fifo_ret_t fifo_dequeue_release(fifo_t * fifo);
+
 #endif
 
@@ -0,0 +1,53 @@
+#ifndef PTHEXERC_FIFO_SPSC
+#define PTHEXERC_FIFO_SPSC
+
+#include <stddef.h>
+
+#include "fifo/fifo.h"
+
+/**
+ * Bounded fifo passing objects from one producer thread to one consumer
+ * thread with no locks: each side publishes its own index with a release
+ * store and reads the other's with an acquire load, and only when a copy
+ * it keeps of the other's index says the fifo is full or empty.
+ *
+ * The indices sit on cache lines of their own, so the sides share a line
+ * only when one of them has to refresh its copy.
+ *
+ * `fifo_spsc_enqueue()` may be called by one thread at a time and so may
+ * `fifo_spsc_dequeue()`, any other use needs external synchronization.
+ */
+typedef struct fifo_spsc_s fifo_spsc_t;
+
+#define FIFO_SPSC_CREATE_FOR(p_fifo, type, capacity) \
+  fifo_spsc_create((p_fifo), sizeof(type), (capacity))
+
+/**
+ * `capacity` is rounded up to a power of two, see `fifo_spsc_capacity()`.
+ *
+ * @retval FIFO_EAGAIN  Failed to allocate memory.
+ */
+fifo_ret_t fifo_spsc_create(fifo_spsc_t ** p_fifo, size_t object_size, size_t capacity);
+
+/**
+ * Should be called when neither side uses the fifo anymore.
+ */
+fifo_ret_t fifo_spsc_destroy(fifo_spsc_t * fifo);
+
+size_t fifo_spsc_capacity(fifo_spsc_t * fifo);
+
+/**
+ * Called by the producer.
+ *
+ * @retval FIFO_EFULL  The fifo is full, it is left unchanged.
+ */
+fifo_ret_t fifo_spsc_enqueue(fifo_spsc_t * fifo, const void * p_object);
+
+/**
+ * Called by the consumer.
+ *
+ * @retval FIFO_EEMPTY  The fifo is empty, `*p_object` is left unchanged.
+ */
+fifo_ret_t fifo_spsc_dequeue(fifo_spsc_t * fifo, void * p_object);
+
+#endif
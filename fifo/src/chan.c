@@ -0,0 +1,295 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "fifo/fifo.h"
+#include "fifo/chan.h"
+
+#define NS_PER_SECOND 1000000000
+
+/**
+ * Objects are kept in a bounded fifo, whose capacity may be bigger,
+ * as it is rounded up, so `capacity` is checked against `length`.
+ *
+ * Conditions are waited with CLOCK_MONOTONIC deadlines, so timeouts
+ * are not affected by changes of the system time.
+ */
+struct chan_s
+{
+  pthread_mutex_t mutex; // guards everything below
+
+  fifo_t * fifo;
+  size_t   capacity;
+  size_t   length;
+  bool     closed;
+
+  pthread_cond_t not_full;
+  size_t         senders_waiting;
+
+  pthread_cond_t not_empty;
+  size_t         receivers_waiting;
+};
+
+#define CHAN_LOCK(chan) \
+  do { if (pthread_mutex_lock(&(chan)->mutex) != 0) return CHAN_ESYSFAIL; } while(0)
+
+#define CHAN_UNLOCK(chan) \
+  do { if (pthread_mutex_unlock(&(chan)->mutex) != 0) return CHAN_ESYSFAIL; } while(0)
+
+static int chan_cond_init(pthread_cond_t * cond)
+{
+  pthread_condattr_t attr;
+
+  int err = pthread_condattr_init(&attr);
+
+  if (err != 0) return err;
+
+  err = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+
+  if (err == 0) err = pthread_cond_init(cond, &attr);
+
+  pthread_condattr_destroy(&attr);
+
+  return err;
+}
+
+chan_ret_t chan_create(chan_t ** p_chan, size_t object_size, size_t capacity)
+{
+  assert(p_chan      != NULL);
+  assert(object_size >  0);
+  assert(capacity    >  0);
+
+  chan_t * chan = malloc(sizeof(chan_t));
+
+  if (chan == NULL) return CHAN_EAGAIN;
+
+  if (fifo_create_bounded(&chan->fifo, object_size, capacity) != FIFO_SUCCESS)
+  {
+    free(chan);
+    return CHAN_EAGAIN;
+  }
+
+  chan->capacity          = capacity;
+  chan->length            = 0;
+  chan->closed            = false;
+  chan->senders_waiting   = 0;
+  chan->receivers_waiting = 0;
+
+  if (pthread_mutex_init(&chan->mutex, NULL) != 0) goto failure_mutex;
+  if (chan_cond_init(&chan->not_full)        != 0) goto failure_not_full;
+  if (chan_cond_init(&chan->not_empty)       != 0) goto failure_not_empty;
+
+  *p_chan = chan;
+
+  return CHAN_SUCCESS;
+
+failure_not_empty: pthread_cond_destroy(&chan->not_full);
+failure_not_full:  pthread_mutex_destroy(&chan->mutex);
+failure_mutex:     fifo_destroy(chan->fifo);
+                   free(chan);
+
+  return CHAN_ESYSFAIL;
+}
+
+chan_ret_t chan_destroy(chan_t * chan)
+{
+  assert(chan != NULL);
+  assert(chan->senders_waiting == 0 && chan->receivers_waiting == 0);
+
+  pthread_cond_destroy(&chan->not_empty);
+  pthread_cond_destroy(&chan->not_full);
+  pthread_mutex_destroy(&chan->mutex);
+
+  fifo_destroy(chan->fifo);
+  free(chan);
+
+  return CHAN_SUCCESS;
+}
+
+size_t chan_capacity(chan_t * chan)
+{
+  assert(chan != NULL);
+
+  return chan->capacity;
+}
+
+/**
+ * Absolute CLOCK_MONOTONIC time `timeout_ns` from now.
+ */
+static struct timespec chan_deadline(uint64_t timeout_ns)
+{
+  struct timespec deadline;
+
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+  uint64_t nsec = (uint64_t) deadline.tv_nsec + timeout_ns % NS_PER_SECOND;
+
+  deadline.tv_sec  += (time_t) (timeout_ns / NS_PER_SECOND + nsec / NS_PER_SECOND);
+  deadline.tv_nsec  = (long) (nsec % NS_PER_SECOND);
+
+  return deadline;
+}
+
+/**
+ * Waits with the mutex locked, as a sender or a receiver counted by `waiting`.
+ *
+ * @param deadline  NULL to wait for as long as it takes.
+ */
+static chan_ret_t chan_wait(chan_t * chan, pthread_cond_t * cond, size_t * waiting,
+                            const struct timespec * deadline)
+{
+  int err = 0;
+
+  (*waiting)++;
+  {
+    err = deadline == NULL ? pthread_cond_wait(cond, &chan->mutex)
+                           : pthread_cond_timedwait(cond, &chan->mutex, deadline);
+  }
+  (*waiting)--;
+
+  switch (err)
+  {
+    case 0:         return CHAN_SUCCESS;
+    case ETIMEDOUT: return CHAN_ETIMEDOUT;
+    default:        return CHAN_ESYSFAIL;
+  }
+}
+
+/**
+ * @param block     Whether to wait while the channel is full.
+ * @param deadline  NULL to wait for as long as it takes.
+ */
+static chan_ret_t chan_send_impl(chan_t * chan, const void * p_object, bool block,
+                                 const struct timespec * deadline)
+{
+  assert(chan     != NULL);
+  assert(p_object != NULL);
+
+  chan_ret_t ret  = CHAN_SUCCESS;
+  bool       wake = false;
+
+  CHAN_LOCK(chan);
+  {
+    while (ret == CHAN_SUCCESS && !chan->closed && chan->length == chan->capacity)
+    {
+      ret = block ? chan_wait(chan, &chan->not_full, &chan->senders_waiting, deadline) : CHAN_EFULL;
+    }
+
+    // the signal may have come along with the timeout
+    if (ret == CHAN_ETIMEDOUT && chan->length < chan->capacity) ret = CHAN_SUCCESS;
+
+    if (ret == CHAN_SUCCESS && chan->closed) ret = CHAN_ECLOSED;
+
+    if (ret == CHAN_SUCCESS)
+    {
+      fifo_ret_t enqueued = fifo_enqueue(chan->fifo, p_object);
+
+      assert(enqueued == FIFO_SUCCESS && "fifo holds no less than the capacity");
+      (void) enqueued;
+
+      chan->length++;
+
+      wake = chan->receivers_waiting > 0;
+    }
+  }
+  CHAN_UNLOCK(chan);
+
+  // after unlocking, so the woken thread does not block on the mutex
+  if (wake && pthread_cond_signal(&chan->not_empty) != 0) return CHAN_ESYSFAIL;
+
+  return ret;
+}
+
+chan_ret_t chan_send(chan_t * chan, const void * p_object)
+{
+  return chan_send_impl(chan, p_object, true, NULL);
+}
+
+chan_ret_t chan_try_send(chan_t * chan, const void * p_object)
+{
+  return chan_send_impl(chan, p_object, false, NULL);
+}
+
+chan_ret_t chan_send_timeout(chan_t * chan, const void * p_object, uint64_t timeout_ns)
+{
+  struct timespec deadline = chan_deadline(timeout_ns);
+
+  return chan_send_impl(chan, p_object, true, &deadline);
+}
+
+/**
+ * @param block     Whether to wait while the channel is empty.
+ * @param deadline  NULL to wait for as long as it takes.
+ */
+static chan_ret_t chan_recv_impl(chan_t * chan, void * p_object, bool block,
+                                 const struct timespec * deadline)
+{
+  assert(chan     != NULL);
+  assert(p_object != NULL);
+
+  chan_ret_t ret  = CHAN_SUCCESS;
+  bool       wake = false;
+
+  CHAN_LOCK(chan);
+  {
+    while (ret == CHAN_SUCCESS && !chan->closed && chan->length == 0)
+    {
+      ret = block ? chan_wait(chan, &chan->not_empty, &chan->receivers_waiting, deadline) : CHAN_EEMPTY;
+    }
+
+    if (ret == CHAN_ETIMEDOUT && chan->length > 0) ret = CHAN_SUCCESS;
+
+    // what was sent before closing is still received
+    if (ret == CHAN_SUCCESS && chan->length == 0) ret = CHAN_ECLOSED;
+
+    if (ret == CHAN_SUCCESS)
+    {
+      fifo_dequeue(chan->fifo, p_object);
+
+      chan->length--;
+
+      wake = chan->senders_waiting > 0;
+    }
+  }
+  CHAN_UNLOCK(chan);
+
+  if (wake && pthread_cond_signal(&chan->not_full) != 0) return CHAN_ESYSFAIL;
+
+  return ret;
+}
+
+chan_ret_t chan_recv(chan_t * chan, void * p_object)
+{
+  return chan_recv_impl(chan, p_object, true, NULL);
+}
+
+chan_ret_t chan_try_recv(chan_t * chan, void * p_object)
+{
+  return chan_recv_impl(chan, p_object, false, NULL);
+}
+
+chan_ret_t chan_recv_timeout(chan_t * chan, void * p_object, uint64_t timeout_ns)
+{
+  struct timespec deadline = chan_deadline(timeout_ns);
+
+  return chan_recv_impl(chan, p_object, true, &deadline);
+}
+
+chan_ret_t chan_close(chan_t * chan)
+{
+  assert(chan != NULL);
+
+  CHAN_LOCK(chan);
+  {
+    chan->closed = true;
+  }
+  CHAN_UNLOCK(chan);
+
+  if (pthread_cond_broadcast(&chan->not_full)  != 0) return CHAN_ESYSFAIL;
+  if (pthread_cond_broadcast(&chan->not_empty) != 0) return CHAN_ESYSFAIL;
+
+  return CHAN_SUCCESS;
+}
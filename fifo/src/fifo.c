@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdalign.h>
 #include <assert.h>
 #include <string.h>
@@ -14,17 +15,107 @@ struct fifo_node_s
   /* object of unknown size */
 };
 
+typedef enum fifo_kind_e
+{
+  FIFO_KIND_LINKED,
+  FIFO_KIND_RING,
+  FIFO_KIND_SEGMENTED,
+} fifo_kind_t;
+
+/**
+ * How many drained segments are kept for reuse instead of being freed.
+ */
+#define FIFO_SEGMENTS_TO_RECYCLE 4
+
 struct fifo_s
 {
-  fifo_node_t * head;
-  fifo_node_t * tail;
+  fifo_kind_t kind;
 
   size_t object_size;
+
+  fifo_allocator_t allocator;
+
+  union
+  {
+    struct
+    {
+      fifo_node_t * head;
+      fifo_node_t * tail;
+    } linked;
+
+    /**
+     * Objects are stored inline, one after another, so no extra alignment
+     * is needed: the buffer is aligned for `max_align_t` and any object size
+     * is a multiple of its own alignment.
+     *
+     * `head` and `tail` are free-running counters, they are reduced
+     * to an index with `mask` only on access.
+     */
+    struct
+    {
+      unsigned char * buffer;
+
+      size_t mask;
+      size_t head; // incremented on dequeue
+      size_t tail; // incremented on enqueue
+    } ring;
+
+    /**
+     * Segments are nodes carrying `segment_capacity` objects each.
+     * Objects are dequeued from `head` at `head_index` and enqueued
+     * to `tail` at `tail_index`; empty fifo has (head == tail) and
+     * (head_index == tail_index).
+     */
+    struct
+    {
+      fifo_node_t * head;
+      fifo_node_t * tail;
+
+      size_t head_index;
+      size_t tail_index;
+
+      size_t segment_capacity;
+
+      fifo_node_t * recycled;
+      size_t        recycled_number;
+    } segmented;
+  };
 };
 
 #define MALLOC_OR_RETURN_EAGAIN(p_memory, size) \
   do { if ((p_memory = malloc(size)) == NULL) return FIFO_EAGAIN; } while(0)
 
+/**
+ * Same as MALLOC_OR_RETURN_EAGAIN(), but takes memory from the fifo's allocator.
+ */
+#define ALLOC_OR_RETURN_EAGAIN(fifo, p_memory, size) \
+  do { if ((p_memory = fifo_alloc(fifo, size)) == NULL) return FIFO_EAGAIN; } while(0)
+
+static void * fifo_default_alloc(size_t size, void * context)
+{
+  (void) context;
+
+  return malloc(size);
+}
+
+static void fifo_default_free(void * memory, size_t size, void * context)
+{
+  (void) size;
+  (void) context;
+
+  free(memory);
+}
+
+static void * fifo_alloc(fifo_t * fifo, size_t size)
+{
+  return fifo->allocator.alloc(size, fifo->allocator.context);
+}
+
+static void fifo_free(fifo_t * fifo, void * memory, size_t size)
+{
+  fifo->allocator.free(memory, size, fifo->allocator.context);
+}
+
 static void * fifo_node_object_begin(fifo_node_t * fifo_node)
 {
   size_t align = alignof(max_align_t);
@@ -37,39 +128,196 @@ static void * fifo_node_object_begin(fifo_node_t * fifo_node)
   return (void *) fifo_node + begin;
 }
 
-fifo_ret_t fifo_create_for_object_size(fifo_t ** p_fifo, size_t object_size)
+static size_t fifo_node_size(size_t payload_size)
+{
+  return payload_size + sizeof(union { fifo_node_t a; max_align_t b; });
+}
+
+static size_t round_up_to_power_of_two(size_t n)
 {
-  assert(object_size > 0 && "zero size is not supported");
+  size_t power = 1;
+
+  while (power < n)
+  {
+    assert(power << 1 != 0 && "capacity is too big");
+    power <<= 1;
+  }
+
+  return power;
+}
+
+static void * fifo_ring_slot(fifo_t * fifo, size_t position)
+{
+  return fifo->ring.buffer + (position & fifo->ring.mask) * fifo->object_size;
+}
+
+void fifo_config_init(fifo_config_t * config, size_t object_size)
+{
+  assert(config != NULL);
+
+  config->object_size      = object_size;
+  config->capacity         = 0;
+  config->segment_capacity = 0;
+
+  config->allocator.alloc   = fifo_default_alloc;
+  config->allocator.free    = fifo_default_free;
+  config->allocator.context = NULL;
+}
+
+static void fifo_init_linked(fifo_t * fifo)
+{
+  fifo->kind = FIFO_KIND_LINKED;
+
+  fifo->linked.head = NULL;
+  fifo->linked.tail = NULL;
+}
+
+static fifo_ret_t fifo_init_ring(fifo_t * fifo, size_t capacity)
+{
+  size_t slots_no = round_up_to_power_of_two(capacity);
+
+  assert(slots_no <= SIZE_MAX / fifo->object_size && "capacity is too big");
+
+  ALLOC_OR_RETURN_EAGAIN(fifo, fifo->ring.buffer, slots_no * fifo->object_size);
+
+  fifo->kind = FIFO_KIND_RING;
+
+  fifo->ring.mask = slots_no - 1;
+  fifo->ring.head = 0;
+  fifo->ring.tail = 0;
+
+  return FIFO_SUCCESS;
+}
+
+static void fifo_init_segmented(fifo_t * fifo, size_t segment_capacity)
+{
+  assert(segment_capacity <= SIZE_MAX / 2 / fifo->object_size && "segment capacity is too big");
+
+  fifo->kind = FIFO_KIND_SEGMENTED;
+
+  fifo->segmented.head = NULL;
+  fifo->segmented.tail = NULL;
+
+  fifo->segmented.head_index = 0;
+  fifo->segmented.tail_index = 0;
+
+  fifo->segmented.segment_capacity = segment_capacity;
+
+  fifo->segmented.recycled        = NULL;
+  fifo->segmented.recycled_number = 0;
+}
+
+fifo_ret_t fifo_create(fifo_t ** p_fifo, const fifo_config_t * config)
+{
+  assert(p_fifo != NULL);
+  assert(config != NULL);
+  assert(config->object_size > 0 && "zero size is not supported");
+  assert((config->capacity == 0 || config->segment_capacity == 0) && "a fifo is either bounded or segmented");
+  assert(config->allocator.alloc != NULL && config->allocator.free != NULL);
 
   fifo_t * fifo = NULL;
 
   MALLOC_OR_RETURN_EAGAIN(fifo, sizeof(fifo_t));
 
-  fifo->head = NULL;
-  fifo->tail = NULL;
+  fifo->object_size = config->object_size;
+  fifo->allocator   = config->allocator;
 
-  fifo->object_size = object_size;
+  if (config->capacity > 0)
+  {
+    if (fifo_init_ring(fifo, config->capacity) != FIFO_SUCCESS)
+    {
+      free(fifo);
+      return FIFO_EAGAIN;
+    }
+  }
+  else if (config->segment_capacity > 0)
+  {
+    fifo_init_segmented(fifo, config->segment_capacity);
+  }
+  else
+  {
+    fifo_init_linked(fifo);
+  }
 
   assert(fifo_is_empty(fifo));
 
   *p_fifo = fifo;
-  
+
   return FIFO_SUCCESS;
 }
 
-fifo_ret_t fifo_destroy(fifo_t * fifo)
+fifo_ret_t fifo_create_for_object_size(fifo_t ** p_fifo, size_t object_size)
 {
-  assert(fifo != NULL);
+  fifo_config_t config;
+
+  fifo_config_init(&config, object_size);
+
+  return fifo_create(p_fifo, &config);
+}
+
+fifo_ret_t fifo_create_bounded(fifo_t ** p_fifo, size_t object_size, size_t capacity)
+{
+  assert(capacity > 0 && "zero capacity is not supported");
+
+  fifo_config_t config;
+
+  fifo_config_init(&config, object_size);
+
+  config.capacity = capacity;
+
+  return fifo_create(p_fifo, &config);
+}
 
+fifo_ret_t fifo_create_segmented(fifo_t ** p_fifo, size_t object_size, size_t segment_capacity)
+{
+  assert(segment_capacity > 0 && "zero segment capacity is not supported");
+
+  fifo_config_t config;
+
+  fifo_config_init(&config, object_size);
+
+  config.segment_capacity = segment_capacity;
+
+  return fifo_create(p_fifo, &config);
+}
+
+static size_t fifo_segment_size(fifo_t * fifo)
+{
+  return fifo_node_size(fifo->segmented.segment_capacity * fifo->object_size);
+}
+
+static void fifo_free_nodes(fifo_t * fifo, fifo_node_t * head, size_t node_size)
+{
   fifo_node_t * node = NULL;
-  fifo_node_t * next = fifo->head;
+  fifo_node_t * next = head;
 
   while (next != NULL)
   {
     node = next;
     next = node->next;
 
-    free(node);
+    fifo_free(fifo, node, node_size);
+  }
+}
+
+fifo_ret_t fifo_destroy(fifo_t * fifo)
+{
+  assert(fifo != NULL);
+
+  switch (fifo->kind)
+  {
+    case FIFO_KIND_LINKED:
+      fifo_free_nodes(fifo, fifo->linked.head, fifo_node_size(fifo->object_size));
+      break;
+
+    case FIFO_KIND_RING:
+      fifo_free(fifo, fifo->ring.buffer, (fifo->ring.mask + 1) * fifo->object_size);
+      break;
+
+    case FIFO_KIND_SEGMENTED:
+      fifo_free_nodes(fifo, fifo->segmented.head,     fifo_segment_size(fifo));
+      fifo_free_nodes(fifo, fifo->segmented.recycled, fifo_segment_size(fifo));
+      break;
   }
 
   free(fifo);
@@ -77,25 +325,66 @@ fifo_ret_t fifo_destroy(fifo_t * fifo)
   return FIFO_SUCCESS;
 }
 
+size_t fifo_capacity(fifo_t * fifo)
+{
+  assert(fifo != NULL);
+
+  switch (fifo->kind)
+  {
+    case FIFO_KIND_RING: return fifo->ring.mask + 1;
+
+    case FIFO_KIND_LINKED:
+    case FIFO_KIND_SEGMENTED: return 0;
+  }
+
+  return 0;
+}
 
 bool fifo_is_empty(fifo_t * fifo)
 {
   assert(fifo != NULL);
 
-  // (head == NULL) if and only if (tail == NULL)
-  assert((fifo->head == NULL) == (fifo->tail == NULL));
+  switch (fifo->kind)
+  {
+    case FIFO_KIND_LINKED:
+      // (head == NULL) if and only if (tail == NULL)
+      assert((fifo->linked.head == NULL) == (fifo->linked.tail == NULL));
+
+      return fifo->linked.head == NULL;
+
+    case FIFO_KIND_RING:
+      return fifo->ring.head == fifo->ring.tail;
+
+    case FIFO_KIND_SEGMENTED:
+      return fifo->segmented.head       == fifo->segmented.tail
+          && fifo->segmented.head_index == fifo->segmented.tail_index;
+  }
 
-  return fifo->head == NULL;
+  return true;
 }
 
-fifo_ret_t fifo_enqueue(fifo_t * fifo, const void * p_object)
+bool fifo_is_full(fifo_t * fifo)
 {
-  assert(fifo     != NULL);
-  assert(p_object != NULL);
+  assert(fifo != NULL);
+
+  switch (fifo->kind)
+  {
+    case FIFO_KIND_RING:
+      return fifo->ring.tail - fifo->ring.head == fifo->ring.mask + 1;
+
+    case FIFO_KIND_LINKED:
+    case FIFO_KIND_SEGMENTED:
+      return false;
+  }
 
+  return false;
+}
+
+static fifo_ret_t fifo_linked_enqueue(fifo_t * fifo, const void * p_object)
+{
   fifo_node_t * node = NULL;
 
-  MALLOC_OR_RETURN_EAGAIN(node, fifo->object_size + sizeof(union { fifo_node_t a; max_align_t b; }));
+  ALLOC_OR_RETURN_EAGAIN(fifo, node, fifo_node_size(fifo->object_size));
 
   node->next = NULL;
 
@@ -103,43 +392,289 @@ fifo_ret_t fifo_enqueue(fifo_t * fifo, const void * p_object)
 
   if (fifo_is_empty(fifo))
   {
-    fifo->head = node;
-    fifo->tail = node;
+    fifo->linked.head = node;
+    fifo->linked.tail = node;
   }
   else
   {
-    fifo->tail->next = node;
-    fifo->tail       = node;
+    fifo->linked.tail->next = node;
+    fifo->linked.tail       = node;
   }
-  
+
   return FIFO_SUCCESS;
 }
 
-fifo_ret_t fifo_dequeue(fifo_t * fifo, void * p_object)
+static fifo_ret_t fifo_ring_reserve(fifo_t * fifo, void ** p_slot)
+{
+  if (fifo_is_full(fifo)) return FIFO_EFULL;
+
+  *p_slot = fifo_ring_slot(fifo, fifo->ring.tail);
+
+  return FIFO_SUCCESS;
+}
+
+static fifo_ret_t fifo_ring_enqueue(fifo_t * fifo, const void * p_object)
+{
+  void * slot = NULL;
+
+  fifo_ret_t ret = fifo_ring_reserve(fifo, &slot);
+
+  if (ret != FIFO_SUCCESS) return ret;
+
+  memcpy(slot, p_object, fifo->object_size);
+
+  fifo->ring.tail++;
+
+  return FIFO_SUCCESS;
+}
+
+/**
+ * Makes sure there is room at the tail segment, appending a segment if not.
+ */
+static fifo_ret_t fifo_segmented_reserve(fifo_t * fifo, void ** p_slot)
+{
+  size_t capacity = fifo->segmented.segment_capacity;
+
+  if (fifo->segmented.tail == NULL || fifo->segmented.tail_index == capacity)
+  {
+    fifo_node_t * segment = fifo->segmented.recycled;
+
+    if (segment != NULL)
+    {
+      fifo->segmented.recycled = segment->next;
+      fifo->segmented.recycled_number--;
+    }
+    else
+    {
+      ALLOC_OR_RETURN_EAGAIN(fifo, segment, fifo_segment_size(fifo));
+    }
+
+    segment->next = NULL;
+
+    if (fifo->segmented.tail == NULL)
+    {
+      fifo->segmented.head = segment;
+    }
+    else
+    {
+      fifo->segmented.tail->next = segment;
+    }
+
+    fifo->segmented.tail       = segment;
+    fifo->segmented.tail_index = 0;
+  }
+
+  unsigned char * objects = fifo_node_object_begin(fifo->segmented.tail);
+
+  *p_slot = objects + fifo->segmented.tail_index * fifo->object_size;
+
+  return FIFO_SUCCESS;
+}
+
+static fifo_ret_t fifo_segmented_enqueue(fifo_t * fifo, const void * p_object)
+{
+  void * slot = NULL;
+
+  fifo_ret_t ret = fifo_segmented_reserve(fifo, &slot);
+
+  if (ret != FIFO_SUCCESS) return ret;
+
+  memcpy(slot, p_object, fifo->object_size);
+
+  fifo->segmented.tail_index++;
+
+  return FIFO_SUCCESS;
+}
+
+fifo_ret_t fifo_enqueue(fifo_t * fifo, const void * p_object)
 {
   assert(fifo     != NULL);
   assert(p_object != NULL);
 
-  assert(!fifo_is_empty(fifo) && "fifo should be checked manualy if it is empty");
+  switch (fifo->kind)
+  {
+    case FIFO_KIND_LINKED:    return fifo_linked_enqueue(fifo, p_object);
+    case FIFO_KIND_RING:      return fifo_ring_enqueue(fifo, p_object);
+    case FIFO_KIND_SEGMENTED: return fifo_segmented_enqueue(fifo, p_object);
+  }
+
+  return FIFO_SUCCESS;
+}
+
+fifo_ret_t fifo_enqueue_reserve(fifo_t * fifo, void ** p_slot)
+{
+  assert(fifo   != NULL);
+  assert(p_slot != NULL);
+
+  switch (fifo->kind)
+  {
+    case FIFO_KIND_LINKED:    return FIFO_ENOTSUP;
+    case FIFO_KIND_RING:      return fifo_ring_reserve(fifo, p_slot);
+    case FIFO_KIND_SEGMENTED: return fifo_segmented_reserve(fifo, p_slot);
+  }
+
+  return FIFO_SUCCESS;
+}
+
+fifo_ret_t fifo_enqueue_commit(fifo_t * fifo)
+{
+  assert(fifo != NULL);
 
-  fifo_node_t * first_out = fifo->head;
+  switch (fifo->kind)
+  {
+    case FIFO_KIND_LINKED:
+      return FIFO_ENOTSUP;
+
+    case FIFO_KIND_RING:
+      assert(!fifo_is_full(fifo) && "room should be reserved first");
+
+      fifo->ring.tail++;
+      break;
+
+    case FIFO_KIND_SEGMENTED:
+      assert(fifo->segmented.tail != NULL && "room should be reserved first");
+      assert(fifo->segmented.tail_index < fifo->segmented.segment_capacity && "room should be reserved first");
+
+      fifo->segmented.tail_index++;
+      break;
+  }
+
+  return FIFO_SUCCESS;
+}
+
+static fifo_ret_t fifo_linked_dequeue(fifo_t * fifo, void * p_object)
+{
+  fifo_node_t * first_out = fifo->linked.head;
 
   memcpy(p_object, fifo_node_object_begin(first_out), fifo->object_size);
 
-  if (fifo->head == fifo->tail) // if it is the last element
+  if (fifo->linked.head == fifo->linked.tail) // if it is the last element
   {
-    fifo->head = NULL;
-    fifo->tail = NULL;
+    fifo->linked.head = NULL;
+    fifo->linked.tail = NULL;
 
     assert(fifo_is_empty(fifo));
   }
   else
   {
-    fifo->head = fifo->head->next;
+    fifo->linked.head = fifo->linked.head->next;
+  }
+
+  fifo_free(fifo, first_out, fifo_node_size(fifo->object_size));
+
+  return FIFO_SUCCESS;
+}
+
+static fifo_ret_t fifo_ring_dequeue(fifo_t * fifo, void * p_object)
+{
+  memcpy(p_object, fifo_ring_slot(fifo, fifo->ring.head), fifo->object_size);
+
+  fifo->ring.head++;
+
+  return FIFO_SUCCESS;
+}
+
+static void fifo_segment_recycle(fifo_t * fifo, fifo_node_t * segment)
+{
+  if (fifo->segmented.recycled_number < FIFO_SEGMENTS_TO_RECYCLE)
+  {
+    segment->next = fifo->segmented.recycled;
+
+    fifo->segmented.recycled = segment;
+    fifo->segmented.recycled_number++;
+  }
+  else
+  {
+    fifo_free(fifo, segment, fifo_segment_size(fifo));
   }
+}
+
+static void * fifo_segmented_head_slot(fifo_t * fifo)
+{
+  unsigned char * objects = fifo_node_object_begin(fifo->segmented.head);
 
-  free(first_out);
+  return objects + fifo->segmented.head_index * fifo->object_size;
+}
+
+static void fifo_segmented_release(fifo_t * fifo)
+{
+  fifo->segmented.head_index++;
+
+  if (fifo->segmented.head == fifo->segmented.tail)
+  {
+    if (fifo->segmented.head_index == fifo->segmented.tail_index)
+    {
+      // the only segment is drained, so it is reused from the beginning
+      fifo->segmented.head_index = 0;
+      fifo->segmented.tail_index = 0;
+    }
+  }
+  else if (fifo->segmented.head_index == fifo->segmented.segment_capacity)
+  {
+    fifo_node_t * drained = fifo->segmented.head;
+
+    fifo->segmented.head       = drained->next;
+    fifo->segmented.head_index = 0;
+
+    fifo_segment_recycle(fifo, drained);
+  }
+}
+
+static fifo_ret_t fifo_segmented_dequeue(fifo_t * fifo, void * p_object)
+{
+  memcpy(p_object, fifo_segmented_head_slot(fifo), fifo->object_size);
+
+  fifo_segmented_release(fifo);
 
   return FIFO_SUCCESS;
 }
 
+fifo_ret_t fifo_dequeue(fifo_t * fifo, void * p_object)
+{
+  assert(fifo     != NULL);
+  assert(p_object != NULL);
+
+  assert(!fifo_is_empty(fifo) && "fifo should be checked manualy if it is empty");
+
+  switch (fifo->kind)
+  {
+    case FIFO_KIND_LINKED:    return fifo_linked_dequeue(fifo, p_object);
+    case FIFO_KIND_RING:      return fifo_ring_dequeue(fifo, p_object);
+    case FIFO_KIND_SEGMENTED: return fifo_segmented_dequeue(fifo, p_object);
+  }
+
+  return FIFO_SUCCESS;
+}
+
+fifo_ret_t fifo_dequeue_peek(fifo_t * fifo, void ** p_object)
+{
+  assert(fifo     != NULL);
+  assert(p_object != NULL);
+
+  assert(!fifo_is_empty(fifo) && "fifo should be checked manualy if it is empty");
+
+  switch (fifo->kind)
+  {
+    case FIFO_KIND_LINKED:    return FIFO_ENOTSUP;
+    case FIFO_KIND_RING:      *p_object = fifo_ring_slot(fifo, fifo->ring.head); break;
+    case FIFO_KIND_SEGMENTED: *p_object = fifo_segmented_head_slot(fifo);        break;
+  }
+
+  return FIFO_SUCCESS;
+}
+
+fifo_ret_t fifo_dequeue_release(fifo_t * fifo)
+{
+  assert(fifo != NULL);
+
+  assert(!fifo_is_empty(fifo) && "fifo should be checked manualy if it is empty");
+
+  switch (fifo->kind)
+  {
+    case FIFO_KIND_LINKED:    return FIFO_ENOTSUP;
+    case FIFO_KIND_RING:      fifo->ring.head++;              break;
+    case FIFO_KIND_SEGMENTED: fifo_segmented_release(fifo); break;
+  }
+
+  return FIFO_SUCCESS;
+}
@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <assert.h>
+#include <string.h>
+
+#include "fifo/fifo_spsc.h"
+
+#define CACHE_LINE_SIZE 64
+
+/**
+ * `head` and `tail` are free-running counters, as in bounded `fifo_t`,
+ * reduced to an index with `mask` only on access.
+ */
+struct fifo_spsc_s
+{
+  /* never changed after creation */
+  alignas(CACHE_LINE_SIZE) unsigned char * buffer;
+
+  size_t mask;
+  size_t object_size;
+
+  /* written by the producer */
+  alignas(CACHE_LINE_SIZE) _Atomic size_t tail;
+
+  size_t head_cached; // `head` as last seen by the producer
+
+  /* written by the consumer */
+  alignas(CACHE_LINE_SIZE) _Atomic size_t head;
+
+  size_t tail_cached; // `tail` as last seen by the consumer
+};
+
+static size_t round_up_to_power_of_two(size_t n)
+{
+  size_t power = 1;
+
+  while (power < n)
+  {
+    assert(power << 1 != 0 && "capacity is too big");
+    power <<= 1;
+  }
+
+  return power;
+}
+
+static void * fifo_spsc_slot(fifo_spsc_t * fifo, size_t position)
+{
+  return fifo->buffer + (position & fifo->mask) * fifo->object_size;
+}
+
+fifo_ret_t fifo_spsc_create(fifo_spsc_t ** p_fifo, size_t object_size, size_t capacity)
+{
+  assert(p_fifo      != NULL);
+  assert(object_size >  0);
+  assert(capacity    >  0);
+
+  capacity = round_up_to_power_of_two(capacity);
+
+  assert(capacity <= SIZE_MAX / object_size && "capacity is too big");
+
+  fifo_spsc_t * fifo = aligned_alloc(alignof(fifo_spsc_t), sizeof(fifo_spsc_t));
+
+  if (fifo == NULL) return FIFO_EAGAIN;
+
+  fifo->buffer = malloc(capacity * object_size);
+
+  if (fifo->buffer == NULL)
+  {
+    free(fifo);
+    return FIFO_EAGAIN;
+  }
+
+  fifo->mask        = capacity - 1;
+  fifo->object_size = object_size;
+  fifo->head_cached = 0;
+  fifo->tail_cached = 0;
+
+  atomic_init(&fifo->tail, 0);
+  atomic_init(&fifo->head, 0);
+
+  *p_fifo = fifo;
+
+  return FIFO_SUCCESS;
+}
+
+fifo_ret_t fifo_spsc_destroy(fifo_spsc_t * fifo)
+{
+  assert(fifo != NULL);
+
+  free(fifo->buffer);
+  free(fifo);
+
+  return FIFO_SUCCESS;
+}
+
+size_t fifo_spsc_capacity(fifo_spsc_t * fifo)
+{
+  assert(fifo != NULL);
+
+  return fifo->mask + 1;
+}
+
+fifo_ret_t fifo_spsc_enqueue(fifo_spsc_t * fifo, const void * p_object)
+{
+  assert(fifo     != NULL);
+  assert(p_object != NULL);
+
+  // only the producer changes it
+  size_t tail = atomic_load_explicit(&fifo->tail, memory_order_relaxed);
+
+  if (tail - fifo->head_cached > fifo->mask)
+  {
+    // the slot is reused only after the consumer is done copying from it
+    fifo->head_cached = atomic_load_explicit(&fifo->head, memory_order_acquire);
+
+    if (tail - fifo->head_cached > fifo->mask) return FIFO_EFULL;
+  }
+
+  memcpy(fifo_spsc_slot(fifo, tail), p_object, fifo->object_size);
+
+  atomic_store_explicit(&fifo->tail, tail + 1, memory_order_release);
+
+  return FIFO_SUCCESS;
+}
+
+fifo_ret_t fifo_spsc_dequeue(fifo_spsc_t * fifo, void * p_object)
+{
+  assert(fifo     != NULL);
+  assert(p_object != NULL);
+
+  // only the consumer changes it
+  size_t head = atomic_load_explicit(&fifo->head, memory_order_relaxed);
+
+  if (head == fifo->tail_cached)
+  {
+    // the object is seen only after the producer is done copying it in
+    fifo->tail_cached = atomic_load_explicit(&fifo->tail, memory_order_acquire);
+
+    if (head == fifo->tail_cached) return FIFO_EEMPTY;
+  }
+
+  memcpy(p_object, fifo_spsc_slot(fifo, head), fifo->object_size);
+
+  atomic_store_explicit(&fifo->head, head + 1, memory_order_release);
+
+  return FIFO_SUCCESS;
+}
@@ -0,0 +1,180 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+extern "C"
+{
+  #include "fifo/chan.h"
+}
+
+static const uint64_t MS = 1000000; // in ns
+
+TEST(Chan, passes_objects_in_order_up_to_capacity)
+{
+  chan_t * chan     = NULL;
+  uint32_t returned = -1;
+
+  ASSERT_EQ(CHAN_CREATE_FOR(&chan, uint32_t, 3), CHAN_SUCCESS);
+
+  EXPECT_EQ(chan_capacity(chan), 3u);
+  EXPECT_EQ(chan_try_recv(chan, &returned), CHAN_EEMPTY);
+
+  for (uint32_t object = 0; object < 3; object++)
+  {
+    ASSERT_EQ(chan_try_send(chan, &object), CHAN_SUCCESS);
+  }
+
+  uint32_t extra = 3;
+
+  // not the fifo's capacity rounded up to 4
+  EXPECT_EQ(chan_try_send(chan, &extra), CHAN_EFULL);
+  EXPECT_EQ(chan_send_timeout(chan, &extra, 1 * MS), CHAN_ETIMEDOUT);
+
+  for (uint32_t object = 0; object < 3; object++)
+  {
+    ASSERT_EQ(chan_recv(chan, &returned), CHAN_SUCCESS);
+    EXPECT_EQ(returned, object);
+  }
+
+  EXPECT_EQ(chan_recv_timeout(chan, &returned, 1 * MS), CHAN_ETIMEDOUT);
+
+  ASSERT_EQ(chan_destroy(chan), CHAN_SUCCESS);
+}
+
+TEST(Chan, blocks_sender_while_full)
+{
+  chan_t * chan   = NULL;
+  uint32_t object = 0;
+
+  ASSERT_EQ(CHAN_CREATE_FOR(&chan, uint32_t, 1), CHAN_SUCCESS);
+  ASSERT_EQ(chan_send(chan, &object), CHAN_SUCCESS);
+
+  std::atomic<bool> sent { false };
+
+  std::thread sender([&]
+  {
+    uint32_t next = 1;
+
+    EXPECT_EQ(chan_send(chan, &next), CHAN_SUCCESS);
+    sent = true;
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  EXPECT_FALSE(sent);
+
+  uint32_t returned = -1;
+
+  EXPECT_EQ(chan_recv(chan, &returned), CHAN_SUCCESS);
+  EXPECT_EQ(returned, 0u);
+
+  sender.join();
+
+  EXPECT_TRUE(sent);
+  EXPECT_EQ(chan_recv(chan, &returned), CHAN_SUCCESS);
+  EXPECT_EQ(returned, 1u);
+
+  ASSERT_EQ(chan_destroy(chan), CHAN_SUCCESS);
+}
+
+TEST(Chan, close_wakes_up_blocked_threads_and_keeps_sent_objects)
+{
+  chan_t * chan   = NULL;
+  uint32_t object = 7;
+
+  ASSERT_EQ(CHAN_CREATE_FOR(&chan, uint32_t, 1), CHAN_SUCCESS);
+
+  std::thread receiver([&]
+  {
+    uint32_t returned = -1;
+
+    EXPECT_EQ(chan_recv(chan, &returned), CHAN_ECLOSED);
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  ASSERT_EQ(chan_close(chan), CHAN_SUCCESS);
+  receiver.join();
+
+  EXPECT_EQ(chan_send(chan, &object), CHAN_ECLOSED);
+
+  ASSERT_EQ(chan_destroy(chan), CHAN_SUCCESS);
+
+  // a sender blocked on the full channel
+  ASSERT_EQ(CHAN_CREATE_FOR(&chan, uint32_t, 1), CHAN_SUCCESS);
+  ASSERT_EQ(chan_send(chan, &object), CHAN_SUCCESS);
+
+  std::thread sender([&]
+  {
+    uint32_t next = 8;
+
+    EXPECT_EQ(chan_send(chan, &next), CHAN_ECLOSED);
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  ASSERT_EQ(chan_close(chan), CHAN_SUCCESS);
+  sender.join();
+
+  uint32_t returned = -1;
+
+  EXPECT_EQ(chan_recv(chan, &returned), CHAN_SUCCESS);
+  EXPECT_EQ(returned, 7u);
+  EXPECT_EQ(chan_recv(chan, &returned), CHAN_ECLOSED);
+
+  ASSERT_EQ(chan_destroy(chan), CHAN_SUCCESS);
+}
+
+TEST(Chan, passes_objects_between_many_threads)
+{
+  const size_t   THREADS = 4;
+  const uint64_t OBJECTS = 20000; // per sender
+
+  chan_t * chan = NULL;
+
+  ASSERT_EQ(CHAN_CREATE_FOR(&chan, uint64_t, 8), CHAN_SUCCESS);
+
+  std::vector<std::thread> senders;
+  std::vector<std::thread> receivers;
+
+  std::atomic<uint64_t> received_sum   { 0 };
+  std::atomic<uint64_t> received_count { 0 };
+
+  for (size_t t = 0; t < THREADS; t++)
+  {
+    senders.emplace_back([&]
+    {
+      for (uint64_t object = 1; object <= OBJECTS; object++)
+      {
+        EXPECT_EQ(chan_send(chan, &object), CHAN_SUCCESS);
+      }
+    });
+
+    receivers.emplace_back([&]
+    {
+      uint64_t object = 0;
+
+      while (chan_recv(chan, &object) == CHAN_SUCCESS)
+      {
+        received_sum += object;
+        received_count++;
+      }
+    });
+  }
+
+  for (auto & sender : senders) sender.join();
+
+  ASSERT_EQ(chan_close(chan), CHAN_SUCCESS);
+
+  for (auto & receiver : receivers) receiver.join();
+
+  EXPECT_EQ(received_count, THREADS * OBJECTS);
+  EXPECT_EQ(received_sum,   THREADS * OBJECTS * (OBJECTS + 1) / 2);
+
+  ASSERT_EQ(chan_destroy(chan), CHAN_SUCCESS);
+}
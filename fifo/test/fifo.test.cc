@@ -177,3 +177,374 @@ TEST(FIFO, preserves_fifo_after_dequeueing_not_all)
   ASSERT_EQ(fifo_destroy(fifo), FIFO_SUCCESS);
 }
 
+
+
+TEST(FIFOBounded, rounds_capacity_up_to_power_of_two)
+{
+  fifo_t * fifo = NULL;
+
+  ASSERT_EQ(fifo_create_bounded(&fifo, sizeof(uint32_t), 5), FIFO_SUCCESS);
+
+  ASSERT_NE(fifo, (void *) NULL);
+
+  EXPECT_EQ(fifo_capacity(fifo), 8);
+  EXPECT_TRUE(fifo_is_empty(fifo));
+  EXPECT_FALSE(fifo_is_full(fifo));
+
+  ASSERT_EQ(fifo_destroy(fifo), FIFO_SUCCESS);
+}
+
+TEST(FIFOBounded, rejects_enqueueing_when_full)
+{
+  fifo_t * fifo = NULL;
+
+  uint32_t returned = -1;
+
+  ASSERT_EQ(fifo_create_bounded(&fifo, sizeof(uint32_t), 4), FIFO_SUCCESS);
+
+  for (uint32_t object = 0; object < 4; object++)
+  {
+    EXPECT_EQ(fifo_enqueue(fifo, &object), FIFO_SUCCESS);
+  }
+
+  EXPECT_TRUE(fifo_is_full(fifo));
+
+  uint32_t extra = 42;
+
+  EXPECT_EQ(fifo_enqueue(fifo, &extra), FIFO_EFULL);
+
+  EXPECT_EQ(fifo_dequeue(fifo, &returned), FIFO_SUCCESS);
+  EXPECT_EQ(returned, 0);
+
+  EXPECT_FALSE(fifo_is_full(fifo));
+  EXPECT_EQ(fifo_enqueue(fifo, &extra), FIFO_SUCCESS);
+
+  ASSERT_EQ(fifo_destroy(fifo), FIFO_SUCCESS);
+}
+
+TEST(FIFOBounded, preserves_fifo_when_wrapping_around)
+{
+  fifo_t * fifo = NULL;
+
+  uint32_t head = 0; // incremented on enqueue
+  uint32_t tail = 0; // incremented on dequeue
+
+  ASSERT_EQ(fifo_create_bounded(&fifo, sizeof(uint32_t), 4), FIFO_SUCCESS);
+
+  for (; head < 3; head++)
+  {
+    ASSERT_EQ(fifo_enqueue(fifo, &head), FIFO_SUCCESS);
+  }
+
+  for (; head < 50; head++)
+  {
+    uint32_t returned = -1;
+
+    EXPECT_EQ(fifo_enqueue(fifo, &head), FIFO_SUCCESS);
+
+    EXPECT_EQ(fifo_dequeue(fifo, &returned), FIFO_SUCCESS);
+    EXPECT_EQ(returned, tail++);
+  }
+
+  for (; tail < head; tail++)
+  {
+    uint32_t returned = -1;
+
+    EXPECT_EQ(fifo_dequeue(fifo, &returned), FIFO_SUCCESS);
+    EXPECT_EQ(returned, tail);
+  }
+
+  EXPECT_TRUE(fifo_is_empty(fifo));
+
+  ASSERT_EQ(fifo_destroy(fifo), FIFO_SUCCESS);
+}
+
+TEST(FIFOSegmented, creates_empty)
+{
+  fifo_t * fifo = NULL;
+
+  ASSERT_EQ(fifo_create_segmented(&fifo, sizeof(uint32_t), 4), FIFO_SUCCESS);
+
+  ASSERT_NE(fifo, (void *) NULL);
+
+  EXPECT_TRUE(fifo_is_empty(fifo));
+  EXPECT_FALSE(fifo_is_full(fifo));
+  EXPECT_EQ(fifo_capacity(fifo), 0);
+
+  ASSERT_EQ(fifo_destroy(fifo), FIFO_SUCCESS);
+}
+
+TEST(FIFOSegmented, dequeue_bunch_of_numbers_across_segments)
+{
+  fifo_t * fifo = NULL;
+
+  ASSERT_EQ(fifo_create_segmented(&fifo, sizeof(uint32_t), 4), FIFO_SUCCESS);
+
+  for (uint32_t tries = 0; tries < 3; tries++)
+  {
+    for (uint32_t object = 0; object < 37; object++)
+    {
+      EXPECT_EQ(fifo_enqueue(fifo, &object), FIFO_SUCCESS);
+    }
+
+    for (uint32_t object = 0; object < 37; object++)
+    {
+      uint32_t returned = -1;
+
+      EXPECT_EQ(fifo_dequeue(fifo, &returned), FIFO_SUCCESS);
+      EXPECT_EQ(returned, object);
+    }
+
+    EXPECT_TRUE(fifo_is_empty(fifo));
+  }
+
+  ASSERT_EQ(fifo_destroy(fifo), FIFO_SUCCESS);
+}
+
+TEST(FIFOSegmented, preserves_fifo_after_dequeueing_not_all)
+{
+  fifo_t * fifo = NULL;
+
+  uint32_t head = 0; // incremented on enqueue
+  uint32_t tail = 0; // incremented on dequeue
+
+  ASSERT_EQ(fifo_create_segmented(&fifo, sizeof(uint32_t), 3), FIFO_SUCCESS);
+
+  for (; head < 10; head++)
+  {
+    ASSERT_EQ(fifo_enqueue(fifo, &head), FIFO_SUCCESS);
+  }
+
+  for (; head < 100; head++)
+  {
+    uint32_t returned = -1;
+
+    EXPECT_EQ(fifo_enqueue(fifo, &head), FIFO_SUCCESS);
+
+    EXPECT_EQ(fifo_dequeue(fifo, &returned), FIFO_SUCCESS);
+    EXPECT_EQ(returned, tail++);
+  }
+
+  for (; tail < head; tail++)
+  {
+    uint32_t returned = -1;
+
+    EXPECT_EQ(fifo_dequeue(fifo, &returned), FIFO_SUCCESS);
+    EXPECT_EQ(returned, tail);
+  }
+
+  EXPECT_TRUE(fifo_is_empty(fifo));
+
+  ASSERT_EQ(fifo_destroy(fifo), FIFO_SUCCESS);
+}
+
+typedef struct counting_allocator_s
+{
+  size_t allocations;
+  size_t outstanding; // bytes
+  bool   failing;
+} counting_allocator_t;
+
+static void * counting_alloc(size_t size, void * context)
+{
+  counting_allocator_t * counter = (counting_allocator_t *) context;
+
+  if (counter->failing) return NULL;
+
+  counter->allocations++;
+  counter->outstanding += size;
+
+  return malloc(size);
+}
+
+static void counting_free(void * memory, size_t size, void * context)
+{
+  counting_allocator_t * counter = (counting_allocator_t *) context;
+
+  counter->outstanding -= size;
+
+  free(memory);
+}
+
+static void counting_config_init(fifo_config_t * config, counting_allocator_t * counter)
+{
+  fifo_config_init(config, sizeof(uint32_t));
+
+  config->allocator.alloc   = counting_alloc;
+  config->allocator.free    = counting_free;
+  config->allocator.context = counter;
+}
+
+TEST(FIFOAllocator, allocates_storage_of_every_kind_with_it)
+{
+  for (size_t kind = 0; kind < 3; kind++)
+  {
+    counting_allocator_t counter = { 0, 0, false };
+
+    fifo_config_t config;
+
+    counting_config_init(&config, &counter);
+
+    if (kind == 1) config.capacity         = 64;
+    if (kind == 2) config.segment_capacity = 4;
+
+    fifo_t * fifo = NULL;
+
+    ASSERT_EQ(fifo_create(&fifo, &config), FIFO_SUCCESS);
+
+    for (uint32_t object = 0; object < 50; object++)
+    {
+      ASSERT_EQ(fifo_enqueue(fifo, &object), FIFO_SUCCESS);
+    }
+
+    for (uint32_t object = 0; object < 30; object++)
+    {
+      uint32_t returned = -1;
+
+      ASSERT_EQ(fifo_dequeue(fifo, &returned), FIFO_SUCCESS);
+      EXPECT_EQ(returned, object);
+    }
+
+    EXPECT_GT(counter.allocations, 0u) << "kind " << kind;
+
+    ASSERT_EQ(fifo_destroy(fifo), FIFO_SUCCESS);
+
+    // everything went back with the sizes it was taken with
+    EXPECT_EQ(counter.outstanding, 0u) << "kind " << kind;
+  }
+}
+
+TEST(FIFOAllocator, reports_failures_to_allocate)
+{
+  counting_allocator_t counter = { 0, 0, true };
+
+  fifo_config_t config;
+  fifo_t      * fifo   = NULL;
+  uint32_t      object = 0;
+
+  counting_config_init(&config, &counter);
+
+  config.capacity = 4;
+
+  EXPECT_EQ(fifo_create(&fifo, &config), FIFO_EAGAIN);
+
+  config.capacity = 0;
+
+  ASSERT_EQ(fifo_create(&fifo, &config), FIFO_SUCCESS);
+
+  EXPECT_EQ(fifo_enqueue(fifo, &object), FIFO_EAGAIN);
+  EXPECT_TRUE(fifo_is_empty(fifo));
+
+  ASSERT_EQ(fifo_destroy(fifo), FIFO_SUCCESS);
+}
+
+static void expect_in_place_round_trips(fifo_t * fifo, uint32_t rounds)
+{
+  uint32_t next_in  = 0;
+  uint32_t next_out = 0;
+
+  // a few objects stay in, so the head and the tail cross segments and wrap
+  for (uint32_t round = 0; round < rounds; round++)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      void * slot = NULL;
+
+      ASSERT_EQ(fifo_enqueue_reserve(fifo, &slot), FIFO_SUCCESS);
+      ASSERT_NE(slot, nullptr);
+
+      *(uint32_t *) slot = next_in++;
+
+      ASSERT_EQ(fifo_enqueue_commit(fifo), FIFO_SUCCESS);
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+      void * object = NULL;
+
+      ASSERT_EQ(fifo_dequeue_peek(fifo, &object), FIFO_SUCCESS);
+      EXPECT_EQ(*(uint32_t *) object, next_out++);
+      ASSERT_EQ(fifo_dequeue_release(fifo), FIFO_SUCCESS);
+    }
+
+    // copying ones see the same objects
+    uint32_t returned = -1;
+
+    ASSERT_EQ(fifo_enqueue(fifo, &next_in), FIFO_SUCCESS);
+    next_in++;
+
+    ASSERT_EQ(fifo_dequeue(fifo, &returned), FIFO_SUCCESS);
+    EXPECT_EQ(returned, next_out++);
+  }
+
+  while (!fifo_is_empty(fifo))
+  {
+    void * object = NULL;
+
+    ASSERT_EQ(fifo_dequeue_peek(fifo, &object), FIFO_SUCCESS);
+    EXPECT_EQ(*(uint32_t *) object, next_out++);
+    ASSERT_EQ(fifo_dequeue_release(fifo), FIFO_SUCCESS);
+  }
+
+  EXPECT_EQ(next_out, next_in);
+}
+
+TEST(FIFOInPlace, passes_objects_through_bounded)
+{
+  fifo_t * fifo = NULL;
+
+  ASSERT_EQ(FIFO_CREATE_BOUNDED_FOR(&fifo, uint32_t, 64), FIFO_SUCCESS);
+
+  expect_in_place_round_trips(fifo, 60);
+
+  ASSERT_EQ(fifo_destroy(fifo), FIFO_SUCCESS);
+}
+
+TEST(FIFOInPlace, passes_objects_through_segmented)
+{
+  fifo_t * fifo = NULL;
+
+  ASSERT_EQ(FIFO_CREATE_SEGMENTED_FOR(&fifo, uint32_t, 4), FIFO_SUCCESS);
+
+  expect_in_place_round_trips(fifo, 60);
+
+  ASSERT_EQ(fifo_destroy(fifo), FIFO_SUCCESS);
+}
+
+TEST(FIFOInPlace, reserves_nothing_in_full_bounded)
+{
+  fifo_t * fifo = NULL;
+  void   * slot = NULL;
+
+  ASSERT_EQ(FIFO_CREATE_BOUNDED_FOR(&fifo, uint32_t, 2), FIFO_SUCCESS);
+
+  for (uint32_t object = 0; object < 2; object++)
+  {
+    ASSERT_EQ(fifo_enqueue(fifo, &object), FIFO_SUCCESS);
+  }
+
+  EXPECT_EQ(fifo_enqueue_reserve(fifo, &slot), FIFO_EFULL);
+  EXPECT_TRUE(fifo_is_full(fifo));
+
+  ASSERT_EQ(fifo_destroy(fifo), FIFO_SUCCESS);
+}
+
+TEST(FIFOInPlace, is_not_supported_by_unbounded)
+{
+  fifo_t * fifo   = NULL;
+  void   * slot   = NULL;
+  uint32_t object = 7;
+
+  ASSERT_EQ(FIFO_CREATE_FOR(&fifo, uint32_t), FIFO_SUCCESS);
+
+  EXPECT_EQ(fifo_enqueue_reserve(fifo, &slot), FIFO_ENOTSUP);
+  EXPECT_EQ(fifo_enqueue_commit(fifo), FIFO_ENOTSUP);
+
+  ASSERT_EQ(fifo_enqueue(fifo, &object), FIFO_SUCCESS);
+
+  EXPECT_EQ(fifo_dequeue_peek(fifo, &slot), FIFO_ENOTSUP);
+  EXPECT_EQ(fifo_dequeue_release(fifo), FIFO_ENOTSUP);
+  EXPECT_FALSE(fifo_is_empty(fifo));
+
+  ASSERT_EQ(fifo_destroy(fifo), FIFO_SUCCESS);
+}
@@ -0,0 +1,107 @@
+#include "gtest/gtest.h"
+
+#include <thread>
+
+#include <stdint.h>
+
+extern "C"
+{
+  #include "fifo/fifo_spsc.h"
+}
+
+TEST(FIFOSPSC, rounds_capacity_up_to_power_of_two)
+{
+  fifo_spsc_t * fifo = NULL;
+
+  ASSERT_EQ(FIFO_SPSC_CREATE_FOR(&fifo, uint32_t, 5), FIFO_SUCCESS);
+
+  EXPECT_EQ(fifo_spsc_capacity(fifo), 8u);
+
+  ASSERT_EQ(fifo_spsc_destroy(fifo), FIFO_SUCCESS);
+}
+
+TEST(FIFOSPSC, reports_full_and_empty)
+{
+  fifo_spsc_t * fifo     = NULL;
+  uint32_t      returned = -1;
+
+  ASSERT_EQ(FIFO_SPSC_CREATE_FOR(&fifo, uint32_t, 4), FIFO_SUCCESS);
+
+  EXPECT_EQ(fifo_spsc_dequeue(fifo, &returned), FIFO_EEMPTY);
+  EXPECT_EQ(returned, (uint32_t) -1);
+
+  // twice around the ring
+  for (uint32_t round = 0; round < 2; round++)
+  {
+    for (uint32_t object = 0; object < 4; object++)
+    {
+      ASSERT_EQ(fifo_spsc_enqueue(fifo, &object), FIFO_SUCCESS);
+    }
+
+    uint32_t extra = 4;
+
+    EXPECT_EQ(fifo_spsc_enqueue(fifo, &extra), FIFO_EFULL);
+
+    for (uint32_t object = 0; object < 4; object++)
+    {
+      ASSERT_EQ(fifo_spsc_dequeue(fifo, &returned), FIFO_SUCCESS);
+      EXPECT_EQ(returned, object);
+    }
+
+    EXPECT_EQ(fifo_spsc_dequeue(fifo, &returned), FIFO_EEMPTY);
+  }
+
+  ASSERT_EQ(fifo_spsc_destroy(fifo), FIFO_SUCCESS);
+}
+
+TEST(FIFOSPSC, passes_objects_between_threads_in_order)
+{
+  const uint64_t OBJECTS = 1000000;
+
+  fifo_spsc_t * fifo = NULL;
+
+  // small, so both sides keep running into the other one
+  ASSERT_EQ(FIFO_SPSC_CREATE_FOR(&fifo, uint64_t, 16), FIFO_SUCCESS);
+
+  std::thread producer([&]
+  {
+    for (uint64_t object = 0; object < OBJECTS; )
+    {
+      if (fifo_spsc_enqueue(fifo, &object) == FIFO_SUCCESS)
+      {
+        object++;
+      }
+      else
+      {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  uint64_t expected = 0;
+
+  while (expected < OBJECTS)
+  {
+    uint64_t returned = 0;
+
+    fifo_ret_t ret = fifo_spsc_dequeue(fifo, &returned);
+
+    if (ret == FIFO_SUCCESS)
+    {
+      EXPECT_EQ(returned, expected++);
+    }
+    else
+    {
+      EXPECT_EQ(ret, FIFO_EEMPTY);
+      std::this_thread::yield();
+    }
+  }
+
+  producer.join();
+
+  uint64_t returned = 0;
+
+  EXPECT_EQ(fifo_spsc_dequeue(fifo, &returned), FIFO_EEMPTY);
+
+  ASSERT_EQ(fifo_spsc_destroy(fifo), FIFO_SUCCESS);
+}
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "bench.h"
+
+#define NS_PER_SECOND 1000000000
+
+/* whether a comma should go before the next result or field */
+static bool result_first = true;
+static bool field_first  = true;
+
+static void bench_field_key(const char * key)
+{
+  printf("%s\"%s\": ", field_first ? "" : ", ", key);
+
+  field_first = false;
+}
+
+void bench_suite_begin(const char * suite)
+{
+  printf("{\"suite\": \"%s\", \"results\": [", suite);
+
+  result_first = true;
+}
+
+void bench_suite_end(void)
+{
+  printf("\n]}\n");
+  fflush(stdout);
+}
+
+void bench_result_begin(const char * name)
+{
+  printf("%s\n  {", result_first ? "" : ",");
+
+  result_first = false;
+  field_first  = true;
+
+  bench_param_str("name", name);
+}
+
+void bench_result_end(void)
+{
+  printf("}");
+  fflush(stdout);
+}
+
+void bench_param(const char * key, size_t value)
+{
+  bench_field_key(key);
+  printf("%zu", value);
+}
+
+void bench_param_str(const char * key, const char * value)
+{
+  bench_field_key(key);
+  printf("\"%s\"", value);
+}
+
+void bench_metric(const char * key, double value)
+{
+  bench_field_key(key);
+  printf("%.6g", value);
+}
+
+void bench_throughput(size_t ops, uint64_t elapsed_ns)
+{
+  double seconds = (double) elapsed_ns / NS_PER_SECOND;
+
+  bench_param("ops", ops);
+  bench_metric("seconds", seconds);
+  bench_metric("ops_per_sec", seconds > 0 ? ops / seconds : 0);
+}
+
+static int compare_samples(const void * a, const void * b)
+{
+  uint64_t x = *(const uint64_t *) a;
+  uint64_t y = *(const uint64_t *) b;
+
+  return (x > y) - (x < y);
+}
+
+void bench_latency(uint64_t * samples_ns, size_t n)
+{
+  static const struct
+  {
+    const char * key;
+    double       rank;
+  } percentiles[] =
+  {
+    { "p50_ns",  0.50  },
+    { "p90_ns",  0.90  },
+    { "p99_ns",  0.99  },
+    { "p999_ns", 0.999 },
+  };
+
+  bench_param("samples", n);
+
+  if (n == 0) return;
+
+  qsort(samples_ns, n, sizeof(uint64_t), compare_samples);
+
+  for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++)
+  {
+    bench_param(percentiles[i].key, samples_ns[(size_t) (percentiles[i].rank * (n - 1))]);
+  }
+
+  bench_param("max_ns", samples_ns[n - 1]);
+}
+
+uint64_t bench_now_ns(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t) now.tv_sec * NS_PER_SECOND + (uint64_t) now.tv_nsec;
+}
+
+size_t bench_cpus(void)
+{
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return cpus > 0 ? (size_t) cpus : 1;
+}
+
+size_t bench_threads_next(size_t threads)
+{
+  size_t cpus = bench_cpus();
+
+  if (threads >= cpus) return 0;
+
+  return threads * 2 < cpus ? threads * 2 : cpus;
+}
@@ -0,0 +1,51 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Results are printed to stdout as a single JSON document:
+ *
+ *   {"suite": "<suite>", "results": [
+ *     {"name": "<name>", <parameters and metrics>},
+ *     ...
+ *   ]}
+ *
+ * so runs can be collected and compared over time.
+ */
+
+void bench_suite_begin(const char * suite);
+void bench_suite_end(void);
+
+void bench_result_begin(const char * name);
+void bench_result_end(void);
+
+void bench_param(const char * key, size_t value);
+void bench_param_str(const char * key, const char * value);
+
+void bench_metric(const char * key, double value);
+
+/**
+ * Adds `ops`, `seconds` and `ops_per_sec`.
+ */
+void bench_throughput(size_t ops, uint64_t elapsed_ns);
+
+/**
+ * Adds percentiles of the samples as `p50_ns` ... `p999_ns` and `max_ns`.
+ * The samples get sorted.
+ */
+void bench_latency(uint64_t * samples_ns, size_t n);
+
+uint64_t bench_now_ns(void);
+
+/**
+ * Numbers of threads to try: 1, 2, 4 and so on up to the number of
+ * CPUs, which is the last one even if not a power of two. 0 follows
+ * the last one.
+ */
+size_t bench_threads_next(size_t threads);
+
+size_t bench_cpus(void);
+
+#endif
@@ -0,0 +1,301 @@
+/**
+ * Throughput of empty works, latency from submission to start,
+ * and fork/join workloads, for numbers of threads up to the CPUs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <sched.h>
+
+#include "tpool.h"
+
+#include "bench.h"
+
+#define EMPTY_WORKS_NUMBER   1000000
+#define BATCH_SIZE           64
+#define LATENCY_SAMPLES      10000
+#define FIB_N                30
+#define FIB_CUTOFF           12
+#define SUM_ELEMENTS         (1 << 24)
+
+typedef struct latency_sample_s
+{
+  uint64_t         submitted_ns;
+  uint64_t       * p_latency_ns;
+  atomic_size_t  * started;
+} latency_sample_t;
+
+typedef struct fib_s
+{
+  tpool_t  * tpool;
+  size_t     n;
+  uint64_t   result;
+} fib_t;
+
+static void fail(const char * what)
+{
+  fprintf(stderr, "failed to %s\n", what);
+  exit(EXIT_FAILURE);
+}
+
+static tpool_t * pool_create(size_t threads)
+{
+  tpool_t * tpool = NULL;
+
+  if (tpool_create(&tpool, threads) != TPOOL_SUCCESS) fail("create a pool");
+
+  return tpool;
+}
+
+static void pool_destroy(tpool_t * tpool)
+{
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+}
+
+static void wait_for(atomic_size_t * counter, size_t value)
+{
+  while (atomic_load_explicit(counter, memory_order_acquire) < value) sched_yield();
+}
+
+static void count_routine(void * arg)
+{
+  atomic_fetch_add_explicit((atomic_size_t *) arg, 1, memory_order_release);
+}
+
+static void bench_empty_works(size_t threads, bool batched)
+{
+  tpool_t * tpool = pool_create(threads);
+
+  atomic_size_t done;
+
+  atomic_init(&done, 0);
+
+  tpool_work_t batch[BATCH_SIZE];
+
+  for (size_t i = 0; i < BATCH_SIZE; i++)
+  {
+    batch[i].routine = count_routine;
+    batch[i].arg     = &done;
+  }
+
+  uint64_t started_ns = bench_now_ns();
+
+  for (size_t added = 0; added < EMPTY_WORKS_NUMBER; )
+  {
+    if (batched)
+    {
+      if (tpool_add_works(tpool, batch, BATCH_SIZE) != TPOOL_SUCCESS) fail("add works");
+
+      added += BATCH_SIZE;
+    }
+    else
+    {
+      if (tpool_add_work(tpool, count_routine, &done) != TPOOL_SUCCESS) fail("add a work");
+
+      added++;
+    }
+  }
+
+  size_t total = batched ? (EMPTY_WORKS_NUMBER + BATCH_SIZE - 1) / BATCH_SIZE * BATCH_SIZE : EMPTY_WORKS_NUMBER;
+
+  wait_for(&done, total);
+
+  uint64_t elapsed_ns = bench_now_ns() - started_ns;
+
+  bench_result_begin(batched ? "tpool_add_works" : "tpool_add_work");
+  bench_param("threads", threads);
+  bench_throughput(total, elapsed_ns);
+  bench_result_end();
+
+  pool_destroy(tpool);
+}
+
+static void latency_routine(void * arg)
+{
+  latency_sample_t * sample = arg;
+
+  *sample->p_latency_ns = bench_now_ns() - sample->submitted_ns;
+
+  atomic_fetch_add_explicit(sample->started, 1, memory_order_release);
+}
+
+/**
+ * Idle: each work is submitted after the previous one ran, to pools with
+ * nothing else to do. Burst: all of them are submitted at once.
+ */
+static void bench_latency_of(size_t threads, bool burst)
+{
+  tpool_t * tpool = pool_create(threads);
+
+  latency_sample_t * samples   = malloc(sizeof(latency_sample_t) * LATENCY_SAMPLES);
+  uint64_t         * latencies = malloc(sizeof(uint64_t) * LATENCY_SAMPLES);
+
+  if (samples == NULL || latencies == NULL) fail("allocate samples");
+
+  atomic_size_t started;
+
+  atomic_init(&started, 0);
+
+  for (size_t i = 0; i < LATENCY_SAMPLES; i++)
+  {
+    samples[i].p_latency_ns = &latencies[i];
+    samples[i].started      = &started;
+    samples[i].submitted_ns = bench_now_ns();
+
+    if (tpool_add_work(tpool, latency_routine, &samples[i]) != TPOOL_SUCCESS) fail("add a work");
+
+    if (!burst) wait_for(&started, i + 1);
+  }
+
+  wait_for(&started, LATENCY_SAMPLES);
+
+  bench_result_begin("submit_to_start");
+  bench_param_str("load", burst ? "burst" : "idle");
+  bench_param("threads", threads);
+  bench_latency(latencies, LATENCY_SAMPLES);
+  bench_result_end();
+
+  free(samples);
+  free(latencies);
+
+  pool_destroy(tpool);
+}
+
+static uint64_t fib_serial(size_t n)
+{
+  return n < 2 ? n : fib_serial(n - 1) + fib_serial(n - 2);
+}
+
+/**
+ * Forks fib(n - 1) into a group and computes fib(n - 2) meanwhile.
+ */
+static void fib_routine(void * arg)
+{
+  fib_t * fib = arg;
+
+  if (fib->n < FIB_CUTOFF)
+  {
+    fib->result = fib_serial(fib->n);
+    return;
+  }
+
+  fib_t left  = { .tpool = fib->tpool, .n = fib->n - 1 };
+  fib_t right = { .tpool = fib->tpool, .n = fib->n - 2 };
+
+  tpool_group_t * group = NULL;
+
+  if (tpool_group_create(fib->tpool, &group) != TPOOL_SUCCESS) fail("create a group");
+  if (tpool_group_add_work(group, fib_routine, &left) != TPOOL_SUCCESS) fail("add a work");
+
+  fib_routine(&right);
+
+  if (tpool_group_wait(group) != TPOOL_SUCCESS) fail("wait for a group");
+
+  tpool_group_destroy(group);
+
+  fib->result = left.result + right.result;
+}
+
+static void bench_fib(size_t threads)
+{
+  tpool_t * tpool = pool_create(threads);
+
+  fib_t fib = { .tpool = tpool, .n = FIB_N };
+
+  tpool_group_t * group = NULL;
+
+  uint64_t started_ns = bench_now_ns();
+
+  if (tpool_group_create(tpool, &group) != TPOOL_SUCCESS) fail("create a group");
+  if (tpool_group_add_work(group, fib_routine, &fib) != TPOOL_SUCCESS) fail("add a work");
+  if (tpool_group_wait(group) != TPOOL_SUCCESS) fail("wait for a group");
+
+  uint64_t elapsed_ns = bench_now_ns() - started_ns;
+
+  tpool_group_destroy(group);
+
+  if (fib.result != fib_serial(FIB_N)) fail("compute fib");
+
+  bench_result_begin("fork_join_fib");
+  bench_param("threads", threads);
+  bench_param("n", FIB_N);
+  bench_param("cutoff", FIB_CUTOFF);
+  bench_metric("seconds", (double) elapsed_ns / 1e9);
+  bench_result_end();
+
+  pool_destroy(tpool);
+}
+
+static void sum_body(size_t begin, size_t end, void * partial, void * context)
+{
+  const uint64_t * elements = context;
+
+  uint64_t sum = *(uint64_t *) partial;
+
+  for (size_t i = begin; i < end; i++) sum += elements[i];
+
+  *(uint64_t *) partial = sum;
+}
+
+static void sum_join(void * partial, const void * other, void * context)
+{
+  (void) context;
+
+  *(uint64_t *) partial += *(const uint64_t *) other;
+}
+
+static void bench_parallel_sum(size_t threads, const uint64_t * elements)
+{
+  tpool_t * tpool = pool_create(threads);
+
+  uint64_t sum = 0;
+
+  uint64_t started_ns = bench_now_ns();
+
+  if (tpool_parallel_reduce(tpool, 0, SUM_ELEMENTS, 0, &sum, sizeof(sum),
+                            sum_body, sum_join, (void *) elements) != TPOOL_SUCCESS)
+  {
+    fail("reduce");
+  }
+
+  uint64_t elapsed_ns = bench_now_ns() - started_ns;
+
+  if (sum != (uint64_t) SUM_ELEMENTS * (SUM_ELEMENTS - 1) / 2) fail("compute the sum");
+
+  bench_result_begin("parallel_sum");
+  bench_param("threads", threads);
+  bench_throughput(SUM_ELEMENTS, elapsed_ns);
+  bench_result_end();
+
+  pool_destroy(tpool);
+}
+
+int main(void)
+{
+  uint64_t * elements = malloc(sizeof(uint64_t) * SUM_ELEMENTS);
+
+  if (elements == NULL) fail("allocate elements");
+
+  for (size_t i = 0; i < SUM_ELEMENTS; i++) elements[i] = i;
+
+  bench_suite_begin("tpool");
+
+  for (size_t threads = 1; threads != 0; threads = bench_threads_next(threads))
+  {
+    bench_empty_works(threads, false);
+    bench_empty_works(threads, true);
+    bench_latency_of(threads, false);
+    bench_latency_of(threads, true);
+    bench_fib(threads);
+    bench_parallel_sum(threads, elements);
+  }
+
+  bench_suite_end();
+
+  free(elements);
+
+  return EXIT_SUCCESS;
+}
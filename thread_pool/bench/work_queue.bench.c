@@ -0,0 +1,161 @@
+/**
+ * Throughput of work queues: producers push works one by one while
+ * consumers pop them, for both the locked and the lock-free queue.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "work_queue.h"
+
+#include "bench.h"
+
+#define WORKS_NUMBER   1000000
+#define RING_CAPACITY  4096
+
+typedef struct bench_queue_s
+{
+  work_queue_t * queue;
+
+  size_t         works_per_producer;
+  atomic_size_t  popped;
+  size_t         total;
+
+  atomic_bool    go;
+} bench_queue_t;
+
+static void nop(void * arg)
+{
+  (void) arg;
+}
+
+static void wait_for_go(bench_queue_t * bench)
+{
+  while (!atomic_load_explicit(&bench->go, memory_order_acquire)) sched_yield();
+}
+
+static void * producer_routine(void * arg)
+{
+  bench_queue_t * bench = arg;
+
+  work_t work = { .routine = nop, .arg = NULL };
+
+  wait_for_go(bench);
+
+  for (size_t i = 0; i < bench->works_per_producer; i++)
+  {
+    // the lock-free queue is bounded
+    while (work_queue_push(bench->queue, &work) != E_OK) sched_yield();
+  }
+
+  return NULL;
+}
+
+static void * consumer_routine(void * arg)
+{
+  bench_queue_t * bench = arg;
+
+  work_t work;
+
+  wait_for_go(bench);
+
+  while (atomic_load_explicit(&bench->popped, memory_order_relaxed) < bench->total)
+  {
+    if (work_queue_pop(bench->queue, &work) == E_OK)
+    {
+      atomic_fetch_add_explicit(&bench->popped, 1, memory_order_relaxed);
+    }
+    else
+    {
+      sched_yield();
+    }
+  }
+
+  return NULL;
+}
+
+static void bench_push_pop(const char * kind, bool lockfree, size_t producers, size_t consumers)
+{
+  bench_queue_t bench;
+
+  bench.queue = lockfree ? work_queue_create_lockfree(RING_CAPACITY) : work_queue_create();
+
+  if (bench.queue == NULL)
+  {
+    fprintf(stderr, "failed to create a %s work queue\n", kind);
+    exit(EXIT_FAILURE);
+  }
+
+  bench.works_per_producer = WORKS_NUMBER / producers;
+  bench.total              = bench.works_per_producer * producers;
+
+  atomic_init(&bench.popped, 0);
+  atomic_init(&bench.go,     false);
+
+  pthread_t threads[producers + consumers];
+
+  for (size_t i = 0; i < producers + consumers; i++)
+  {
+    void * (* routine)(void *) = i < producers ? producer_routine : consumer_routine;
+
+    if (pthread_create(&threads[i], NULL, routine, &bench) != 0)
+    {
+      fprintf(stderr, "failed to start a thread\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  uint64_t started_ns = bench_now_ns();
+
+  atomic_store_explicit(&bench.go, true, memory_order_release);
+
+  for (size_t i = 0; i < producers + consumers; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+
+  uint64_t elapsed_ns = bench_now_ns() - started_ns;
+
+  bench_result_begin("work_queue_push_pop");
+  bench_param_str("queue", kind);
+  bench_param("producers", producers);
+  bench_param("consumers", consumers);
+  bench_throughput(bench.total, elapsed_ns);
+  bench_result_end();
+
+  work_queue_destroy(bench.queue);
+}
+
+int main(void)
+{
+  static const struct
+  {
+    const char * name;
+    bool         lockfree;
+  } kinds[] =
+  {
+    { "locked",   false },
+    { "lockfree", true  },
+  };
+
+  bench_suite_begin("work_queue");
+
+  for (size_t kind = 0; kind < sizeof(kinds) / sizeof(kinds[0]); kind++)
+  {
+    for (size_t producers = 1; producers != 0; producers = bench_threads_next(producers))
+    {
+      for (size_t consumers = 1; consumers != 0; consumers = bench_threads_next(consumers))
+      {
+        bench_push_pop(kinds[kind].name, kinds[kind].lockfree, producers, consumers);
+      }
+    }
+  }
+
+  bench_suite_end();
+
+  return EXIT_SUCCESS;
+}
@@ -1,9 +1,15 @@
 #ifndef TPOOL_H
 #define TPOOL_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
-typedef struct tpool_s tpool_t;
+typedef struct tpool_s        tpool_t;
+typedef struct tpool_future_s tpool_future_t;
+typedef struct tpool_group_s  tpool_group_t;
+typedef struct tpool_graph_s  tpool_graph_t;
+typedef struct tpool_timer_s  tpool_timer_t;
 
 typedef enum tpool_ret_e
 {
@@ -12,10 +18,191 @@ typedef enum tpool_ret_e
   TPOOL_EMEMALLOC    = 2,
   TPOOL_EREQREJECTED = 3,
   TPOOL_EINVARG,
+  TPOOL_EQUEUEFULL,
+  TPOOL_ENOTREADY,
+  TPOOL_ECANCELED,
 } tpool_ret_t;
 
 typedef void (* tpool_work_routine_t)(void * context);
 
+typedef void * (* tpool_task_routine_t)(void * context);
+
+/* Processes indices in [begin, end). */
+typedef void (* tpool_range_routine_t)(size_t begin, size_t end, void * context);
+
+/* Accumulates indices in [begin, end) into `partial`. */
+typedef void (* tpool_reduce_routine_t)(size_t begin, size_t end, void * partial, void * context);
+
+/* Accumulates `other` into `partial`, should be associative. */
+typedef void (* tpool_join_routine_t)(void * partial, const void * other, void * context);
+
+typedef struct tpool_work_s
+{
+  tpool_work_routine_t   routine;
+  void                 * arg;
+} tpool_work_t;
+
+typedef enum tpool_priority_e
+{
+  TPOOL_PRIORITY_HIGH = 0,
+  TPOOL_PRIORITY_NORMAL,
+  TPOOL_PRIORITY_LOW,
+
+  TPOOL_PRIORITIES_NUMBER,
+} tpool_priority_t;
+
+typedef enum tpool_queue_e
+{
+  /* Unbounded queue guarded by a mutex. */
+  TPOOL_QUEUE_LOCKED = 0,
+
+  /* Bounded lock-free queue, submitting to the full one is rejected. */
+  TPOOL_QUEUE_LOCKFREE,
+
+  /* Bounded queue guarded by a mutex, submitting to the full one blocks
+   * till threads take works from it, so producers are held back instead
+   * of the queue growing without limit. Shutting the pool down rejects
+   * blocked submissions. Threads of the pool never block, works they
+   * submit at the normal priority do not go through the queue, others
+   * are rejected with TPOOL_EQUEUEFULL while it is full. Timers never
+   * block either, their works wait for room on later ticks. */
+  TPOOL_QUEUE_BOUNDED,
+} tpool_queue_t;
+
+typedef enum tpool_affinity_e
+{
+  /* Threads run wherever the scheduler puts them. */
+  TPOOL_AFFINITY_NONE = 0,
+
+  /* The i-th thread runs on the CPU `cpus[i % cpus_number]` only. */
+  TPOOL_AFFINITY_CPUS,
+
+  /* Threads are spread evenly across NUMA nodes and run on CPUs of their
+   * node only. Each node used gets a work queue of its own, threads take
+   * works from the other ones only when theirs is empty. */
+  TPOOL_AFFINITY_NUMA,
+} tpool_affinity_t;
+
+typedef struct tpool_config_s
+{
+  size_t        threads_number;
+
+  tpool_queue_t queue;
+  size_t        queue_capacity;  /* Per priority for TPOOL_QUEUE_LOCKFREE, of all
+                                    priorities for TPOOL_QUEUE_BOUNDED. */
+
+  /* Higher priorities are served first, but every `priority_aging`-th
+   * take from the work queue serves lower ones first, so they do not
+   * starve. 0 disables aging. */
+  size_t        priority_aging;
+
+  /* Most works a thread takes from the work queue at once, it takes
+   * no more than its fair share of the queue (depth / threads) though. */
+  size_t        grab_size;
+
+  /* A thread that ran out of works spins up to `idle_spins` iterations,
+   * then yields the CPU up to `idle_yields` times, then sleeps.
+   * The actual spin budget adapts: it grows while works keep arriving
+   * during spinning and shrinks while the thread ends up sleeping. */
+  size_t        idle_spins;
+  size_t        idle_yields;
+
+  tpool_affinity_t affinity;
+  const size_t   * cpus;         /* Used by TPOOL_AFFINITY_CPUS only. */
+  size_t           cpus_number;
+
+  /* `threads_number` threads run all the time. Up to `max_threads_number`
+   * ones run while more than `grow_queue_depth` works wait and no thread
+   * is idle to take them, extra threads exit once idle for `keepalive_ns`.
+   * 0 keeps the number of threads fixed. */
+  size_t           max_threads_number;
+  size_t           grow_queue_depth;
+  uint64_t         keepalive_ns;
+
+  /* Stacks of threads, the system defaults unless changed. If `stacks`
+   * is not NULL, the i-th thread runs on the `stack_size` bytes at
+   * `stacks + i * stack_size`, so there should be room for as many
+   * threads as the pool may have, and `guard_size` is ignored. */
+  size_t           stack_size;
+  size_t           guard_size;
+  void           * stacks;
+
+  /* Measures how long works wait and run and how long threads idle,
+   * at the cost of reading the clock around every work and allocating
+   * a record per submitted work to carry its submission time. */
+  bool             metrics;
+
+  /* Events each thread keeps for `tpool_trace_dump()`: submissions of
+   * works and their starts and ends. The oldest ones are overwritten.
+   * Threads that are not the pool's share another ring of this size.
+   * 0 turns tracing off. */
+  size_t           trace_capacity;
+} tpool_config_t;
+
+#define TPOOL_DEFAULT_QUEUE_CAPACITY 4096
+#define TPOOL_DEFAULT_GRAB_SIZE      16
+#define TPOOL_DEFAULT_IDLE_SPINS     1024  /* 0 on single CPU systems */
+#define TPOOL_DEFAULT_IDLE_YIELDS    4
+#define TPOOL_DEFAULT_PRIORITY_AGING 32
+#define TPOOL_DEFAULT_KEEPALIVE_NS   10000000000ull
+
+#define TPOOL_HISTOGRAM_BUCKETS 32
+
+/* The i-th bucket counts durations of [2^i, 2^(i+1)) nanoseconds,
+ * the first one counts shorter ones too, the last one longer ones. */
+typedef struct tpool_histogram_s
+{
+  size_t buckets[TPOOL_HISTOGRAM_BUCKETS];
+} tpool_histogram_t;
+
+/* Counters of a thread, all of them since the pool was created.
+ * Times and histograms are measured with `metrics` configured only. */
+typedef struct tpool_worker_stats_s
+{
+  /* How idle periods of the thread ended. */
+  size_t idle_spun;         /* a work appeared while spinning */
+  size_t idle_yielded;      /* a work appeared while yielding */
+  size_t idle_parked;       /* the thread went to sleep */
+
+  size_t spurious_wakeups;  /* there was no work for the woken up thread */
+
+  size_t executed;
+  size_t stolen;            /* from other threads, executed ones included */
+
+  uint64_t running_ns;
+  uint64_t idle_ns;         /* parked time included */
+  uint64_t parked_ns;
+
+  tpool_histogram_t waited; /* since works were submitted till they started */
+  tpool_histogram_t ran;
+} tpool_worker_stats_t;
+
+typedef struct tpool_stats_s
+{
+  /* How idle periods of threads ended. */
+  size_t idle_spun;     /* a work appeared while spinning */
+  size_t idle_yielded;  /* a work appeared while yielding */
+  size_t idle_parked;   /* the thread went to sleep */
+
+  /* Works waiting in the work queue per priority. */
+  size_t queued[TPOOL_PRIORITIES_NUMBER];
+
+  /* Threads running, extra ones of elastic pools included. */
+  size_t threads_running;
+
+  /* Sums of the threads' counters, see `tpool_get_worker_stats()`. */
+  size_t spurious_wakeups;
+  size_t executed;
+  size_t stolen;
+
+  uint64_t running_ns;
+  uint64_t idle_ns;
+  uint64_t parked_ns;
+
+  tpool_histogram_t waited;
+  tpool_histogram_t ran;
+} tpool_stats_t;
+
 /**
  * @brief         Creates a thread pool.
  *
@@ -29,6 +216,29 @@ typedef void (* tpool_work_routine_t)(void * context);
  */
 tpool_ret_t tpool_create(tpool_t ** p_tpool, size_t threads_number);
 
+/**
+ * @brief         Fills the config with defaults, which are the ones
+ *                `tpool_create()` uses.
+ *
+ * @param[out]    config
+ * @param[in]     threads_number
+ */
+void tpool_config_init(tpool_config_t * config, size_t threads_number);
+
+/**
+ * @brief         Creates a thread pool as configured.
+ *
+ * @param[out]    p_tpool
+ * @param[in]     config   Should be initialized by `tpool_config_init()` first.
+ *
+ * @retval        TPOOL_SUCCESS    Instance is created successfully.
+ * @retval        TPOOL_EINVARG    Invalid arguments, including CPUs to run
+ *                                 on the process is not allowed to use.
+ * @retval        TPOOL_ESYSFAIL   Threads could not be started.
+ * @retval        TPOOL_EMEMALLOC  Failed to allocate memory.
+ */
+tpool_ret_t tpool_create_ex(tpool_t ** p_tpool, const tpool_config_t * config);
+
 /**
  * @brief         Destroys a thread pool.
  *
@@ -51,9 +261,448 @@ tpool_ret_t tpool_destroy(tpool_t * tpool);
  * @retval        TPOOL_EMEMALLOC     Failed to allocate memory.
  * @retval        TPOOL_EREQREJECTED  No longer accepts new works.
  * @retval        TPOOL_ESYSFAIL      System prevented from success.
+ * @retval        TPOOL_EQUEUEFULL    Bounded work queue is full.
  */
 tpool_ret_t tpool_add_work(tpool_t * tpool, tpool_work_routine_t routine, void * arg);
 
+/**
+ * @brief         Enqueues a new work at the given priority.
+ *
+ * @note          `tpool_add_work()` enqueues at TPOOL_PRIORITY_NORMAL. Such
+ *                works submitted from works of the pool stay with the thread
+ *                which submitted them, others go to the work queue.
+ *
+ * @param[in]     tpool     Instance to enqueue the work.
+ * @param[in]     priority
+ * @param[in]     routine   Work routine to be executed.
+ * @param[in]     arg       Argument to be passed to the routine.
+ *
+ * @retval        TPOOL_SUCCESS       Operation succeed.
+ * @retval        TPOOL_EINVARG       Invalid arguments.
+ * @retval        TPOOL_EMEMALLOC     Failed to allocate memory.
+ * @retval        TPOOL_EREQREJECTED  No longer accepts new works.
+ * @retval        TPOOL_ESYSFAIL      System prevented from success.
+ * @retval        TPOOL_EQUEUEFULL    Bounded work queue is full.
+ */
+tpool_ret_t tpool_add_work_prio(tpool_t * tpool, tpool_priority_t priority, tpool_work_routine_t routine, void * arg);
+
+/**
+ * @brief         Enqueues a new work to the work queue of the NUMA node,
+ *                so it is likely to run near the memory it touches.
+ *
+ * @note          Works submitted by `tpool_add_work()` from outside of the
+ *                pool go to the node of the CPU the submitting thread runs on.
+ *
+ * @param[in]     tpool    Instance to enqueue the work.
+ * @param[in]     node     Less than `tpool_nodes_number()`.
+ * @param[in]     routine  Work routine to be executed.
+ * @param[in]     arg      Argument to be passed to the routine.
+ *
+ * @retval        TPOOL_SUCCESS       Operation succeed.
+ * @retval        TPOOL_EINVARG       Invalid arguments.
+ * @retval        TPOOL_EMEMALLOC     Failed to allocate memory.
+ * @retval        TPOOL_EREQREJECTED  No longer accepts new works.
+ * @retval        TPOOL_ESYSFAIL      System prevented from success.
+ * @retval        TPOOL_EQUEUEFULL    Bounded work queue is full.
+ */
+tpool_ret_t tpool_add_work_on_node(tpool_t * tpool, size_t node, tpool_work_routine_t routine, void * arg);
+
+/**
+ * @brief         Number of NUMA nodes the pool's threads are spread across,
+ *                1 unless created with TPOOL_AFFINITY_NUMA.
+ *
+ * @param[in]     tpool
+ */
+size_t tpool_nodes_number(const tpool_t * tpool);
+
+/**
+ * @brief         Enqueues a batch of works at once.
+ *
+ * @note          The internal work queue is locked once per batch, and only
+ *                as many idle threads as there are new works are woken up.
+ *
+ * @note          Works are enqueued in order. On failure, the works preceding
+ *                the one that failed are enqueued and will be executed.
+ *
+ * @param[in]     tpool  Instance to enqueue the works.
+ * @param[in]     works  Works to be executed, routines should not be NULL.
+ * @param[in]     n      Number of works.
+ *
+ * @retval        TPOOL_SUCCESS       Operation succeed.
+ * @retval        TPOOL_EINVARG       Invalid arguments.
+ * @retval        TPOOL_EMEMALLOC     Failed to allocate memory.
+ * @retval        TPOOL_EREQREJECTED  No longer accepts new works.
+ * @retval        TPOOL_ESYSFAIL      System prevented from success.
+ * @retval        TPOOL_EQUEUEFULL    Bounded work queue is full.
+ */
+tpool_ret_t tpool_add_works(tpool_t * tpool, const tpool_work_t * works, size_t n);
+
+/**
+ * @brief         Enqueues a new work once the delay passes.
+ *
+ * @note          Timers have a resolution of a millisecond and never fire
+ *                early. They are run by an idle thread of the pool, or by
+ *                busy threads between works when none is idle. A work that
+ *                does not fit into the full queue is retried every tick.
+ *
+ * @param[in]     tpool     Instance to enqueue the work.
+ * @param[in]     delay_ns  Delay in nanoseconds.
+ * @param[in]     routine   Work routine to be executed.
+ * @param[in]     arg       Argument to be passed to the routine.
+ * @param[out]    p_timer   Handle to cancel the timer, may be NULL.
+ *                          Should be cancelled even once fired.
+ *
+ * @retval        TPOOL_SUCCESS       Operation succeed.
+ * @retval        TPOOL_EINVARG       Invalid arguments.
+ * @retval        TPOOL_EMEMALLOC     Failed to allocate memory.
+ * @retval        TPOOL_EREQREJECTED  No longer accepts new works.
+ * @retval        TPOOL_ESYSFAIL      System prevented from success.
+ */
+tpool_ret_t tpool_add_work_after(tpool_t * tpool, uint64_t delay_ns,
+                                 tpool_work_routine_t routine, void * arg, tpool_timer_t ** p_timer);
+
+/**
+ * @brief         Enqueues a new work every period, starting a period later.
+ *
+ * @note          Periods missed while the pool was too busy are skipped.
+ *
+ * @param[in]     tpool      Instance to enqueue the work.
+ * @param[in]     period_ns  Period in nanoseconds, should not be 0.
+ * @param[in]     routine    Work routine to be executed.
+ * @param[in]     arg        Argument to be passed to the routine.
+ * @param[out]    p_timer    Handle to cancel the timer, may be NULL,
+ *                           then the timer runs till the pool is shutdown.
+ *
+ * @retval        TPOOL_SUCCESS       Operation succeed.
+ * @retval        TPOOL_EINVARG       Invalid arguments.
+ * @retval        TPOOL_EMEMALLOC     Failed to allocate memory.
+ * @retval        TPOOL_EREQREJECTED  No longer accepts new works.
+ * @retval        TPOOL_ESYSFAIL      System prevented from success.
+ */
+tpool_ret_t tpool_add_work_every(tpool_t * tpool, uint64_t period_ns,
+                                 tpool_work_routine_t routine, void * arg, tpool_timer_t ** p_timer);
+
+/**
+ * @brief         Cancels the timer and releases its handle.
+ *
+ * @note          Works the timer already enqueued are still executed.
+ *                Handles are released by `tpool_destroy()` as well.
+ *
+ * @param[in]     timer
+ *
+ * @retval        TPOOL_SUCCESS   Operation succeed.
+ * @retval        TPOOL_EINVARG   Invalid arguments.
+ * @retval        TPOOL_ESYSFAIL  System prevented from success.
+ */
+tpool_ret_t tpool_timer_cancel(tpool_timer_t * timer);
+
+/**
+ * @brief         Enqueues a new work, whose result can be waited for.
+ *
+ * @note          The future should be released by `tpool_future_release()`
+ *                before the pool is destroyed.
+ *
+ * @param[in]     tpool     Instance to enqueue the work.
+ * @param[in]     routine   Work routine to be executed.
+ * @param[in]     arg       Argument to be passed to the routine.
+ * @param[out]    p_future  Handle to wait for the routine's result.
+ *
+ * @retval        TPOOL_SUCCESS       Operation succeed.
+ * @retval        TPOOL_EINVARG       Invalid arguments.
+ * @retval        TPOOL_EMEMALLOC     Failed to allocate memory.
+ * @retval        TPOOL_EREQREJECTED  No longer accepts new works.
+ * @retval        TPOOL_ESYSFAIL      System prevented from success.
+ * @retval        TPOOL_EQUEUEFULL    Bounded work queue is full.
+ */
+tpool_ret_t tpool_submit(tpool_t * tpool, tpool_task_routine_t routine, void * arg, tpool_future_t ** p_future);
+
+/**
+ * @brief         Blocks until the work is done or cancelled.
+ *
+ * @param[in]     future
+ * @param[out]    p_result  Value returned by the routine, may be NULL.
+ *
+ * @retval        TPOOL_SUCCESS    Operation succeed.
+ * @retval        TPOOL_EINVARG    Invalid arguments.
+ * @retval        TPOOL_ESYSFAIL   System prevented from success.
+ * @retval        TPOOL_ECANCELED  The work was cancelled, no result.
+ */
+tpool_ret_t tpool_future_wait(tpool_future_t * future, void ** p_result);
+
+/**
+ * @brief         Gets the result if the work is done, does not block.
+ *
+ * @param[in]     future
+ * @param[out]    p_result  Value returned by the routine, may be NULL.
+ *
+ * @retval        TPOOL_SUCCESS    Operation succeed.
+ * @retval        TPOOL_EINVARG    Invalid arguments.
+ * @retval        TPOOL_ENOTREADY  The work is not done yet.
+ * @retval        TPOOL_ECANCELED  The work was cancelled, no result.
+ */
+tpool_ret_t tpool_future_try_get(tpool_future_t * future, void ** p_result);
+
+/**
+ * @brief         Cancels the work, unless it has started already.
+ *
+ * @note          The work stays enqueued, but is skipped at no cost once
+ *                taken. Waiters of the future are unblocked right away.
+ *
+ * @param[in]     future
+ *
+ * @retval        TPOOL_SUCCESS       The work will not be executed.
+ * @retval        TPOOL_EINVARG       Invalid arguments.
+ * @retval        TPOOL_EREQREJECTED  The work has started already.
+ */
+tpool_ret_t tpool_cancel(tpool_future_t * future);
+
+/**
+ * @brief         Releases the future, which must not be used afterwards.
+ *
+ * @note          The work is not cancelled, it is just not waited for anymore.
+ *
+ * @param[in]     future
+ *
+ * @retval        TPOOL_SUCCESS  Operation succeed.
+ * @retval        TPOOL_EINVARG  Invalid arguments.
+ */
+tpool_ret_t tpool_future_release(tpool_future_t * future);
+
+/**
+ * @brief         Creates a group of works to wait for together.
+ *
+ * @param[in]     tpool    Instance to enqueue the works of the group.
+ * @param[out]    p_group
+ *
+ * @retval        TPOOL_SUCCESS    Instance is created successfully.
+ * @retval        TPOOL_EINVARG    Invalid arguments.
+ * @retval        TPOOL_ESYSFAIL   System prevented from success.
+ * @retval        TPOOL_EMEMALLOC  Failed to allocate memory.
+ */
+tpool_ret_t tpool_group_create(tpool_t * tpool, tpool_group_t ** p_group);
+
+/**
+ * @brief         Destroys a group.
+ *
+ * @param[in]     group  Should have no works pending, see `tpool_group_wait()`.
+ *
+ * @retval        TPOOL_SUCCESS  Operation succeed.
+ * @retval        TPOOL_EINVARG  Invalid arguments.
+ */
+tpool_ret_t tpool_group_destroy(tpool_group_t * group);
+
+/**
+ * @brief         Enqueues a new work as a part of the group.
+ *
+ * @param[in]     group    Group to add the work to.
+ * @param[in]     routine  Work routine to be executed.
+ * @param[in]     arg      Argument to be passed to the routine.
+ *
+ * @retval        TPOOL_SUCCESS       Operation succeed.
+ * @retval        TPOOL_EINVARG       Invalid arguments.
+ * @retval        TPOOL_EMEMALLOC     Failed to allocate memory.
+ * @retval        TPOOL_EREQREJECTED  No longer accepts new works.
+ * @retval        TPOOL_ESYSFAIL      System prevented from success.
+ * @retval        TPOOL_EQUEUEFULL    Bounded work queue is full.
+ */
+tpool_ret_t tpool_group_add_work(tpool_group_t * group, tpool_work_routine_t routine, void * arg);
+
+/**
+ * @brief         Cancels the works of the group that have not started.
+ *
+ * @note          They are skipped at no cost once taken, as well as works
+ *                added to the group till `tpool_group_wait()` returns.
+ *
+ * @param[in]     group
+ *
+ * @retval        TPOOL_SUCCESS  Operation succeed.
+ * @retval        TPOOL_EINVARG  Invalid arguments.
+ */
+tpool_ret_t tpool_group_cancel(tpool_group_t * group);
+
+/**
+ * @brief         Blocks until all the works of the group are done.
+ *
+ * @note          Called from a work of the same pool, the thread executes
+ *                other works of the pool while waiting instead of blocking,
+ *                so works may wait for the works they spawned.
+ *
+ * @param[in]     group
+ *
+ * @retval        TPOOL_SUCCESS   Operation succeed.
+ * @retval        TPOOL_EINVARG   Invalid arguments.
+ * @retval        TPOOL_ESYSFAIL  System prevented from success.
+ */
+tpool_ret_t tpool_group_wait(tpool_group_t * group);
+
+/**
+ * @brief         Calls `body` for subranges of [begin, end) in parallel,
+ *                blocks until the whole range is processed.
+ *
+ * @note          The range is split in halves recursively down to `grain`
+ *                indices, the calling thread processes subranges as well.
+ *                Called from a work, the thread helps as `tpool_group_wait()`.
+ *
+ * @param[in]     tpool
+ * @param[in]     begin
+ * @param[in]     end
+ * @param[in]     grain    Most indices per `body` call, 0 to choose it
+ *                         from the range size and the threads number.
+ * @param[in]     body
+ * @param[in]     context  Argument to be passed to the body.
+ *
+ * @retval        TPOOL_SUCCESS    Operation succeed.
+ * @retval        TPOOL_EINVARG    Invalid arguments.
+ * @retval        TPOOL_EMEMALLOC  Failed to allocate memory.
+ * @retval        TPOOL_ESYSFAIL   System prevented from success.
+ */
+tpool_ret_t tpool_parallel_for(tpool_t * tpool, size_t begin, size_t end, size_t grain,
+                               tpool_range_routine_t body, void * context);
+
+/**
+ * @brief         Reduces [begin, end) in parallel into `result`,
+ *                blocks until the whole range is processed.
+ *
+ * @note          Subranges are split as by `tpool_parallel_for()`. Each one
+ *                is accumulated by `body` into its own partial initialized
+ *                with the initial `result`, then partials are joined into
+ *                `result` in the order of subranges.
+ *
+ * @param[in]     tpool
+ * @param[in]     begin
+ * @param[in]     end
+ * @param[in]     grain        As for `tpool_parallel_for()`.
+ * @param[in,out] result       Holds the identity value initially.
+ * @param[in]     result_size  Size of the value in bytes.
+ * @param[in]     body
+ * @param[in]     join
+ * @param[in]     context      Argument to be passed to the routines.
+ *
+ * @retval        TPOOL_SUCCESS    Operation succeed.
+ * @retval        TPOOL_EINVARG    Invalid arguments.
+ * @retval        TPOOL_EMEMALLOC  Failed to allocate memory.
+ * @retval        TPOOL_ESYSFAIL   System prevented from success.
+ */
+tpool_ret_t tpool_parallel_reduce(tpool_t * tpool, size_t begin, size_t end, size_t grain,
+                                  void * result, size_t result_size,
+                                  tpool_reduce_routine_t body, tpool_join_routine_t join,
+                                  void * context);
+
+/**
+ * @brief         Creates an empty graph of works with dependencies.
+ *
+ * @param[in]     tpool    Instance to execute the works of the graph.
+ * @param[out]    p_graph
+ *
+ * @retval        TPOOL_SUCCESS    Instance is created successfully.
+ * @retval        TPOOL_EINVARG    Invalid arguments.
+ * @retval        TPOOL_ESYSFAIL   System prevented from success.
+ * @retval        TPOOL_EMEMALLOC  Failed to allocate memory.
+ */
+tpool_ret_t tpool_graph_create(tpool_t * tpool, tpool_graph_t ** p_graph);
+
+/**
+ * @brief         Destroys a graph, which should not be running.
+ *
+ * @param[in]     graph
+ *
+ * @retval        TPOOL_SUCCESS  Operation succeed.
+ * @retval        TPOOL_EINVARG  Invalid arguments.
+ */
+tpool_ret_t tpool_graph_destroy(tpool_graph_t * graph);
+
+/**
+ * @brief         Adds a work to the graph.
+ *
+ * @param[in]     graph
+ * @param[in]     routine  Work routine to be executed on each run.
+ * @param[in]     arg      Argument to be passed to the routine.
+ * @param[out]    p_node   Index of the node, may be NULL.
+ *
+ * @retval        TPOOL_SUCCESS    Operation succeed.
+ * @retval        TPOOL_EINVARG    Invalid arguments.
+ * @retval        TPOOL_EMEMALLOC  Failed to allocate memory.
+ */
+tpool_ret_t tpool_graph_add_node(tpool_graph_t * graph, tpool_work_routine_t routine, void * arg, size_t * p_node);
+
+/**
+ * @brief         Makes the node `to` start only after the node `from` is done.
+ *
+ * @param[in]     graph
+ * @param[in]     from
+ * @param[in]     to
+ *
+ * @retval        TPOOL_SUCCESS    Operation succeed.
+ * @retval        TPOOL_EINVARG    Invalid arguments.
+ * @retval        TPOOL_EMEMALLOC  Failed to allocate memory.
+ */
+tpool_ret_t tpool_graph_add_edge(tpool_graph_t * graph, size_t from, size_t to);
+
+/**
+ * @brief         Executes all the works of the graph, each one as soon as
+ *                the ones it depends on are done, blocks until all are done.
+ *
+ * @note          Graphs may be run many times, memory is allocated only on
+ *                the first run after nodes or edges were added. Called from
+ *                a work, the thread helps as `tpool_group_wait()`.
+ *
+ * @param[in]     graph
+ *
+ * @retval        TPOOL_SUCCESS    Operation succeed.
+ * @retval        TPOOL_EINVARG    Invalid arguments, or the graph has a cycle.
+ * @retval        TPOOL_EMEMALLOC  Failed to allocate memory.
+ * @retval        TPOOL_ESYSFAIL   System prevented from success.
+ */
+tpool_ret_t tpool_graph_run(tpool_graph_t * graph);
+
+/**
+ * @brief         Collects statistics of the pool.
+ *
+ * @note          Counters are gathered without stopping threads,
+ *                so they may be slightly behind.
+ *
+ * @param[in]     tpool
+ * @param[out]    stats
+ *
+ * @retval        TPOOL_SUCCESS  Operation succeed.
+ * @retval        TPOOL_EINVARG  Invalid arguments.
+ */
+tpool_ret_t tpool_get_stats(tpool_t * tpool, tpool_stats_t * stats);
+
+/**
+ * @brief         Collects statistics of a thread of the pool.
+ *
+ * @note          Threads of elastic pools share counters with the ones
+ *                which ran in the same slot before them.
+ *
+ * @param[in]     tpool
+ * @param[in]     worker  Less than the maximal number of threads.
+ * @param[out]    stats
+ *
+ * @retval        TPOOL_SUCCESS  Operation succeed.
+ * @retval        TPOOL_EINVARG  Invalid arguments.
+ */
+tpool_ret_t tpool_get_worker_stats(tpool_t * tpool, size_t worker, tpool_worker_stats_t * stats);
+
+/**
+ * @brief         Writes the traced events in Chrome trace JSON format,
+ *                which Perfetto and chrome://tracing open.
+ *
+ * @note          Works are named by addresses of their routines. May be
+ *                called while the pool runs, events being overwritten
+ *                meanwhile are left out. Without `trace_capacity`
+ *                configured, a trace with no events is written.
+ *
+ * @param[in]     tpool
+ * @param[in]     fd     File descriptor to write to.
+ *
+ * @retval        TPOOL_SUCCESS    Operation succeed.
+ * @retval        TPOOL_EINVARG    Invalid arguments.
+ * @retval        TPOOL_EMEMALLOC  Failed to allocate memory.
+ * @retval        TPOOL_ESYSFAIL   Writing failed.
+ */
+tpool_ret_t tpool_trace_dump(tpool_t * tpool, int fd);
+
 /**
  * @brief         Stops accepting new works.
  *
@@ -0,0 +1,329 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "completion.h"
+
+/**
+ * Number of condition variables shared by the records.
+ */
+#define COMPLETION_STRIPES 16
+
+/**
+ * Number of records allocated at once when the pool runs out of them.
+ */
+#define COMPLETION_SLAB_SIZE 64
+
+enum completion_state_e
+{
+  COMPLETION_DONE      = 1 << 0,
+  COMPLETION_WAITED    = 1 << 1,
+  COMPLETION_RELEASED  = 1 << 2,
+  COMPLETION_STARTED   = 1 << 3,
+  COMPLETION_CANCELLED = 1 << 4,
+
+  /* nothing to wait for anymore */
+  COMPLETION_SETTLED   = COMPLETION_DONE | COMPLETION_CANCELLED,
+};
+
+struct completion_s
+{
+  completion_pool_t * pool;
+
+  completion_routine_t   routine;
+  void                 * arg;
+
+  atomic_uint            state;
+  void                 * result;
+
+  completion_t * next; // in the free list
+};
+
+typedef struct completion_slab_s completion_slab_t;
+
+struct completion_slab_s
+{
+  completion_slab_t * next;
+  completion_t        records[COMPLETION_SLAB_SIZE];
+};
+
+typedef struct completion_stripe_s
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t  done_cv;
+} completion_stripe_t;
+
+struct completion_pool_s
+{
+  pthread_mutex_t     mutex; // guards `free` and `slabs`
+
+  completion_t      * free;
+  completion_slab_t * slabs;
+
+  completion_stripe_t stripes[COMPLETION_STRIPES];
+};
+
+static completion_stripe_t * completion_stripe(completion_t * completion)
+{
+  uintptr_t address = (uintptr_t) completion / sizeof(completion_t);
+
+  return &completion->pool->stripes[address % COMPLETION_STRIPES];
+}
+
+completion_pool_t * completion_pool_create(void)
+{
+  completion_pool_t * pool = NULL;
+
+  size_t stripes_initialized = 0;
+
+  TRY_NEW(1, pool = malloc(sizeof(completion_pool_t)));
+  TRY_EOK(2, pthread_mutex_init(&pool->mutex, NULL));
+
+  for (; stripes_initialized < COMPLETION_STRIPES; stripes_initialized++)
+  {
+    completion_stripe_t * stripe = &pool->stripes[stripes_initialized];
+
+    TRY_EOK(3, pthread_mutex_init(&stripe->mutex, NULL));
+
+    if (pthread_cond_init(&stripe->done_cv, NULL) != 0)
+    {
+      pthread_mutex_destroy(&stripe->mutex);
+      goto try_failure_3;
+    }
+  }
+
+  pool->free  = NULL;
+  pool->slabs = NULL;
+
+  return pool;
+
+try_failure_3:
+  while (stripes_initialized-- > 0)
+  {
+    pthread_cond_destroy(&pool->stripes[stripes_initialized].done_cv);
+    pthread_mutex_destroy(&pool->stripes[stripes_initialized].mutex);
+  }
+
+  pthread_mutex_destroy(&pool->mutex);
+try_failure_2: free(pool);
+try_failure_1: return NULL;
+}
+
+void completion_pool_destroy(completion_pool_t * pool)
+{
+  if (pool == NULL) return;
+
+  while (pool->slabs != NULL)
+  {
+    completion_slab_t * slab = pool->slabs;
+
+    pool->slabs = slab->next;
+    free(slab);
+  }
+
+  for (size_t i = 0; i < COMPLETION_STRIPES; i++)
+  {
+    asserting_eok(pthread_cond_destroy(&pool->stripes[i].done_cv));
+    asserting_eok(pthread_mutex_destroy(&pool->stripes[i].mutex));
+  }
+
+  asserting_eok(pthread_mutex_destroy(&pool->mutex));
+
+  free(pool);
+}
+
+/**
+ * Should be called with the pool's mutex locked.
+ */
+static bool completion_pool_grow(completion_pool_t * pool)
+{
+  completion_slab_t * slab = malloc(sizeof(completion_slab_t));
+
+  if (slab == NULL) return false;
+
+  for (size_t i = 0; i < COMPLETION_SLAB_SIZE; i++)
+  {
+    slab->records[i].pool = pool;
+    slab->records[i].next = pool->free;
+
+    pool->free = &slab->records[i];
+  }
+
+  slab->next  = pool->slabs;
+  pool->slabs = slab;
+
+  return true;
+}
+
+completion_t * completion_acquire(completion_pool_t * pool, completion_routine_t routine, void * arg)
+{
+  assert(pool    != NULL);
+  assert(routine != NULL);
+
+  completion_t * completion = NULL;
+
+  asserting_eok(pthread_mutex_lock(&pool->mutex));
+  {
+    if (pool->free != NULL || completion_pool_grow(pool))
+    {
+      completion = pool->free;
+      pool->free = completion->next;
+    }
+  }
+  asserting_eok(pthread_mutex_unlock(&pool->mutex));
+
+  if (completion != NULL)
+  {
+    completion->routine = routine;
+    completion->arg     = arg;
+    completion->result  = NULL;
+
+    atomic_init(&completion->state, 0);
+  }
+
+  return completion;
+}
+
+static void completion_recycle(completion_t * completion)
+{
+  completion_pool_t * pool = completion->pool;
+
+  asserting_eok(pthread_mutex_lock(&pool->mutex));
+  {
+    completion->next = pool->free;
+    pool->free       = completion;
+  }
+  asserting_eok(pthread_mutex_unlock(&pool->mutex));
+}
+
+static void completion_wake_waiters(completion_stripe_t * stripe)
+{
+  // the waiter sets the flag under the lock and then sleeps,
+  // so taking the lock ensures it is sleeping already
+  asserting_eok(pthread_mutex_lock(&stripe->mutex));
+  asserting_eok(pthread_cond_broadcast(&stripe->done_cv));
+  asserting_eok(pthread_mutex_unlock(&stripe->mutex));
+}
+
+void completion_run(void * arg)
+{
+  completion_t * completion = arg;
+
+  assert(completion != NULL);
+
+  // the record may be recycled right after the state changes
+  completion_stripe_t * stripe = completion_stripe(completion);
+
+  unsigned state = atomic_fetch_or_explicit(&completion->state, COMPLETION_STARTED, memory_order_acquire);
+
+  if (!(state & COMPLETION_CANCELLED))
+  {
+    completion->result = completion->routine(completion->arg);
+  }
+
+  unsigned old = atomic_fetch_or_explicit(&completion->state, COMPLETION_DONE, memory_order_acq_rel);
+
+  assert(!(old & COMPLETION_DONE) && "completed twice");
+
+  // the cancelling thread has woken them up
+  if ((old & COMPLETION_WAITED) && !(old & COMPLETION_CANCELLED))
+  {
+    completion_wake_waiters(stripe);
+  }
+
+  if (old & COMPLETION_RELEASED)
+  {
+    completion_recycle(completion);
+  }
+}
+
+bool completion_cancel(completion_t * completion)
+{
+  assert(completion != NULL);
+
+  unsigned state = atomic_load_explicit(&completion->state, memory_order_relaxed);
+
+  do
+  {
+    if (state & COMPLETION_CANCELLED) return true;
+    if (state & COMPLETION_STARTED)   return false;
+  }
+  while (!atomic_compare_exchange_weak_explicit(&completion->state, &state, state | COMPLETION_CANCELLED,
+                                                memory_order_acq_rel, memory_order_relaxed));
+
+  if (state & COMPLETION_WAITED)
+  {
+    completion_wake_waiters(completion_stripe(completion));
+  }
+
+  return true;
+}
+
+void completion_discard(completion_t * completion)
+{
+  assert(completion != NULL);
+  assert(atomic_load(&completion->state) == 0);
+
+  completion_recycle(completion);
+}
+
+void completion_release(completion_t * completion)
+{
+  assert(completion != NULL);
+
+  unsigned old = atomic_fetch_or_explicit(&completion->state, COMPLETION_RELEASED, memory_order_acq_rel);
+
+  assert(!(old & COMPLETION_RELEASED) && "released twice");
+
+  if (old & COMPLETION_DONE)
+  {
+    completion_recycle(completion);
+  }
+}
+
+bool completion_is_done(completion_t * completion)
+{
+  assert(completion != NULL);
+
+  return atomic_load_explicit(&completion->state, memory_order_acquire) & COMPLETION_SETTLED;
+}
+
+bool completion_is_cancelled(completion_t * completion)
+{
+  assert(completion != NULL);
+
+  return atomic_load_explicit(&completion->state, memory_order_acquire) & COMPLETION_CANCELLED;
+}
+
+err_t completion_wait(completion_t * completion)
+{
+  assert(completion != NULL);
+
+  if (completion_is_done(completion)) return E_OK;
+
+  completion_stripe_t * stripe = completion_stripe(completion);
+
+  MUTEX_LOCK(&stripe->mutex);
+  {
+    unsigned state = atomic_fetch_or_explicit(&completion->state, COMPLETION_WAITED, memory_order_acq_rel);
+
+    while (!(state & COMPLETION_SETTLED))
+    {
+      // other records of the stripe wake this one up too
+      asserting_eok(pthread_cond_wait(&stripe->done_cv, &stripe->mutex));
+
+      state = atomic_load_explicit(&completion->state, memory_order_acquire);
+    }
+  }
+  MUTEX_UNLOCK(&stripe->mutex);
+
+  return E_OK;
+}
+
+void * completion_result(completion_t * completion)
+{
+  assert(completion_is_done(completion));
+
+  return completion_is_cancelled(completion) ? NULL : completion->result;
+}
@@ -0,0 +1,79 @@
+#ifndef COMPLETION_H
+#define COMPLETION_H
+
+#include <stdbool.h>
+
+#include "internals/common.h"
+
+/**
+ * Pooled completion records.
+ *
+ * A record carries no synchronization primitives of its own: threads
+ * waiting for records sleep on a few condition variables shared by the
+ * whole pool, picked by the record's address.
+ *
+ * A record is returned to the pool once it is both completed and
+ * released, whichever happens last.
+ */
+typedef struct completion_pool_s completion_pool_t;
+typedef struct completion_s      completion_t;
+
+typedef void * (* completion_routine_t)(void * arg);
+
+completion_pool_t * completion_pool_create(void);
+
+/**
+ * Frees the records, including the ones not returned to the pool yet.
+ */
+void completion_pool_destroy(completion_pool_t * pool);
+
+/**
+ * Takes a record to complete with the result of `routine(arg)`.
+ *
+ * @return NULL if failed to allocate memory.
+ */
+completion_t * completion_acquire(completion_pool_t * pool, completion_routine_t routine, void * arg);
+
+/**
+ * Runs the routine, completes the record with its result and wakes up
+ * the waiters. Fits as a work routine.
+ *
+ * The routine is skipped if the record is cancelled.
+ */
+void completion_run(void * completion);
+
+/**
+ * Makes `completion_run()` skip the routine, wakes up the waiters.
+ *
+ * @return false if the routine has been started already.
+ */
+bool completion_cancel(completion_t * completion);
+
+/**
+ * Returns the record that was never run back to the pool.
+ */
+void completion_discard(completion_t * completion);
+
+/**
+ * Tells that the record is not going to be used by the acquirer anymore.
+ */
+void completion_release(completion_t * completion);
+
+/**
+ * Tells whether the record is completed or cancelled.
+ */
+bool completion_is_done(completion_t * completion);
+
+bool completion_is_cancelled(completion_t * completion);
+
+/**
+ * Blocks until the record is completed or cancelled.
+ */
+err_t completion_wait(completion_t * completion);
+
+/**
+ * Should be called only once the record is done, NULL if cancelled.
+ */
+void * completion_result(completion_t * completion);
+
+#endif
@@ -0,0 +1,366 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <assert.h>
+
+#include "internals/common.h"
+#include "internals/pool.h"
+
+#include "tpool.h"
+
+#define GRAPH_INITIAL_CAPACITY 16
+
+typedef struct graph_node_s graph_node_t;
+
+struct graph_node_s
+{
+  tpool_graph_t        * graph;
+
+  tpool_work_routine_t   routine;
+  void                 * arg;
+
+  size_t                 predecessors_number;
+
+  /* in the graph's `successors` */
+  size_t                 successors_first;
+  size_t                 successors_number;
+
+  /* predecessors yet to be done in the current run */
+  atomic_size_t          pending;
+
+  /* nodes the thread runs itself, linked at most once per run */
+  graph_node_t         * next_inline;
+};
+
+typedef struct graph_edge_s
+{
+  size_t from;
+  size_t to;
+} graph_edge_t;
+
+/**
+ * Edges are added to `edges`, and turned into per node lists of
+ * successors in `successors` before the next run, when `dirty`.
+ */
+struct tpool_graph_s
+{
+  tpool_t       * tpool;
+  tpool_group_t * group;
+
+  graph_node_t  * nodes;
+  size_t          nodes_number;
+  size_t          nodes_capacity;
+
+  graph_edge_t  * edges;
+  size_t          edges_number;
+  size_t          edges_capacity;
+
+  size_t        * successors;
+
+  bool            dirty;
+};
+
+/**
+ * Doubles the capacity of the array when it is full.
+ */
+static bool grow_if_full(void ** p_array, size_t * p_capacity, size_t number, size_t item_size)
+{
+  if (number < *p_capacity) return true;
+
+  size_t capacity = *p_capacity == 0 ? GRAPH_INITIAL_CAPACITY : *p_capacity * 2;
+
+  void * array = realloc(*p_array, capacity * item_size);
+
+  if (array == NULL) return false;
+
+  *p_array    = array;
+  *p_capacity = capacity;
+
+  return true;
+}
+
+tpool_ret_t tpool_graph_create(tpool_t * tpool, tpool_graph_t ** p_graph)
+{
+  CHECK_PARAM(tpool != NULL);
+  CHECK_PARAM(p_graph != NULL);
+
+  tpool_graph_t * graph = NULL;
+
+  TRY_NEW(1, graph = malloc(sizeof(tpool_graph_t)));
+
+  tpool_ret_t ret = tpool_group_create(tpool, &graph->group);
+
+  if (ret != TPOOL_SUCCESS)
+  {
+    free(graph);
+    return ret;
+  }
+
+  graph->tpool          = tpool;
+  graph->nodes          = NULL;
+  graph->nodes_number   = 0;
+  graph->nodes_capacity = 0;
+  graph->edges          = NULL;
+  graph->edges_number   = 0;
+  graph->edges_capacity = 0;
+  graph->successors     = NULL;
+  graph->dirty          = false;
+
+  *p_graph = graph;
+
+  return TPOOL_SUCCESS;
+
+try_failure_1: return TPOOL_EMEMALLOC;
+}
+
+tpool_ret_t tpool_graph_destroy(tpool_graph_t * graph)
+{
+  CHECK_PARAM(graph != NULL);
+
+  asserting(tpool_group_destroy(graph->group) == TPOOL_SUCCESS);
+
+  free(graph->nodes);
+  free(graph->edges);
+  free(graph->successors);
+  free(graph);
+
+  return TPOOL_SUCCESS;
+}
+
+tpool_ret_t tpool_graph_add_node(tpool_graph_t * graph, tpool_work_routine_t routine, void * arg, size_t * p_node)
+{
+  CHECK_PARAM(graph != NULL);
+  CHECK_PARAM(routine != NULL);
+
+  if (!grow_if_full((void **) &graph->nodes, &graph->nodes_capacity, graph->nodes_number, sizeof(graph_node_t)))
+  {
+    return TPOOL_EMEMALLOC;
+  }
+
+  graph_node_t * node = &graph->nodes[graph->nodes_number];
+
+  node->graph   = graph;
+  node->routine = routine;
+  node->arg     = arg;
+
+  atomic_init(&node->pending, 0);
+
+  if (p_node != NULL) *p_node = graph->nodes_number;
+
+  graph->nodes_number++;
+  graph->dirty = true;
+
+  return TPOOL_SUCCESS;
+}
+
+tpool_ret_t tpool_graph_add_edge(tpool_graph_t * graph, size_t from, size_t to)
+{
+  CHECK_PARAM(graph != NULL);
+  CHECK_PARAM(from < graph->nodes_number);
+  CHECK_PARAM(to < graph->nodes_number);
+
+  if (!grow_if_full((void **) &graph->edges, &graph->edges_capacity, graph->edges_number, sizeof(graph_edge_t)))
+  {
+    return TPOOL_EMEMALLOC;
+  }
+
+  graph->edges[graph->edges_number++] = (graph_edge_t) { .from = from, .to = to };
+  graph->dirty = true;
+
+  return TPOOL_SUCCESS;
+}
+
+/**
+ * Lays out successors of each node next to each other.
+ */
+static err_t graph_build_successors(tpool_graph_t * graph)
+{
+  size_t * successors = realloc(graph->successors, sizeof(size_t) * (graph->edges_number + 1));
+
+  if (successors == NULL) return E_MEMALLOC;
+
+  graph->successors = successors;
+
+  for (size_t i = 0; i < graph->nodes_number; i++)
+  {
+    graph->nodes[i].predecessors_number = 0;
+    graph->nodes[i].successors_number   = 0;
+  }
+
+  for (size_t i = 0; i < graph->edges_number; i++)
+  {
+    graph->nodes[graph->edges[i].from].successors_number++;
+    graph->nodes[graph->edges[i].to].predecessors_number++;
+  }
+
+  size_t first = 0;
+
+  for (size_t i = 0; i < graph->nodes_number; i++)
+  {
+    graph->nodes[i].successors_first = first;
+
+    first += graph->nodes[i].successors_number;
+
+    graph->nodes[i].successors_number = 0; // counted again below
+  }
+
+  for (size_t i = 0; i < graph->edges_number; i++)
+  {
+    graph_node_t * from = &graph->nodes[graph->edges[i].from];
+
+    successors[from->successors_first + from->successors_number++] = graph->edges[i].to;
+  }
+
+  return E_OK;
+}
+
+/**
+ * Kahn's algorithm, nodes in a cycle never run out of predecessors.
+ * `pending` and `next_inline` of nodes are used as scratch space.
+ */
+static bool graph_is_acyclic(tpool_graph_t * graph)
+{
+  graph_node_t * ready   = NULL;
+  size_t         visited = 0;
+
+  for (size_t i = 0; i < graph->nodes_number; i++)
+  {
+    graph_node_t * node = &graph->nodes[i];
+
+    atomic_store_explicit(&node->pending, node->predecessors_number, memory_order_relaxed);
+
+    if (node->predecessors_number == 0)
+    {
+      node->next_inline = ready;
+      ready             = node;
+    }
+  }
+
+  while (ready != NULL)
+  {
+    graph_node_t * node = ready;
+
+    ready = node->next_inline;
+    visited++;
+
+    for (size_t i = 0; i < node->successors_number; i++)
+    {
+      graph_node_t * successor = &graph->nodes[graph->successors[node->successors_first + i]];
+
+      if (atomic_fetch_sub_explicit(&successor->pending, 1, memory_order_relaxed) == 1)
+      {
+        successor->next_inline = ready;
+        ready                  = successor;
+      }
+    }
+  }
+
+  return visited == graph->nodes_number;
+}
+
+static void graph_node_routine(void * arg);
+
+/**
+ * Enqueues the node, or leaves it to the calling thread.
+ */
+static void graph_node_start(graph_node_t * node, graph_node_t ** p_inline)
+{
+  if (tpool_add_work(node->graph->tpool, graph_node_routine, node) != TPOOL_SUCCESS)
+  {
+    node->next_inline = *p_inline;
+    *p_inline         = node;
+  }
+}
+
+/**
+ * Runs the node, then starts the successors it was the last predecessor of.
+ * One of them is kept to run right away on the same thread.
+ */
+static void graph_node_routine(void * arg)
+{
+  graph_node_t * node = arg;
+
+  node->next_inline = NULL;
+
+  while (node != NULL)
+  {
+    tpool_graph_t * graph = node->graph;
+
+    graph_node_t * next = node->next_inline;
+
+    node->routine(node->arg);
+
+    graph_node_t * continuation = NULL;
+
+    for (size_t i = 0; i < node->successors_number; i++)
+    {
+      graph_node_t * successor = &graph->nodes[graph->successors[node->successors_first + i]];
+
+      if (atomic_fetch_sub_explicit(&successor->pending, 1, memory_order_acq_rel) != 1) continue;
+
+      if (continuation == NULL)
+      {
+        continuation = successor;
+      }
+      else
+      {
+        graph_node_start(successor, &next);
+      }
+    }
+
+    if (continuation != NULL)
+    {
+      continuation->next_inline = next;
+      next                      = continuation;
+    }
+
+    // the graph may be destroyed right after the last one leaves
+    tpool_group_leave(graph->group);
+
+    node = next;
+  }
+}
+
+tpool_ret_t tpool_graph_run(tpool_graph_t * graph)
+{
+  CHECK_PARAM(graph != NULL);
+
+  if (graph->dirty)
+  {
+    if (graph_build_successors(graph) != E_OK) return TPOOL_EMEMALLOC;
+
+    CHECK_PARAM(graph_is_acyclic(graph));
+
+    graph->dirty = false;
+  }
+
+  if (graph->nodes_number == 0) return TPOOL_SUCCESS;
+
+  for (size_t i = 0; i < graph->nodes_number; i++)
+  {
+    atomic_store_explicit(&graph->nodes[i].pending, graph->nodes[i].predecessors_number, memory_order_relaxed);
+  }
+
+  tpool_group_enter(graph->group, graph->nodes_number);
+
+  graph_node_t * inline_nodes = NULL;
+
+  for (size_t i = 0; i < graph->nodes_number; i++)
+  {
+    if (graph->nodes[i].predecessors_number == 0)
+    {
+      graph_node_start(&graph->nodes[i], &inline_nodes);
+    }
+  }
+
+  while (inline_nodes != NULL)
+  {
+    graph_node_t * node = inline_nodes;
+
+    inline_nodes = node->next_inline;
+
+    graph_node_routine(node);
+  }
+
+  return tpool_group_wait(graph->group);
+}
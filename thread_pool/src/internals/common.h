@@ -67,6 +67,17 @@ typedef enum err_e
     __builtin_unreachable();           \
   } while (0);
 
+/**
+ * Hints the CPU that the thread is spinning.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define CPU_RELAX() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define CPU_RELAX() do {} while (0)
+#endif
+
 /**
  * Locking a mutex asserts and returns E_SYSFAIL on failure.
  */
@@ -0,0 +1,31 @@
+#ifndef TPOOL_POOL_H
+#define TPOOL_POOL_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "tpool.h"
+
+/**
+ * Internals of the pool shared with the primitives built on top of it.
+ */
+
+#define CHECK_PARAM(expr)           \
+  do {                              \
+    if (!(expr))                    \
+    {                               \
+      fprintf(stderr, "[TPOOL_EINVARG]: invalid argument at %s(): %s\n", __FUNCTION__, #expr); \
+      return TPOOL_EINVARG;         \
+    }                               \
+  } while (0)
+
+size_t tpool_workers_number(const tpool_t * tpool);
+
+/**
+ * Counts `n` works as pending in the group without enqueuing them,
+ * each one should leave the group once done.
+ */
+void tpool_group_enter(tpool_group_t * group, size_t n);
+void tpool_group_leave(tpool_group_t * group);
+
+#endif
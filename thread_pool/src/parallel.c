@@ -0,0 +1,223 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "internals/common.h"
+#include "internals/pool.h"
+
+#include "tpool.h"
+
+/**
+ * Chunks per thread when the grain is chosen automatically,
+ * more of them let threads even out uneven chunks by stealing.
+ */
+#define AUTO_CHUNKS_PER_THREAD 4
+
+typedef struct loop_s     loop_t;
+typedef struct subrange_s subrange_t;
+
+/**
+ * A range of chunks [first, last) enqueued as a work.
+ */
+struct subrange_s
+{
+  loop_t * loop;
+  size_t   first;
+  size_t   last;
+};
+
+/**
+ * The loop's range is cut into `chunks` chunks of `grain` indices,
+ * the last one may be shorter.
+ *
+ * A subrange is enqueued only when split off as the right half of
+ * another one, so no two of them start with the same chunk, and
+ * `subranges` is indexed by the first one.
+ */
+struct loop_s
+{
+  tpool_group_t          * group;
+
+  size_t                   begin;
+  size_t                   end;
+  size_t                   grain;
+  size_t                   chunks;
+
+  subrange_t             * subranges;
+
+  tpool_range_routine_t    body;
+
+  /* used by `tpool_parallel_reduce()` only */
+  tpool_reduce_routine_t   reduce;
+  const void             * identity;
+  char                   * partials;
+  size_t                   partial_size;
+
+  void                   * context;
+};
+
+static void loop_run_chunk(loop_t * loop, size_t chunk)
+{
+  size_t begin = loop->begin + chunk * loop->grain;
+  size_t end   = loop->end - begin > loop->grain ? begin + loop->grain : loop->end;
+
+  if (loop->reduce == NULL)
+  {
+    loop->body(begin, end, loop->context);
+    return;
+  }
+
+  void * partial = loop->partials + chunk * loop->partial_size;
+
+  memcpy(partial, loop->identity, loop->partial_size);
+
+  loop->reduce(begin, end, partial, loop->context);
+}
+
+static void subrange_routine(void * arg);
+
+/**
+ * Enqueues right halves while the subrange is splittable,
+ * then runs what is left of it.
+ */
+static void loop_run(loop_t * loop, size_t first, size_t last)
+{
+  while (last - first > 1)
+  {
+    size_t mid = first + (last - first) / 2;
+
+    subrange_t * right = &loop->subranges[mid];
+
+    right->loop  = loop;
+    right->first = mid;
+    right->last  = last;
+
+    // the pool may be shut down, then the caller does it all
+    if (tpool_group_add_work(loop->group, subrange_routine, right) != TPOOL_SUCCESS) break;
+
+    last = mid;
+  }
+
+  for (size_t chunk = first; chunk < last; chunk++)
+  {
+    loop_run_chunk(loop, chunk);
+  }
+}
+
+static void subrange_routine(void * arg)
+{
+  subrange_t * subrange = arg;
+
+  loop_run(subrange->loop, subrange->first, subrange->last);
+}
+
+static tpool_ret_t loop_execute(tpool_t * tpool, loop_t * loop)
+{
+  size_t size = loop->end - loop->begin;
+
+  if (loop->grain == 0)
+  {
+    size_t chunks = tpool_workers_number(tpool) * AUTO_CHUNKS_PER_THREAD;
+
+    loop->grain = size / chunks + (size % chunks != 0);
+  }
+
+  loop->chunks = size / loop->grain + (size % loop->grain != 0);
+
+  if (loop->chunks == 1)
+  {
+    loop_run_chunk(loop, 0);
+    return TPOOL_SUCCESS;
+  }
+
+  tpool_ret_t ret = TPOOL_SUCCESS;
+
+  TRY_NEW(1, loop->subranges = malloc(sizeof(subrange_t) * loop->chunks));
+
+  ret = tpool_group_create(tpool, &loop->group);
+
+  if (ret != TPOOL_SUCCESS) goto try_failure_2;
+
+  loop_run(loop, 0, loop->chunks);
+
+  ret = tpool_group_wait(loop->group);
+
+  asserting(tpool_group_destroy(loop->group) == TPOOL_SUCCESS);
+
+try_failure_2: free(loop->subranges);
+               return ret;
+try_failure_1: return TPOOL_EMEMALLOC;
+}
+
+tpool_ret_t tpool_parallel_for(tpool_t * tpool, size_t begin, size_t end, size_t grain,
+                               tpool_range_routine_t body, void * context)
+{
+  CHECK_PARAM(tpool != NULL);
+  CHECK_PARAM(begin <= end);
+  CHECK_PARAM(body != NULL);
+
+  if (begin == end) return TPOOL_SUCCESS;
+
+  loop_t loop =
+  {
+    .begin   = begin,
+    .end     = end,
+    .grain   = grain,
+    .body    = body,
+    .context = context,
+  };
+
+  return loop_execute(tpool, &loop);
+}
+
+tpool_ret_t tpool_parallel_reduce(tpool_t * tpool, size_t begin, size_t end, size_t grain,
+                                  void * result, size_t result_size,
+                                  tpool_reduce_routine_t body, tpool_join_routine_t join,
+                                  void * context)
+{
+  CHECK_PARAM(tpool != NULL);
+  CHECK_PARAM(begin <= end);
+  CHECK_PARAM(result != NULL);
+  CHECK_PARAM(result_size > 0);
+  CHECK_PARAM(body != NULL);
+  CHECK_PARAM(join != NULL);
+
+  if (begin == end) return TPOOL_SUCCESS;
+
+  loop_t loop =
+  {
+    .begin        = begin,
+    .end          = end,
+    .grain        = grain,
+    .reduce       = body,
+    .identity     = result, // intact until the partials are joined
+    .partial_size = result_size,
+    .context      = context,
+  };
+
+  size_t size   = end - begin;
+  size_t chunks = grain == 0 ? tpool_workers_number(tpool) * AUTO_CHUNKS_PER_THREAD
+                             : size / grain + (size % grain != 0);
+
+  if (chunks > size) chunks = size;
+
+  TRY_NEW(1, loop.partials = malloc(result_size * chunks));
+
+  tpool_ret_t ret = loop_execute(tpool, &loop);
+
+  assert(loop.chunks <= chunks);
+
+  if (ret == TPOOL_SUCCESS)
+  {
+    for (size_t chunk = 0; chunk < loop.chunks; chunk++)
+    {
+      join(result, loop.partials + chunk * result_size, context);
+    }
+  }
+
+  free(loop.partials);
+
+  return ret;
+
+try_failure_1: return TPOOL_EMEMALLOC;
+}
@@ -0,0 +1,248 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <errno.h>
+
+#include "parking.h"
+
+typedef struct parker_s parker_t;
+
+/**
+ * Lives on the parked thread's stack.
+ */
+struct parker_s
+{
+  sem_t      sem;
+  parker_t * next;
+  bool       timed;
+};
+
+/**
+ * `parked` counts threads that are parked or about to decide whether to
+ * park, it is changed only under `mutex`. While the mutex is not held,
+ * it equals the number of parkers in `stack`.
+ */
+struct parking_s
+{
+  pthread_mutex_t mutex;
+
+  parker_t      * stack;
+  atomic_size_t   parked;
+};
+
+parking_t * parking_create(void)
+{
+  parking_t * parking = NULL;
+
+  TRY_NEW(1, parking = malloc(sizeof(parking_t)));
+  TRY_EOK(2, pthread_mutex_init(&parking->mutex, NULL));
+
+  parking->stack = NULL;
+
+  atomic_init(&parking->parked, 0);
+
+  return parking;
+
+try_failure_2: free(parking);
+try_failure_1: return NULL;
+}
+
+void parking_destroy(parking_t * parking)
+{
+  if (parking == NULL) return;
+
+  assert(parking->stack == NULL && "threads are still parked");
+
+  asserting_eok(pthread_mutex_destroy(&parking->mutex));
+
+  free(parking);
+}
+
+/**
+ * Takes the parker off the stack, if nobody has taken it yet.
+ * Should be called with the mutex locked.
+ */
+static bool parking_remove(parking_t * parking, parker_t * parker)
+{
+  for (parker_t ** p_next = &parking->stack; *p_next != NULL; p_next = &(*p_next)->next)
+  {
+    if (*p_next == parker)
+    {
+      *p_next = parker->next;
+
+      atomic_fetch_sub(&parking->parked, 1);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+err_t parking_park(parking_t * parking, parking_predicate_t should_park, void * context)
+{
+  return parking_park_until(parking, should_park, context, NULL);
+}
+
+/**
+ * Only a `timed` parker is looked for by `parking_unpark_timed()`.
+ */
+static err_t parking_park_deadline(parking_t * parking, parking_predicate_t should_park, void * context,
+                                   const struct timespec * deadline, bool timed)
+{
+  assert(parking     != NULL);
+  assert(should_park != NULL);
+
+  parker_t self;
+
+  MUTEX_LOCK(&parking->mutex);
+
+  // pairs with the load in `parking_unpark()`
+  atomic_fetch_add(&parking->parked, 1);
+
+  if (!should_park(context))
+  {
+    atomic_fetch_sub(&parking->parked, 1);
+
+    MUTEX_UNLOCK(&parking->mutex);
+
+    return E_OK;
+  }
+
+  if (sem_init(&self.sem, 0, 0) != 0)
+  {
+    atomic_fetch_sub(&parking->parked, 1);
+
+    MUTEX_UNLOCK(&parking->mutex);
+
+    return E_SYSFAIL;
+  }
+
+  self.next      = parking->stack;
+  self.timed     = timed;
+  parking->stack = &self;
+
+  MUTEX_UNLOCK(&parking->mutex);
+
+  bool posted = false;
+
+  while (!posted)
+  {
+    int ret = deadline == NULL ? sem_wait(&self.sem) : sem_timedwait(&self.sem, deadline);
+
+    posted = ret == 0;
+
+    if (!posted && errno == ETIMEDOUT)
+    {
+      MUTEX_LOCK(&parking->mutex);
+      bool removed = parking_remove(parking, &self);
+      MUTEX_UNLOCK(&parking->mutex);
+
+      if (removed) break;
+
+      // a waker has taken it off the stack and is about to post
+      deadline = NULL;
+    }
+    else
+    {
+      assert((posted || errno == EINTR) && "sem_wait() failed");
+    }
+  }
+
+  // nobody refers to it anymore
+  sem_destroy(&self.sem);
+
+  return E_OK;
+}
+
+err_t parking_park_until(parking_t * parking, parking_predicate_t should_park, void * context,
+                         const struct timespec * deadline)
+{
+  return parking_park_deadline(parking, should_park, context, deadline, deadline != NULL);
+}
+
+err_t parking_park_timeout(parking_t * parking, parking_predicate_t should_park, void * context,
+                           const struct timespec * deadline)
+{
+  assert(deadline != NULL);
+
+  return parking_park_deadline(parking, should_park, context, deadline, false);
+}
+
+err_t parking_unpark(parking_t * parking, size_t n)
+{
+  assert(parking != NULL);
+
+  parker_t * woken = NULL;
+
+  if (n == 0 || atomic_load(&parking->parked) == 0) return E_OK;
+
+  MUTEX_LOCK(&parking->mutex);
+  {
+    parker_t * last = NULL;
+    size_t     k    = 0;
+
+    for (parker_t * parker = parking->stack; parker != NULL && k < n; parker = parker->next)
+    {
+      last = parker;
+      k++;
+    }
+
+    if (k > 0)
+    {
+      woken          = parking->stack;
+      parking->stack = last->next;
+      last->next     = NULL;
+
+      atomic_fetch_sub(&parking->parked, k);
+    }
+  }
+  MUTEX_UNLOCK(&parking->mutex);
+
+  // posted outside of the lock, so woken threads do not bump into it
+  err_t err = E_OK;
+
+  while (woken != NULL)
+  {
+    parker_t * next = woken->next; // `woken` may be gone right after posting
+
+    if (sem_post(&woken->sem) != 0) err = E_SYSFAIL;
+
+    woken = next;
+  }
+
+  return err;
+}
+
+err_t parking_unpark_timed(parking_t * parking)
+{
+  assert(parking != NULL);
+
+  parker_t * woken = NULL;
+
+  MUTEX_LOCK(&parking->mutex);
+  {
+    for (parker_t * parker = parking->stack; parker != NULL && woken == NULL; parker = parker->next)
+    {
+      if (parker->timed) woken = parker;
+    }
+
+    if (woken == NULL) woken = parking->stack;
+
+    if (woken != NULL)
+    {
+      asserting(parking_remove(parking, woken));
+    }
+  }
+  MUTEX_UNLOCK(&parking->mutex);
+
+  if (woken == NULL) return E_OK;
+
+  return sem_post(&woken->sem) == 0 ? E_OK : E_SYSFAIL;
+}
+
+err_t parking_unpark_all(parking_t * parking)
+{
+  return parking_unpark(parking, SIZE_MAX);
+}
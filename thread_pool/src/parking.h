@@ -0,0 +1,69 @@
+#ifndef PARKING_H
+#define PARKING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "internals/common.h"
+
+/**
+ * Place where idle threads sleep, each one on its own semaphore, so
+ * a waker picks exactly as many threads as it has works for.
+ *
+ * Parked threads are woken up in LIFO order, the most recently parked
+ * one is likely to have the warmest cache.
+ *
+ * Wakers make the work visible first, then call `parking_unpark()`.
+ * Parkers announce themselves first, then check for the work in
+ * `should_park()`. Both sides use sequentially consistent atomics,
+ * so either the parker sees the work, or the waker sees the parker.
+ */
+typedef struct parking_s parking_t;
+
+typedef bool (* parking_predicate_t)(void * context);
+
+parking_t * parking_create(void);
+
+void parking_destroy(parking_t * parking);
+
+/**
+ * Parks the calling thread until it is unparked, unless
+ * `should_park(context)` says otherwise.
+ *
+ * @retval E_OK      The thread was unparked or did not park.
+ * @retval E_SYSFAIL Failed to park.
+ */
+err_t parking_park(parking_t * parking, parking_predicate_t should_park, void * context);
+
+/**
+ * Same as `parking_park()`, but parks no longer than until `deadline`
+ * (CLOCK_REALTIME), unless it is NULL.
+ */
+err_t parking_park_until(parking_t * parking, parking_predicate_t should_park, void * context,
+                         const struct timespec * deadline);
+
+/**
+ * Same as `parking_park_until()`, but the thread just gives up at the
+ * deadline, `parking_unpark_timed()` does not look for it.
+ */
+err_t parking_park_timeout(parking_t * parking, parking_predicate_t should_park, void * context,
+                           const struct timespec * deadline);
+
+/**
+ * Unparks up to `n` parked threads.
+ */
+err_t parking_unpark(parking_t * parking, size_t n);
+
+/**
+ * Unparks a thread parked with a deadline, one of the others if there
+ * is no such thread, so it could sleep for a new deadline.
+ */
+err_t parking_unpark_timed(parking_t * parking);
+
+/**
+ * Unparks every parked thread.
+ */
+err_t parking_unpark_all(parking_t * parking);
+
+#endif
@@ -0,0 +1,318 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "slab.h"
+
+#define CACHE_LINE_SIZE 64
+
+/**
+ * Number of objects a chunk is carved into.
+ */
+#define SLAB_CHUNK_OBJECTS 64
+
+/**
+ * Most objects of another cache collected before they are handed over.
+ */
+#define SLAB_BATCH_SIZE 32
+
+typedef struct slab_block_s slab_block_t;
+
+/**
+ * Precedes every object.
+ */
+struct slab_block_s
+{
+  slab_cache_t * owner; // where it goes back to, NULL for the shared list
+  slab_block_t * next;  // while free
+};
+
+/**
+ * Objects start aligned for any type.
+ */
+#define SLAB_HEADER_SIZE \
+  ((sizeof(slab_block_t) + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t))
+
+typedef struct slab_chunk_s slab_chunk_t;
+
+struct slab_chunk_s
+{
+  alignas(CACHE_LINE_SIZE) slab_chunk_t * next;
+
+  /* blocks */
+};
+
+struct slab_cache_s
+{
+  /* used by the owner only */
+  alignas(CACHE_LINE_SIZE) slab_block_t * local;
+
+  /* freed objects of `batch_owner` not handed over yet */
+  slab_cache_t * batch_owner;
+  slab_block_t * batch_head;
+  slab_block_t * batch_tail;
+  size_t         batch_size;
+
+  /* freed by other threads */
+  alignas(CACHE_LINE_SIZE) _Atomic(slab_block_t *) remote;
+};
+
+struct slab_s
+{
+  size_t          block_size;
+
+  pthread_mutex_t mutex; // guards `chunks` and `shared`
+  slab_chunk_t  * chunks;
+  slab_block_t  * shared;
+
+  size_t          caches_number;
+  slab_cache_t    caches[];
+};
+
+static void * slab_block_object(slab_block_t * block)
+{
+  return (unsigned char *) block + SLAB_HEADER_SIZE;
+}
+
+static slab_block_t * slab_object_block(void * object)
+{
+  return (slab_block_t *) ((unsigned char *) object - SLAB_HEADER_SIZE);
+}
+
+slab_t * slab_create(size_t object_size, size_t caches_number)
+{
+  assert(object_size > 0);
+
+  slab_t * slab = NULL;
+
+  size_t size = sizeof(slab_t) + sizeof(slab_cache_t) * caches_number;
+
+  TRY_NEW(1, slab = aligned_alloc(alignof(slab_t), size));
+  TRY_EOK(2, pthread_mutex_init(&slab->mutex, NULL));
+
+  size_t block_size = SLAB_HEADER_SIZE + object_size;
+
+  slab->block_size    = (block_size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+  slab->chunks        = NULL;
+  slab->shared        = NULL;
+  slab->caches_number = caches_number;
+
+  for (size_t i = 0; i < caches_number; i++)
+  {
+    slab_cache_t * cache = &slab->caches[i];
+
+    cache->local       = NULL;
+    cache->batch_owner = NULL;
+    cache->batch_head  = NULL;
+    cache->batch_tail  = NULL;
+    cache->batch_size  = 0;
+
+    atomic_init(&cache->remote, NULL);
+  }
+
+  return slab;
+
+try_failure_2: free(slab);
+try_failure_1: return NULL;
+}
+
+void slab_destroy(slab_t * slab)
+{
+  if (slab == NULL) return;
+
+  while (slab->chunks != NULL)
+  {
+    slab_chunk_t * chunk = slab->chunks;
+
+    slab->chunks = chunk->next;
+    free(chunk);
+  }
+
+  asserting_eok(pthread_mutex_destroy(&slab->mutex));
+
+  free(slab);
+}
+
+slab_cache_t * slab_cache(slab_t * slab, size_t i)
+{
+  assert(slab != NULL);
+  assert(i < slab->caches_number);
+
+  return &slab->caches[i];
+}
+
+/**
+ * Should be called with the slab's mutex locked.
+ *
+ * @return The blocks of a new chunk linked into a list.
+ */
+static slab_block_t * slab_grow(slab_t * slab)
+{
+  slab_chunk_t * chunk = aligned_alloc(CACHE_LINE_SIZE, sizeof(slab_chunk_t) + slab->block_size * SLAB_CHUNK_OBJECTS);
+
+  if (chunk == NULL) return NULL;
+
+  chunk->next  = slab->chunks;
+  slab->chunks = chunk;
+
+  unsigned char * blocks = (unsigned char *) (chunk + 1);
+
+  for (size_t i = 0; i < SLAB_CHUNK_OBJECTS; i++)
+  {
+    slab_block_t * block = (slab_block_t *) (blocks + i * slab->block_size);
+
+    block->next = i + 1 < SLAB_CHUNK_OBJECTS ? (slab_block_t *) (blocks + (i + 1) * slab->block_size) : NULL;
+  }
+
+  return (slab_block_t *) blocks;
+}
+
+/**
+ * Takes objects from the shared list, or from a new chunk.
+ */
+static slab_block_t * slab_take_shared(slab_t * slab, size_t n)
+{
+  slab_block_t * taken = NULL;
+
+  asserting_eok(pthread_mutex_lock(&slab->mutex));
+  {
+    if (slab->shared == NULL) slab->shared = slab_grow(slab);
+
+    taken = slab->shared;
+
+    if (taken != NULL)
+    {
+      slab_block_t * last = taken;
+
+      for (size_t i = 1; i < n && last->next != NULL; i++)
+      {
+        last = last->next;
+      }
+
+      slab->shared = last->next;
+      last->next   = NULL;
+    }
+  }
+  asserting_eok(pthread_mutex_unlock(&slab->mutex));
+
+  return taken;
+}
+
+void * slab_alloc(slab_t * slab, slab_cache_t * cache)
+{
+  assert(slab != NULL);
+
+  slab_block_t * block = NULL;
+
+  if (cache == NULL)
+  {
+    block = slab_take_shared(slab, 1);
+  }
+  else
+  {
+    if (cache->local == NULL)
+    {
+      cache->local = atomic_exchange_explicit(&cache->remote, NULL, memory_order_acquire);
+    }
+
+    if (cache->local == NULL)
+    {
+      cache->local = slab_take_shared(slab, SLAB_BATCH_SIZE);
+    }
+
+    block = cache->local;
+
+    if (block != NULL) cache->local = block->next;
+  }
+
+  if (block == NULL) return NULL;
+
+  block->owner = cache;
+
+  return slab_block_object(block);
+}
+
+/**
+ * Hands a list of objects over to their owner.
+ */
+static void slab_return(slab_t * slab, slab_cache_t * owner, slab_block_t * head, slab_block_t * tail)
+{
+  if (owner == NULL)
+  {
+    asserting_eok(pthread_mutex_lock(&slab->mutex));
+    {
+      tail->next   = slab->shared;
+      slab->shared = head;
+    }
+    asserting_eok(pthread_mutex_unlock(&slab->mutex));
+
+    return;
+  }
+
+  // the owner takes them all at once, so there is no ABA
+  slab_block_t * remote = atomic_load_explicit(&owner->remote, memory_order_relaxed);
+
+  do
+  {
+    tail->next = remote;
+  }
+  while (!atomic_compare_exchange_weak_explicit(&owner->remote, &remote, head,
+                                                memory_order_release, memory_order_relaxed));
+}
+
+void slab_cache_flush(slab_t * slab, slab_cache_t * cache)
+{
+  assert(slab  != NULL);
+  assert(cache != NULL);
+
+  if (cache->batch_size == 0) return;
+
+  slab_return(slab, cache->batch_owner, cache->batch_head, cache->batch_tail);
+
+  cache->batch_head = NULL;
+  cache->batch_tail = NULL;
+  cache->batch_size = 0;
+}
+
+void slab_free(slab_t * slab, slab_cache_t * cache, void * object)
+{
+  assert(slab   != NULL);
+  assert(object != NULL);
+
+  slab_block_t * block = slab_object_block(object);
+  slab_cache_t * owner = block->owner;
+
+  if (cache == NULL)
+  {
+    slab_return(slab, owner, block, block);
+    return;
+  }
+
+  if (owner == cache)
+  {
+    block->next  = cache->local;
+    cache->local = block;
+    return;
+  }
+
+  if (cache->batch_size > 0 && cache->batch_owner != owner)
+  {
+    slab_cache_flush(slab, cache);
+  }
+
+  block->next = cache->batch_head;
+
+  if (cache->batch_size == 0) cache->batch_tail = block;
+
+  cache->batch_owner = owner;
+  cache->batch_head  = block;
+  cache->batch_size++;
+
+  if (cache->batch_size == SLAB_BATCH_SIZE)
+  {
+    slab_cache_flush(slab, cache);
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+#include "internals/common.h"
+
+/**
+ * Allocator of objects of a single size, carved out of cache-aligned
+ * chunks. Objects are kept on cache lines of their own, so objects
+ * passed between threads do not share lines.
+ *
+ * Each thread owning a cache allocates from and frees to the cache
+ * without synchronization. An object freed by another thread goes back
+ * to the cache it was allocated from: the thread collects objects of
+ * the same cache into a batch and hands the batch over with one atomic
+ * operation, the owner takes all handed over objects at once when its
+ * own ones run out.
+ *
+ * Threads without a cache allocate from a list shared under a mutex.
+ */
+typedef struct slab_s       slab_t;
+typedef struct slab_cache_s slab_cache_t;
+
+slab_t * slab_create(size_t object_size, size_t caches_number);
+
+/**
+ * Frees all the objects, no cache may be used anymore.
+ */
+void slab_destroy(slab_t * slab);
+
+/**
+ * Should be used by one thread at a time.
+ */
+slab_cache_t * slab_cache(slab_t * slab, size_t i);
+
+/**
+ * @param cache  Of the calling thread, NULL if it has none.
+ *
+ * @return NULL if out of memory.
+ */
+void * slab_alloc(slab_t * slab, slab_cache_t * cache);
+
+/**
+ * @param cache  Of the calling thread, NULL if it has none.
+ */
+void slab_free(slab_t * slab, slab_cache_t * cache, void * object);
+
+/**
+ * Hands the batch of objects freed through the cache over to their
+ * owner, as it may not get them otherwise. Should be called before
+ * the thread sleeps or exits.
+ */
+void slab_cache_flush(slab_t * slab, slab_cache_t * cache);
+
+#endif
@@ -0,0 +1,218 @@
+#include <stdlib.h>
+
+#include "timer_wheel.h"
+
+#define WHEEL_LEVELS    4
+#define WHEEL_SLOT_BITS 6
+#define WHEEL_SLOTS     (1 << WHEEL_SLOT_BITS)
+#define WHEEL_SLOT_MASK (WHEEL_SLOTS - 1)
+
+/**
+ * Timers further than that wait in the top level, they are put back
+ * when their slot is reached.
+ */
+#define WHEEL_RANGE ((uint64_t) 1 << (WHEEL_LEVELS * WHEEL_SLOT_BITS))
+
+/**
+ * `now` is the last tick processed.
+ * Bit `i` of `occupied[l]` tells that `slots[l][i]` is not empty.
+ */
+struct timer_wheel_s
+{
+  uint64_t        now;
+  size_t          timers_number;
+
+  uint64_t        occupied[WHEEL_LEVELS];
+  wheel_timer_t * slots[WHEEL_LEVELS][WHEEL_SLOTS];
+};
+
+timer_wheel_t * timer_wheel_create(uint64_t now)
+{
+  timer_wheel_t * wheel = NULL;
+
+  TRY_NEW(1, wheel = calloc(1, sizeof(timer_wheel_t)));
+
+  wheel->now = now;
+
+  return wheel;
+
+try_failure_1: return NULL;
+}
+
+void timer_wheel_destroy(timer_wheel_t * wheel)
+{
+  free(wheel);
+}
+
+static void wheel_link(timer_wheel_t * wheel, wheel_timer_t * timer, size_t level, size_t slot)
+{
+  wheel_timer_t ** p_head = &wheel->slots[level][slot];
+
+  timer->prev   = NULL;
+  timer->next   = *p_head;
+  timer->p_head = p_head;
+
+  if (*p_head != NULL) (*p_head)->prev = timer;
+
+  *p_head = timer;
+
+  wheel->occupied[level] |= (uint64_t) 1 << slot;
+}
+
+static void wheel_unlink(timer_wheel_t * wheel, wheel_timer_t * timer)
+{
+  if (timer->prev != NULL) timer->prev->next = timer->next;
+  else                     *timer->p_head    = timer->next;
+
+  if (timer->next != NULL) timer->next->prev = timer->prev;
+
+  if (*timer->p_head == NULL)
+  {
+    size_t index = timer->p_head - &wheel->slots[0][0];
+
+    wheel->occupied[index / WHEEL_SLOTS] &= ~((uint64_t) 1 << (index % WHEEL_SLOTS));
+  }
+
+  timer->p_head = NULL;
+}
+
+/**
+ * Places the timer into the slot it belongs to relative to `now`.
+ * Due timers go to the next tick's slot.
+ */
+static void wheel_place(timer_wheel_t * wheel, wheel_timer_t * timer)
+{
+  uint64_t at = timer->expiry > wheel->now ? timer->expiry : wheel->now + 1;
+
+  if (at - wheel->now >= WHEEL_RANGE) at = wheel->now + WHEEL_RANGE - 1;
+
+  uint64_t delta = at - wheel->now;
+  size_t   level = 0;
+
+  while (delta >> (WHEEL_SLOT_BITS * (level + 1)) != 0) level++;
+
+  wheel_link(wheel, timer, level, (at >> (WHEEL_SLOT_BITS * level)) & WHEEL_SLOT_MASK);
+}
+
+void timer_wheel_insert(timer_wheel_t * wheel, wheel_timer_t * timer, uint64_t expiry)
+{
+  assert(wheel != NULL);
+  assert(timer != NULL);
+
+  timer->expiry = expiry;
+
+  wheel_place(wheel, timer);
+
+  wheel->timers_number++;
+}
+
+void timer_wheel_remove(timer_wheel_t * wheel, wheel_timer_t * timer)
+{
+  assert(wheel != NULL);
+  assert(timer != NULL && timer->p_head != NULL);
+
+  wheel_unlink(wheel, timer);
+
+  wheel->timers_number--;
+}
+
+bool timer_wheel_is_empty(timer_wheel_t * wheel)
+{
+  assert(wheel != NULL);
+
+  return wheel->timers_number == 0;
+}
+
+uint64_t timer_wheel_next_event(timer_wheel_t * wheel)
+{
+  assert(wheel != NULL);
+
+  uint64_t next = UINT64_MAX;
+
+  for (size_t level = 0; level < WHEEL_LEVELS; level++)
+  {
+    uint64_t occupied = wheel->occupied[level];
+
+    if (occupied == 0) continue;
+
+    size_t   shift = WHEEL_SLOT_BITS * level;
+    uint64_t base  = wheel->now >> shift;
+    size_t   first = (base + 1) & WHEEL_SLOT_MASK;
+
+    // slots from the one after the current, wrapping around
+    uint64_t rotated = (occupied >> first) | (first == 0 ? 0 : occupied << (WHEEL_SLOTS - first));
+
+    uint64_t event = (base + 1 + __builtin_ctzll(rotated)) << shift;
+
+    if (event < next) next = event;
+  }
+
+  return next;
+}
+
+/**
+ * Moves timers of the slot one level down, or to `expired` if due.
+ */
+static void wheel_cascade(timer_wheel_t * wheel, size_t level, size_t slot, wheel_timer_t *** p_tail)
+{
+  wheel_timer_t * timer = wheel->slots[level][slot];
+
+  wheel->slots[level][slot] = NULL;
+  wheel->occupied[level]   &= ~((uint64_t) 1 << slot);
+
+  while (timer != NULL)
+  {
+    wheel_timer_t * next = timer->next;
+
+    if (timer->expiry <= wheel->now)
+    {
+      timer->p_head = NULL;
+      timer->next   = NULL;
+
+      **p_tail = timer;
+      *p_tail  = &timer->next;
+
+      wheel->timers_number--;
+    }
+    else
+    {
+      wheel_place(wheel, timer);
+    }
+
+    timer = next;
+  }
+}
+
+wheel_timer_t * timer_wheel_advance(timer_wheel_t * wheel, uint64_t now)
+{
+  assert(wheel != NULL);
+
+  wheel_timer_t *  expired = NULL;
+  wheel_timer_t ** p_tail  = &expired;
+
+  while (wheel->now < now)
+  {
+    // nothing happens in between
+    uint64_t event = timer_wheel_next_event(wheel);
+
+    if (event > now)
+    {
+      wheel->now = now;
+      break;
+    }
+
+    wheel->now = event;
+
+    // higher levels first, their timers may land in lower slots
+    size_t top = 0;
+
+    while (top + 1 < WHEEL_LEVELS && (event & ((WHEEL_SLOTS << (WHEEL_SLOT_BITS * top)) - 1)) == 0) top++;
+
+    for (size_t level = top + 1; level-- > 0;)
+    {
+      wheel_cascade(wheel, level, (event >> (WHEEL_SLOT_BITS * level)) & WHEEL_SLOT_MASK, &p_tail);
+    }
+  }
+
+  return expired;
+}
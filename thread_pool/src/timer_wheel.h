@@ -0,0 +1,64 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "internals/common.h"
+
+/**
+ * Hierarchical timing wheel, time is measured in ticks.
+ *
+ * Each level has 64 slots, a slot of level `l` spans 64^l ticks. A timer
+ * is put into the lowest level whose range covers it, and is moved one
+ * level down when its slot is reached (cascading), so inserting and
+ * removing timers takes constant time.
+ *
+ * Not thread-safe.
+ */
+typedef struct timer_wheel_s timer_wheel_t;
+typedef struct wheel_timer_s wheel_timer_t;
+
+/**
+ * Embedded into whatever is timed.
+ */
+struct wheel_timer_s
+{
+  wheel_timer_t  * next;
+  wheel_timer_t  * prev;
+  wheel_timer_t ** p_head; // of the slot the timer is in
+
+  uint64_t         expiry;
+};
+
+timer_wheel_t * timer_wheel_create(uint64_t now);
+
+/**
+ * Timers still in the wheel are left as they are.
+ */
+void timer_wheel_destroy(timer_wheel_t * wheel);
+
+/**
+ * Timers that are already due expire on the next advance.
+ */
+void timer_wheel_insert(timer_wheel_t * wheel, wheel_timer_t * timer, uint64_t expiry);
+
+void timer_wheel_remove(timer_wheel_t * wheel, wheel_timer_t * timer);
+
+bool timer_wheel_is_empty(timer_wheel_t * wheel);
+
+/**
+ * The earliest tick the wheel has something to do at: a timer expiring
+ * or a slot to cascade. UINT64_MAX if the wheel is empty.
+ */
+uint64_t timer_wheel_next_event(timer_wheel_t * wheel);
+
+/**
+ * Moves the wheel's time forward to `now`, expired timers are removed
+ * and linked by `next`, the ones of earlier ticks first.
+ *
+ * @return The first expired timer, NULL if there are none.
+ */
+wheel_timer_t * timer_wheel_advance(timer_wheel_t * wheel, uint64_t now);
+
+#endif
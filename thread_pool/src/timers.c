@@ -0,0 +1,363 @@
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "timer_wheel.h"
+#include "timers.h"
+
+/**
+ * Resolution of the timers.
+ */
+#define TIMER_TICK_NS 1000000
+
+#define NS_PER_SECOND 1000000000
+
+/**
+ * A fired one-shot timer with a handle is kept in `retired`,
+ * linked by `node.next` and `node.prev`.
+ *
+ * An expired timer is `firing` while its work is pushed without the
+ * mutex, then it belongs to the poller: cancelling it only marks it
+ * `cancelled`, and the poller frees it.
+ */
+struct tpool_timer_s
+{
+  wheel_timer_t   node;
+
+  timers_t      * timers;
+
+  work_t          work;
+  uint64_t        period; // in ticks, 0 for one-shot timers
+
+  bool            has_handle;
+  bool            firing;
+  bool            cancelled;
+  err_t           pushed;   // while firing
+};
+
+/**
+ * `armed` and `next_event` mirror the wheel, so they could be read
+ * without `mutex`.
+ */
+struct timers_s
+{
+  pthread_mutex_t  mutex;
+
+  timer_wheel_t  * wheel;
+  tpool_timer_t  * retired;
+
+  atomic_size_t    armed;
+  atomic_size_t    epoch;
+  _Atomic uint64_t next_event;
+};
+
+static uint64_t clock_now_ns(clockid_t clock)
+{
+  struct timespec now;
+
+  asserting_eok(clock_gettime(clock, &now));
+
+  return (uint64_t) now.tv_sec * NS_PER_SECOND + (uint64_t) now.tv_nsec;
+}
+
+static uint64_t ticks_now(void)
+{
+  return clock_now_ns(CLOCK_MONOTONIC) / TIMER_TICK_NS;
+}
+
+timers_t * timers_create(void)
+{
+  timers_t * timers = NULL;
+
+  TRY_NEW(1, timers = malloc(sizeof(timers_t)));
+  TRY_NEW(2, timers->wheel = timer_wheel_create(ticks_now()));
+  TRY_EOK(3, pthread_mutex_init(&timers->mutex, NULL));
+
+  timers->retired = NULL;
+
+  atomic_init(&timers->armed, 0);
+  atomic_init(&timers->epoch, 0);
+  atomic_init(&timers->next_event, UINT64_MAX);
+
+  return timers;
+
+try_failure_3: timer_wheel_destroy(timers->wheel);
+try_failure_2: free(timers);
+try_failure_1: return NULL;
+}
+
+static void free_list(wheel_timer_t * node)
+{
+  while (node != NULL)
+  {
+    wheel_timer_t * next = node->next;
+
+    free(node); // `node` is the first member of the timer
+    node = next;
+  }
+}
+
+void timers_destroy(timers_t * timers)
+{
+  if (timers == NULL) return;
+
+  // everything expires at the end of time
+  free_list(timer_wheel_advance(timers->wheel, UINT64_MAX));
+  free_list(timers->retired != NULL ? &timers->retired->node : NULL);
+
+  timer_wheel_destroy(timers->wheel);
+
+  asserting_eok(pthread_mutex_destroy(&timers->mutex));
+
+  free(timers);
+}
+
+/**
+ * Should be called with the mutex locked.
+ */
+static void timers_update_next_event(timers_t * timers)
+{
+  uint64_t next_event = timer_wheel_next_event(timers->wheel);
+
+  if (next_event < atomic_load_explicit(&timers->next_event, memory_order_relaxed))
+  {
+    // pairs with the sleeper checking it after announcing itself
+    atomic_fetch_add(&timers->epoch, 1);
+  }
+
+  atomic_store(&timers->next_event, next_event);
+}
+
+err_t timers_add(timers_t * timers, uint64_t delay_ns, uint64_t period_ns, const work_t * p_work,
+                 tpool_timer_t ** p_timer, bool * p_earlier)
+{
+  assert(timers    != NULL);
+  assert(p_work    != NULL);
+  assert(p_earlier != NULL);
+
+  tpool_timer_t * timer = malloc(sizeof(tpool_timer_t));
+
+  if (timer == NULL) return E_MEMALLOC;
+
+  timer->timers     = timers;
+  timer->work       = *p_work;
+  timer->period     = (period_ns + TIMER_TICK_NS - 1) / TIMER_TICK_NS;
+  timer->has_handle = p_timer != NULL;
+  timer->firing     = false;
+  timer->cancelled  = false;
+
+  if (period_ns > 0 && timer->period == 0) timer->period = 1;
+
+  // rounded up, so the work never comes early
+  uint64_t expiry = (clock_now_ns(CLOCK_MONOTONIC) + delay_ns + TIMER_TICK_NS - 1) / TIMER_TICK_NS;
+
+  if (p_timer != NULL) *p_timer = timer;
+
+  MUTEX_LOCK(&timers->mutex);
+  {
+    size_t epoch = atomic_load_explicit(&timers->epoch, memory_order_relaxed);
+
+    timer_wheel_insert(timers->wheel, &timer->node, expiry);
+
+    atomic_fetch_add(&timers->armed, 1);
+
+    timers_update_next_event(timers);
+
+    *p_earlier = atomic_load_explicit(&timers->epoch, memory_order_relaxed) != epoch;
+  }
+  MUTEX_UNLOCK(&timers->mutex);
+
+  return E_OK;
+}
+
+err_t timers_cancel(tpool_timer_t * timer)
+{
+  assert(timer != NULL && timer->has_handle);
+
+  timers_t * timers = timer->timers;
+
+  bool firing = false;
+
+  MUTEX_LOCK(&timers->mutex);
+  {
+    firing = timer->firing;
+
+    if (firing)
+    {
+      // the poller frees it
+      timer->cancelled = true;
+    }
+    else if (timer->node.p_head != NULL)
+    {
+      timer_wheel_remove(timers->wheel, &timer->node);
+
+      atomic_fetch_sub(&timers->armed, 1);
+
+      timers_update_next_event(timers);
+    }
+    else
+    {
+      // fired already
+      if (timer->node.prev != NULL) timer->node.prev->next = timer->node.next;
+      else                          timers->retired        = (tpool_timer_t *) timer->node.next;
+
+      if (timer->node.next != NULL) timer->node.next->prev = timer->node.prev;
+    }
+  }
+  MUTEX_UNLOCK(&timers->mutex);
+
+  if (!firing) free(timer);
+
+  return E_OK;
+}
+
+size_t timers_armed(timers_t * timers)
+{
+  assert(timers != NULL);
+
+  return atomic_load(&timers->armed);
+}
+
+size_t timers_epoch(timers_t * timers)
+{
+  assert(timers != NULL);
+
+  return atomic_load(&timers->epoch);
+}
+
+bool timers_are_due(timers_t * timers)
+{
+  assert(timers != NULL);
+
+  if (atomic_load_explicit(&timers->armed, memory_order_relaxed) == 0) return false;
+
+  return ticks_now() >= atomic_load_explicit(&timers->next_event, memory_order_relaxed);
+}
+
+/**
+ * Settles the timer once its work is pushed, or failed to.
+ * Should be called with the mutex locked.
+ */
+static void timers_fire(timers_t * timers, tpool_timer_t * timer, uint64_t now)
+{
+  err_t err = timer->pushed;
+
+  timer->firing = false;
+
+  if (timer->cancelled)
+  {
+    atomic_fetch_sub(&timers->armed, 1);
+
+    free(timer);
+    return;
+  }
+
+  if (err == E_OVERFLOW || err == E_MEMALLOC)
+  {
+    // not pushed, the timer stays armed and tries again on the next tick
+    timer_wheel_insert(timers->wheel, &timer->node, now + 1);
+    return;
+  }
+
+  // E_BADREQ once the queue stops accepting, the pool is going away
+
+  if (timer->period > 0)
+  {
+    uint64_t expiry = timer->node.expiry + timer->period;
+
+    // fell behind, skip the missed periods
+    if (expiry <= now) expiry = now + timer->period;
+
+    timer_wheel_insert(timers->wheel, &timer->node, expiry);
+    return;
+  }
+
+  atomic_fetch_sub(&timers->armed, 1);
+
+  if (!timer->has_handle)
+  {
+    free(timer);
+    return;
+  }
+
+  timer->node.prev = NULL;
+  timer->node.next = NULL;
+
+  if (timers->retired != NULL)
+  {
+    timer->node.next           = &timers->retired->node;
+    timers->retired->node.prev = &timer->node;
+  }
+
+  timers->retired = timer;
+}
+
+void timers_poll(timers_t * timers, work_queue_t * work_queue)
+{
+  assert(timers     != NULL);
+  assert(work_queue != NULL);
+
+  uint64_t        now     = 0;
+  wheel_timer_t * expired = NULL;
+
+  if (pthread_mutex_trylock(&timers->mutex) != 0) return;
+  {
+    now     = ticks_now();
+    expired = timer_wheel_advance(timers->wheel, now);
+
+    for (wheel_timer_t * node = expired; node != NULL; node = node->next)
+    {
+      ((tpool_timer_t *) node)->firing = true;
+    }
+
+    timers_update_next_event(timers);
+  }
+  asserting_eok(pthread_mutex_unlock(&timers->mutex));
+
+  if (expired == NULL) return;
+
+  // The poller is a thread of the pool, so it must not wait for room in
+  // the queue, and adding or cancelling timers must not wait for it.
+  for (wheel_timer_t * node = expired; node != NULL; node = node->next)
+  {
+    tpool_timer_t * timer = (tpool_timer_t *) node;
+
+    timer->pushed = work_queue_try_push(work_queue, &timer->work);
+  }
+
+  asserting_eok(pthread_mutex_lock(&timers->mutex));
+  {
+    while (expired != NULL)
+    {
+      wheel_timer_t * next = expired->next;
+
+      timers_fire(timers, (tpool_timer_t *) expired, now);
+
+      expired = next;
+    }
+
+    timers_update_next_event(timers);
+  }
+  asserting_eok(pthread_mutex_unlock(&timers->mutex));
+}
+
+bool timers_next_deadline(timers_t * timers, struct timespec * p_deadline)
+{
+  assert(timers     != NULL);
+  assert(p_deadline != NULL);
+
+  uint64_t next_event = atomic_load(&timers->next_event);
+
+  if (next_event == UINT64_MAX) return false;
+
+  uint64_t now  = clock_now_ns(CLOCK_MONOTONIC);
+  uint64_t at   = next_event * TIMER_TICK_NS;
+  uint64_t wait = at > now ? at - now : 0;
+
+  uint64_t deadline = clock_now_ns(CLOCK_REALTIME) + wait;
+
+  p_deadline->tv_sec  = deadline / NS_PER_SECOND;
+  p_deadline->tv_nsec = deadline % NS_PER_SECOND;
+
+  return true;
+}
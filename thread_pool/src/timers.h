@@ -0,0 +1,76 @@
+#ifndef TIMERS_H
+#define TIMERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "internals/common.h"
+
+#include "work.h"
+#include "work_queue.h"
+
+/**
+ * Works to be pushed to a work queue later, once or periodically,
+ * kept in a timing wheel guarded by a mutex.
+ *
+ * Nothing runs the timers on its own: whoever is around polls them
+ * with `timers_poll()`, and an idle thread sleeps until the next event.
+ */
+typedef struct timers_s timers_t;
+
+timers_t * timers_create(void);
+
+/**
+ * Frees all the timers, their handles become invalid.
+ */
+void timers_destroy(timers_t * timers);
+
+/**
+ * Arms a timer pushing the work after `delay_ns`, then every
+ * `period_ns` unless it is 0.
+ *
+ * If `p_timer` is not NULL, the timer is kept till `timers_cancel()`,
+ * otherwise a one-shot timer is freed once it fires.
+ *
+ * Sets `*p_earlier` when the next event moved earlier, then the thread
+ * sleeping till it should be woken up.
+ */
+err_t timers_add(timers_t * timers, uint64_t delay_ns, uint64_t period_ns, const work_t * p_work,
+                 tpool_timer_t ** p_timer, bool * p_earlier);
+
+/**
+ * Disarms the timer and frees it. A work already pushed is not recalled.
+ */
+err_t timers_cancel(tpool_timer_t * timer);
+
+/**
+ * Number of timers armed, may be outdated as soon as it is returned.
+ */
+size_t timers_armed(timers_t * timers);
+
+/**
+ * Changes every time the next event moves earlier.
+ */
+size_t timers_epoch(timers_t * timers);
+
+/**
+ * Tells whether some timers are due, cheap enough to ask after every work.
+ */
+bool timers_are_due(timers_t * timers);
+
+/**
+ * Pushes the works of due timers to the queue, does nothing if another
+ * thread is polling already. A timer whose work does not fit stays armed
+ * till the next tick.
+ */
+void timers_poll(timers_t * timers, work_queue_t * work_queue);
+
+/**
+ * When to poll next (CLOCK_REALTIME).
+ *
+ * @return false if there are no timers armed.
+ */
+bool timers_next_deadline(timers_t * timers, struct timespec * p_deadline);
+
+#endif
@@ -0,0 +1,213 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "topology.h"
+
+#define SYSFS_NODES "/sys/devices/system/node"
+
+/**
+ * Longest line of a CPU list read from sysfs.
+ */
+#define CPU_LIST_MAX_LENGTH 4096
+
+struct topology_s
+{
+  size_t      nodes_number;
+  cpu_set_t * node_cpus;
+
+  /* 0 for CPUs the process may not run on */
+  size_t      node_of_cpu[CPU_SETSIZE];
+};
+
+/**
+ * Reads a list like "0-3,8,10-11" from the file.
+ */
+static bool read_cpu_list(const char * path, cpu_set_t * set)
+{
+  char line[CPU_LIST_MAX_LENGTH];
+
+  FILE * file = fopen(path, "r");
+
+  if (file == NULL) return false;
+
+  bool read = fgets(line, sizeof(line), file) != NULL;
+
+  fclose(file);
+
+  if (!read) return false;
+
+  CPU_ZERO(set);
+
+  for (char * p = line; *p != '\0' && *p != '\n'; )
+  {
+    char * end = NULL;
+
+    unsigned long first = strtoul(p, &end, 10);
+    unsigned long last  = first;
+
+    if (end == p) return false;
+
+    p = end;
+
+    if (*p == '-')
+    {
+      last = strtoul(p + 1, &end, 10);
+
+      if (end == p + 1) return false;
+
+      p = end;
+    }
+
+    for (unsigned long i = first; i <= last && i < CPU_SETSIZE; i++)
+    {
+      CPU_SET(i, set);
+    }
+
+    if (*p == ',') p++;
+  }
+
+  return true;
+}
+
+static void get_allowed_cpus(cpu_set_t * allowed)
+{
+  if (sched_getaffinity(0, sizeof(cpu_set_t), allowed) == 0) return;
+
+  CPU_ZERO(allowed);
+
+  for (long i = 0; i < sysconf(_SC_NPROCESSORS_ONLN) && i < CPU_SETSIZE; i++)
+  {
+    CPU_SET(i, allowed);
+  }
+}
+
+/**
+ * Adds the nodes listed in sysfs, skipping ones with no CPUs allowed.
+ */
+static void topology_read_nodes(topology_t * topology, const cpu_set_t * online, const cpu_set_t * allowed,
+                                size_t max_nodes)
+{
+  for (size_t id = 0; id < CPU_SETSIZE && topology->nodes_number < max_nodes; id++)
+  {
+    if (!CPU_ISSET(id, online)) continue;
+
+    char path[64];
+
+    snprintf(path, sizeof(path), SYSFS_NODES "/node%zu/cpulist", id);
+
+    cpu_set_t * cpus = &topology->node_cpus[topology->nodes_number];
+
+    if (!read_cpu_list(path, cpus)) continue;
+
+    CPU_AND(cpus, cpus, allowed);
+
+    if (CPU_COUNT(cpus) > 0) topology->nodes_number++;
+  }
+}
+
+topology_t * topology_create(void)
+{
+  topology_t * topology = NULL;
+
+  cpu_set_t allowed;
+  cpu_set_t online; // node ids
+
+  get_allowed_cpus(&allowed);
+
+  if (!read_cpu_list(SYSFS_NODES "/online", &online)) CPU_ZERO(&online);
+
+  size_t max_nodes = CPU_COUNT(&online) > 0 ? (size_t) CPU_COUNT(&online) : 1;
+
+  TRY_NEW(1, topology = malloc(sizeof(topology_t)));
+  TRY_NEW(2, topology->node_cpus = malloc(sizeof(cpu_set_t) * max_nodes));
+
+  topology->nodes_number = 0;
+
+  topology_read_nodes(topology, &online, &allowed, max_nodes);
+
+  if (topology->nodes_number == 0)
+  {
+    topology->node_cpus[0] = allowed;
+    topology->nodes_number = 1;
+  }
+
+  for (size_t cpu = 0; cpu < CPU_SETSIZE; cpu++)
+  {
+    topology->node_of_cpu[cpu] = 0;
+
+    for (size_t node = 0; node < topology->nodes_number; node++)
+    {
+      if (CPU_ISSET(cpu, &topology->node_cpus[node])) topology->node_of_cpu[cpu] = node;
+    }
+  }
+
+  return topology;
+
+try_failure_2: free(topology);
+try_failure_1: return NULL;
+}
+
+void topology_destroy(topology_t * topology)
+{
+  if (topology == NULL) return;
+
+  free(topology->node_cpus);
+  free(topology);
+}
+
+size_t topology_nodes_number(const topology_t * topology)
+{
+  assert(topology != NULL);
+
+  return topology->nodes_number;
+}
+
+size_t topology_current_node(const topology_t * topology)
+{
+  assert(topology != NULL);
+
+  int cpu = sched_getcpu();
+
+  if (cpu < 0 || cpu >= CPU_SETSIZE) return 0;
+
+  return topology->node_of_cpu[cpu];
+}
+
+err_t topology_bind_to_node(const topology_t * topology, size_t node, pthread_attr_t * attr)
+{
+  assert(topology != NULL);
+  assert(node < topology->nodes_number);
+  assert(attr != NULL);
+
+  int ret = pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &topology->node_cpus[node]);
+
+  return ret == 0 ? E_OK : E_SYSFAIL;
+}
+
+err_t topology_bind_to_cpu(size_t cpu, pthread_attr_t * attr)
+{
+  assert(cpu < CPU_SETSIZE);
+  assert(attr != NULL);
+
+  cpu_set_t cpus;
+
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+
+  return pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &cpus) == 0 ? E_OK : E_SYSFAIL;
+}
+
+bool topology_cpu_is_usable(size_t cpu)
+{
+  if (cpu >= CPU_SETSIZE) return false;
+
+  cpu_set_t allowed;
+
+  get_allowed_cpus(&allowed);
+
+  return CPU_ISSET(cpu, &allowed);
+}
@@ -0,0 +1,46 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "internals/common.h"
+
+/**
+ * NUMA nodes of the machine and their CPUs, as far as the process is
+ * allowed to run on them. Nodes are numbered from 0 with no gaps, in
+ * the order of their system ids.
+ *
+ * Read from sysfs once, a machine it is not found on looks like
+ * a single node.
+ */
+typedef struct topology_s topology_t;
+
+topology_t * topology_create(void);
+
+void topology_destroy(topology_t * topology);
+
+size_t topology_nodes_number(const topology_t * topology);
+
+/**
+ * The node of the CPU the calling thread is running on right now.
+ */
+size_t topology_current_node(const topology_t * topology);
+
+/**
+ * Makes threads created with the attributes run on CPUs of the node only.
+ */
+err_t topology_bind_to_node(const topology_t * topology, size_t node, pthread_attr_t * attr);
+
+/**
+ * Makes threads created with the attributes run on the CPU only.
+ */
+err_t topology_bind_to_cpu(size_t cpu, pthread_attr_t * attr);
+
+/**
+ * Tells whether the process is allowed to run on the CPU.
+ */
+bool topology_cpu_is_usable(size_t cpu);
+
+#endif
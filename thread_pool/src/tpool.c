@@ -1,152 +1,1878 @@
 #include <pthread.h>
 #include <stdlib.h>
-#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdalign.h>
+#include <stdatomic.h>
 #include <unistd.h>
+#include <sched.h>
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
+#include <time.h>
 
 #include "work_queue.h"
+#include "work_deque.h"
+#include "completion.h"
+#include "timers.h"
+#include "topology.h"
+#include "trace.h"
+#include "slab.h"
+#include "internals/pool.h"
 
 #include "tpool.h"
 
-struct tpool_s
+#define CACHE_LINE_SIZE 64
+
+/**
+ * Spin budget never shrinks below this, unless spinning is disabled.
+ */
+#define IDLE_SPINS_FLOOR 16
+
+#define NS_PER_SECOND 1000000000
+
+/**
+ * Written by the owner only, read by anyone.
+ */
+typedef struct worker_stats_s
+{
+  atomic_size_t    idle_spun;
+  atomic_size_t    idle_yielded;
+  atomic_size_t    idle_parked;
+  atomic_size_t    spurious_wakeups;
+
+  atomic_size_t    executed;
+  atomic_size_t    stolen;
+
+  /* measured with metrics on only */
+  _Atomic uint64_t running_ns;
+  _Atomic uint64_t idle_ns;
+  _Atomic uint64_t parked_ns;
+
+  atomic_size_t    waited[TPOOL_HISTOGRAM_BUCKETS];
+  atomic_size_t    ran[TPOOL_HISTOGRAM_BUCKETS];
+} worker_stats_t;
+
+/**
+ * A work submitted with metrics on, carrying its submission time.
+ * Freed once the work starts.
+ */
+typedef struct metered_work_s
+{
+  tpool_t * tpool;
+
+  work_t    work;
+  uint64_t  submitted_ns;
+} metered_work_t;
+
+/**
+ * Works submitted with metrics on are wrapped in batches this large.
+ */
+#define METERED_BATCH_SIZE 64
+
+typedef enum worker_state_e
+{
+  WORKER_VACANT = 0,  /* no thread */
+  WORKER_RUNNING,
+  WORKER_EXITED,      /* the thread is gone, but not joined yet */
+  WORKER_JOINING,     /* `tpool_join()` waits for the thread */
+} worker_state_t;
+
+typedef struct worker_s
 {
-  size_t         threads_number;
+  alignas(CACHE_LINE_SIZE) tpool_t * tpool;
+
+  /* of the NUMA node the worker runs on */
   work_queue_t * work_queue;
+  size_t         node;
+
+  /* works submitted from this worker's tasks, others steal from here */
+  work_deque_t * deque;
+
+  /* works taken from the work queue at once, run in order */
+  work_t       * grabbed;
+  size_t         grabbed_number;
+  size_t         grabbed_next;
+
+  /* state of the random generator used to pick victims */
+  uint32_t       seed;
+
+  /* adapted between 0 and tpool's `idle_spins` */
+  size_t         spin_budget;
+
+  /* woken up, and looked for no work since */
+  bool           woken;
+
+  worker_stats_t stats;
+
+  pthread_t      thread;
+  worker_state_t state; // guarded by the pool's `resize_mutex`
+} worker_t;
+
+/**
+ * There is a slot in `workers` for every thread the pool may have.
+ * The first `workers_min` ones are started with the pool and run till
+ * it shuts down, the extra ones come and go with the load.
+ */
+struct tpool_s
+{
+  size_t         workers_number;
+  size_t         workers_min;
+  size_t         grab_size;
+  size_t         idle_spins;
+  size_t         idle_yields;
+  bool           metrics;
+  tracer_t     * tracer; // when tracing
+
+  /* group works and metered works, see `tpool_record_alloc()` */
+  slab_t       * records;
+
+  /* one per NUMA node used */
+  work_queue_t ** work_queues;
+  size_t          nodes_number;
+  topology_t    * topology; // unless there is a single node
+
+  /* records behind futures */
+  completion_pool_t * completions;
+
+  /* works enqueued later, an idle worker sleeps till their next event */
+  timers_t          * timers;
+  atomic_bool         timekeeper; // there is such a worker
+
+  /* used by elastic pools only */
+  pthread_mutex_t     resize_mutex;
+  atomic_size_t       workers_running;
+  atomic_size_t       workers_idle;
+  size_t              grow_queue_depth;
+  uint64_t            keepalive_ns;
+
+  /* kept to start extra workers the same way */
+  tpool_affinity_t    affinity;
+  size_t            * cpus;
+  size_t              cpus_number;
+  size_t              stack_size;
+  size_t              guard_size;
+  char              * stacks;
+
+  worker_t       workers[];
+};
+
+/**
+ * `pending` reaches 0 only under `mutex`, so a waiter that saw it there
+ * and then took the mutex knows the last completer is gone.
+ *
+ * Workers waiting for the group park with the idle ones, counted by
+ * `helpers`, so works spawned meanwhile wake them up as well as the end
+ * of the group does.
+ */
+struct tpool_group_s
+{
+  tpool_t         * tpool;
+
+  atomic_size_t     pending;
+  atomic_bool       cancelled; // till the group is waited for
+  atomic_size_t     helpers;
+
+  pthread_mutex_t   mutex;
+  pthread_cond_t    done_cv;
+};
+
+typedef struct group_work_s
+{
+  tpool_group_t        * group;
+
+  tpool_work_routine_t   routine;
+  void                 * arg;
+} group_work_t;
+
+/**
+ * Size of the pool's records, see `tpool_record_alloc()`.
+ */
+#define RECORD_SIZE \
+  (sizeof(group_work_t) > sizeof(metered_work_t) ? sizeof(group_work_t) : sizeof(metered_work_t))
+
+/* The worker the calling thread is, if any. */
+static _Thread_local worker_t * current_worker = NULL;
+
+static uint32_t worker_random(worker_t * worker)
+{
+  /* xorshift32 */
+  uint32_t x = worker->seed;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+
+  return worker->seed = x;
+}
+
+static void worker_stats_init(worker_stats_t * stats)
+{
+  atomic_init(&stats->idle_spun,        0);
+  atomic_init(&stats->idle_yielded,     0);
+  atomic_init(&stats->idle_parked,      0);
+  atomic_init(&stats->spurious_wakeups, 0);
+  atomic_init(&stats->executed,         0);
+  atomic_init(&stats->stolen,           0);
+  atomic_init(&stats->running_ns,       0);
+  atomic_init(&stats->idle_ns,          0);
+  atomic_init(&stats->parked_ns,        0);
+
+  for (size_t i = 0; i < TPOOL_HISTOGRAM_BUCKETS; i++)
+  {
+    atomic_init(&stats->waited[i], 0);
+    atomic_init(&stats->ran[i],    0);
+  }
+}
+
+static void worker_count(atomic_size_t * counter)
+{
+  // the owner is the only writer
+  atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+static void worker_count_ns(_Atomic uint64_t * counter, uint64_t ns)
+{
+  atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + ns, memory_order_relaxed);
+}
+
+static void worker_count_duration(atomic_size_t * histogram, uint64_t ns)
+{
+  size_t bucket = 63 - (size_t) __builtin_clzll(ns | 1);
+
+  if (bucket >= TPOOL_HISTOGRAM_BUCKETS) bucket = TPOOL_HISTOGRAM_BUCKETS - 1;
+
+  worker_count(&histogram[bucket]);
+}
+
+static uint64_t monotonic_ns(void)
+{
+  struct timespec now;
+
+  asserting_eok(clock_gettime(CLOCK_MONOTONIC, &now));
+
+  return (uint64_t) now.tv_sec * NS_PER_SECOND + (uint64_t) now.tv_nsec;
+}
+
+static size_t worker_index(const worker_t * worker)
+{
+  return (size_t) (worker - worker->tpool->workers);
+}
+
+/**
+ * The cache of records of the calling thread, if it is a worker of the pool.
+ */
+static slab_cache_t * tpool_records_cache(tpool_t * tpool)
+{
+  worker_t * worker = current_worker;
+
+  if (worker == NULL || worker->tpool != tpool) return NULL;
+
+  return slab_cache(tpool->records, worker_index(worker));
+}
+
+/**
+ * Records are allocated per work and mostly freed by another thread,
+ * so they come from the pool's slab rather than from malloc().
+ */
+static void * tpool_record_alloc(tpool_t * tpool)
+{
+  return slab_alloc(tpool->records, tpool_records_cache(tpool));
+}
+
+static void tpool_record_free(tpool_t * tpool, void * record)
+{
+  slab_free(tpool->records, tpool_records_cache(tpool), record);
+}
+
+static void metered_work_routine(void * arg)
+{
+  metered_work_t * metered = arg;
+
+  work_t work = metered->work;
+
+  tpool_record_free(metered->tpool, metered);
+
+  work.routine(work.arg);
+}
+
+static bool work_meter(tpool_t * tpool, const work_t * p_work, uint64_t now, work_t * p_metered)
+{
+  metered_work_t * metered = tpool_record_alloc(tpool);
+
+  if (metered == NULL) return false;
+
+  metered->tpool        = tpool;
+  metered->work         = *p_work;
+  metered->submitted_ns = now;
+
+  p_metered->routine = metered_work_routine;
+  p_metered->arg     = metered;
+
+  return true;
+}
+
+/**
+ * Runs the work, and measures and traces it if asked to.
+ */
+static void worker_run(worker_t * worker, const work_t * p_work)
+{
+  tpool_t        * tpool = worker->tpool;
+  worker_stats_t * stats = &worker->stats;
+
+  worker_count(&stats->executed);
+
+  if (!tpool->metrics && tpool->tracer == NULL)
+  {
+    p_work->routine(p_work->arg);
+    return;
+  }
+
+  work_t work = *p_work;
+
+  uint64_t started_ns = monotonic_ns();
+
+  if (work.routine == metered_work_routine)
+  {
+    metered_work_t * metered = work.arg;
+
+    worker_count_duration(stats->waited, started_ns - metered->submitted_ns);
+
+    work = metered->work;
+    tpool_record_free(tpool, metered);
+  }
+
+  if (tpool->tracer != NULL)
+  {
+    tracer_record(tpool->tracer, worker_index(worker), TRACE_START, started_ns, &work);
+  }
+
+  work.routine(work.arg);
+
+  uint64_t ended_ns = monotonic_ns();
+
+  if (tpool->tracer != NULL)
+  {
+    tracer_record(tpool->tracer, worker_index(worker), TRACE_END, ended_ns, &work);
+  }
+
+  if (tpool->metrics)
+  {
+    worker_count_ns(&stats->running_ns, ended_ns - started_ns);
+    worker_count_duration(stats->ran, ended_ns - started_ns);
+  }
+}
+
+static bool worker_steal(worker_t * worker, work_t * p_work)
+{
+  tpool_t * tpool = worker->tpool;
+
+  size_t n     = tpool->workers_number;
+  size_t first = worker_random(worker) % n;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    worker_t * victim = &tpool->workers[(first + i) % n];
+
+    if (victim == worker) continue;
+
+    if (work_deque_steal(victim->deque, p_work) == E_OK)
+    {
+      worker_count(&worker->stats.stolen);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * Takes up to `grab_size` works from the work queue, but no more than
+ * a fair share of it, so other workers are not left idle.
+ */
+static err_t worker_grab_works(worker_t * worker, work_queue_t * work_queue)
+{
+  tpool_t * tpool = worker->tpool;
+
+  size_t share = work_queue_size(work_queue) / (tpool->workers_number / tpool->nodes_number);
+
+  if (share < 1)                share = 1;
+  if (share > tpool->grab_size) share = tpool->grab_size;
+
+  worker->grabbed_next = 0;
+
+  return work_queue_pop_n(work_queue, worker->grabbed, share, &worker->grabbed_number);
+}
+
+static bool worker_take_grabbed(worker_t * worker, work_t * p_work)
+{
+  if (worker->grabbed_next == worker->grabbed_number) return false;
+
+  *p_work = worker->grabbed[worker->grabbed_next++];
+
+  return true;
+}
+
+/**
+ * Looks for a work among the grabbed ones, in the own deque, then
+ * in other workers' deques, then in the node's work queue, then in
+ * the ones of other nodes.
+ *
+ * The worker never leaves while it has grabbed works or its own deque is
+ * not empty, and only the owner pushes to it, so no work is left behind
+ * once the node's queue reports E_BADREQ. Other queues are left to
+ * workers of their nodes.
+ */
+static err_t worker_find_work(worker_t * worker, work_t * p_work)
+{
+  tpool_t * tpool = worker->tpool;
+
+  if (worker_take_grabbed(worker, p_work)) return E_OK;
+
+  // urgent works are not kept behind the ones spawned locally
+  if (work_queue_size_of(worker->work_queue, WORK_PRIORITY_HIGH) > 0
+   && worker_grab_works(worker, worker->work_queue) == E_OK)
+  {
+    asserting(worker_take_grabbed(worker, p_work));
+    return E_OK;
+  }
+
+  if (work_deque_pop(worker->deque, p_work) == E_OK) return E_OK;
+
+  if (worker_steal(worker, p_work)) return E_OK;
+
+  err_t err = worker_grab_works(worker, worker->work_queue);
+
+  for (size_t i = 1; i < tpool->nodes_number && err == E_UNDERFLOW; i++)
+  {
+    work_queue_t * remote = tpool->work_queues[(worker->node + i) % tpool->nodes_number];
+
+    if (worker_grab_works(worker, remote) == E_OK) err = E_OK;
+  }
+
+  if (err == E_OK)
+  {
+    asserting(worker_take_grabbed(worker, p_work));
+  }
+
+  return err;
+}
+
+/**
+ * Probe for `work_queue_wait_for_work()`.
+ */
+static bool worker_can_steal(void * context)
+{
+  worker_t * worker = context;
+  tpool_t  * tpool  = worker->tpool;
+
+  for (size_t i = 0; i < tpool->workers_number; i++)
+  {
+    worker_t * victim = &tpool->workers[i];
+
+    if (victim != worker && !work_deque_is_empty(victim->deque)) return true;
+  }
+
+  return false;
+}
+
+static bool worker_has_work(worker_t * worker)
+{
+  work_queue_t * work_queue = worker->work_queue;
+
+  return work_queue_size(work_queue) > 0
+      || work_queue_is_stopped(work_queue)
+      || worker_can_steal(worker);
+}
+
+/**
+ * Probe for a worker parking with no deadline.
+ */
+static bool worker_should_wake(void * context)
+{
+  worker_t * worker = context;
+  tpool_t  * tpool  = worker->tpool;
+
+  if (worker_can_steal(worker)) return true;
+
+  // armed timers need an idle worker sleeping till their next event
+  return timers_armed(tpool->timers) > 0 && !atomic_load(&tpool->timekeeper);
+}
+
+typedef struct timekeeping_s
+{
+  worker_t * worker;
+  size_t     epoch;
+} timekeeping_t;
+
+/**
+ * Probe for the worker parking till the next timer event.
+ */
+static bool timekeeper_should_wake(void * context)
+{
+  timekeeping_t * timekeeping = context;
+  tpool_t       * tpool       = timekeeping->worker->tpool;
+
+  if (worker_can_steal(timekeeping->worker)) return true;
+
+  // the next event moved earlier
+  return timers_epoch(tpool->timers) != timekeeping->epoch;
+}
+
+static bool worker_is_extra(const worker_t * worker)
+{
+  return worker_index(worker) >= worker->tpool->workers_min;
+}
+
+static uint64_t realtime_ns(void)
+{
+  struct timespec now;
+
+  asserting_eok(clock_gettime(CLOCK_REALTIME, &now));
+
+  return (uint64_t) now.tv_sec * NS_PER_SECOND + (uint64_t) now.tv_nsec;
+}
+
+/**
+ * Parks an extra worker for the keepalive at most.
+ *
+ * @return true if the worker has been idle that long.
+ */
+static bool worker_park_extra(worker_t * worker)
+{
+  uint64_t expiry = realtime_ns() + worker->tpool->keepalive_ns;
+
+  struct timespec deadline =
+  {
+    .tv_sec  = expiry / NS_PER_SECOND,
+    .tv_nsec = expiry % NS_PER_SECOND,
+  };
+
+  work_queue_wait_for_work_timeout(worker->work_queue, worker_should_wake, worker, &deadline);
+
+  return realtime_ns() >= expiry;
+}
+
+/**
+ * Parks till there is a work to look for. One of parked workers also
+ * pushes works of due timers, it is woken up when their time comes.
+ *
+ * @return true if an extra worker has been idle for the keepalive.
+ */
+static bool worker_park(worker_t * worker)
+{
+  tpool_t * tpool = worker->tpool;
+
+  if (timers_armed(tpool->timers) == 0 || atomic_exchange(&tpool->timekeeper, true))
+  {
+    if (worker_is_extra(worker)) return worker_park_extra(worker);
+
+    work_queue_wait_for_work(worker->work_queue, worker_should_wake, worker);
+    return false;
+  }
+
+  timekeeping_t timekeeping =
+  {
+    .worker = worker,
+    .epoch  = timers_epoch(tpool->timers),
+  };
+
+  struct timespec deadline;
+
+  timers_poll(tpool->timers, worker->work_queue);
+
+  if (timers_next_deadline(tpool->timers, &deadline))
+  {
+    work_queue_wait_for_work_until(worker->work_queue, timekeeper_should_wake, &timekeeping, &deadline);
+  }
+
+  atomic_store(&tpool->timekeeper, false);
+
+  timers_poll(tpool->timers, worker->work_queue);
+
+  // the worker is likely to be busy for a while, hand the duty over
+  if (timers_armed(tpool->timers) > 0)
+  {
+    work_queue_kick_timed(worker->work_queue);
+  }
+
+  return false;
+}
+
+/**
+ * Spins, then yields, then parks, until there is a work to look for.
+ *
+ * @return true if an extra worker has been idle for the keepalive.
+ */
+static bool worker_idle(worker_t * worker)
+{
+  tpool_t * tpool = worker->tpool;
+
+  size_t budget = worker->spin_budget;
+
+  for (size_t i = 0; i < budget; i++)
+  {
+    CPU_RELAX();
+
+    if (worker_has_work(worker))
+    {
+      size_t grown = budget * 2;
+
+      worker->spin_budget = grown < tpool->idle_spins ? grown : tpool->idle_spins;
+      worker_count(&worker->stats.idle_spun);
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < tpool->idle_yields; i++)
+  {
+    sched_yield();
+
+    if (worker_has_work(worker))
+    {
+      worker_count(&worker->stats.idle_yielded);
+      return false;
+    }
+  }
+
+  // works come too rarely to wait for them spinning
+  size_t shrunk = budget / 2;
+
+  if (shrunk < IDLE_SPINS_FLOOR)
+  {
+    shrunk = budget < IDLE_SPINS_FLOOR ? budget : IDLE_SPINS_FLOOR;
+  }
+
+  worker->spin_budget = shrunk;
+  worker_count(&worker->stats.idle_parked);
+
+  // records freed meanwhile should not wait for this one to wake up
+  slab_cache_flush(tpool->records, slab_cache(tpool->records, worker_index(worker)));
+
+  uint64_t parked_ns = tpool->metrics ? monotonic_ns() : 0;
+
+  bool expired = worker_park(worker);
+
+  if (tpool->metrics) worker_count_ns(&worker->stats.parked_ns, monotonic_ns() - parked_ns);
+
+  // running out of the keepalive is no wakeup
+  worker->woken = !expired;
+
+  return expired;
+}
+
+/**
+ * An extra worker leaves once idle for the keepalive, unless
+ * `tpool_join()` waits for it already, then it leaves the usual way.
+ */
+static bool worker_retire(worker_t * worker)
+{
+  tpool_t * tpool = worker->tpool;
+
+  bool retired = false;
+
+  asserting_eok(pthread_mutex_lock(&tpool->resize_mutex));
+  {
+    if (worker->state == WORKER_RUNNING)
+    {
+      worker->state = WORKER_EXITED;
+      retired       = true;
+
+      atomic_fetch_sub(&tpool->workers_running, 1);
+    }
+  }
+  asserting_eok(pthread_mutex_unlock(&tpool->resize_mutex));
+
+  // it may have been woken up to keep the time
+  if (retired && timers_armed(tpool->timers) > 0 && !atomic_load(&tpool->timekeeper))
+  {
+    work_queue_kick_timed(worker->work_queue);
+  }
+
+  return retired;
+}
+
+static bool tpool_is_elastic(const tpool_t * tpool)
+{
+  return tpool->workers_min < tpool->workers_number;
+}
+
+static void tpool_grow(tpool_t * tpool, size_t waiting);
+
+static void * thread_routine(void * arg)
+{
+  worker_t * worker = arg;
+  tpool_t  * tpool  = worker->tpool;
+
+  work_t work;
+  err_t  err;
+
+  bool elastic = tpool_is_elastic(tpool);
+  bool expired = false;
+
+  current_worker = worker;
+
+  while ((err = worker_find_work(worker, &work)) != E_BADREQ)
+  {
+    if (err == E_OK)
+    {
+      expired       = false;
+      worker->woken = false;
+
+      // the work may block for long, let another worker take the rest
+      if (elastic) tpool_grow(tpool, work_queue_size(worker->work_queue));
+
+      worker_run(worker, &work);
+
+      if (timers_are_due(worker->tpool->timers))
+      {
+        timers_poll(worker->tpool->timers, worker->work_queue);
+      }
+    }
+    else if (expired)
+    {
+      // still nothing to do after the keepalive
+      if (worker_retire(worker)) break;
+
+      expired = false;
+    }
+    else
+    {
+      assert(err == E_UNDERFLOW);
+
+      if (worker->woken)
+      {
+        worker_count(&worker->stats.spurious_wakeups);
+        worker->woken = false;
+      }
+
+      uint64_t idle_ns = tpool->metrics ? monotonic_ns() : 0;
+
+      if (elastic) atomic_fetch_add(&tpool->workers_idle, 1);
+
+      expired = worker_idle(worker);
+
+      if (elastic) atomic_fetch_sub(&tpool->workers_idle, 1);
+
+      if (tpool->metrics) worker_count_ns(&worker->stats.idle_ns, monotonic_ns() - idle_ns);
+    }
+  }
+
+  slab_cache_flush(tpool->records, slab_cache(tpool->records, worker_index(worker)));
+
+  current_worker = NULL;
+
+  return NULL;
+}
+
+static err_t worker_attr_set_stack(const worker_t * worker, size_t i, pthread_attr_t * attr)
+{
+  tpool_t * tpool = worker->tpool;
+
+  if (tpool->stacks != NULL)
+  {
+    // the slot is reused only after its previous thread is joined
+    char * stack = tpool->stacks + i * tpool->stack_size;
+
+    EOK_OR_RETURN(pthread_attr_setstack(attr, stack, tpool->stack_size), E_SYSFAIL);
+
+    return E_OK;
+  }
+
+  EOK_OR_RETURN(pthread_attr_setstacksize(attr, tpool->stack_size), E_SYSFAIL);
+  EOK_OR_RETURN(pthread_attr_setguardsize(attr, tpool->guard_size), E_SYSFAIL);
+
+  return E_OK;
+}
+
+static err_t worker_attr_set_affinity(const worker_t * worker, size_t i, pthread_attr_t * attr)
+{
+  tpool_t * tpool = worker->tpool;
+
+  switch (tpool->affinity)
+  {
+    case TPOOL_AFFINITY_NONE: return E_OK;
+    case TPOOL_AFFINITY_CPUS: return topology_bind_to_cpu(tpool->cpus[i % tpool->cpus_number], attr);
+    case TPOOL_AFFINITY_NUMA: return topology_bind_to_node(tpool->topology, worker->node, attr);
+  }
+
+  UNREACHABLE();
+}
+
+/**
+ * Attributes of the worker's thread, with the stack and pinned as configured.
+ */
+static err_t worker_attr_init(const worker_t * worker, pthread_attr_t * attr)
+{
+  size_t i = worker_index(worker);
+
+  EOK_OR_RETURN(pthread_attr_init(attr), E_SYSFAIL);
+
+  err_t err = worker_attr_set_stack(worker, i, attr);
+
+  if (err == E_OK) err = worker_attr_set_affinity(worker, i, attr);
+
+  if (err != E_OK) asserting_eok(pthread_attr_destroy(attr));
+
+  return err;
+}
+
+/**
+ * Starts a thread in a vacant slot, or in the one of a retired worker.
+ * Should be called with `resize_mutex` locked, unless the pool is
+ * being created.
+ */
+static err_t worker_start(worker_t * worker)
+{
+  assert(worker->state != WORKER_RUNNING);
+
+  // its thread may still run, `tpool_join()` owns the slot
+  if (worker->state == WORKER_JOINING) return E_BADREQ;
+
+  if (worker->state == WORKER_EXITED)
+  {
+    EOK_OR_RETURN(pthread_join(worker->thread, NULL), E_SYSFAIL);
+
+    worker->state = WORKER_VACANT;
+  }
+
+  worker->grabbed_number = 0;
+  worker->grabbed_next   = 0;
+  worker->spin_budget    = worker->tpool->idle_spins;
+  worker->woken          = false;
+
+  pthread_attr_t attr;
+
+  if (worker_attr_init(worker, &attr) != E_OK) return E_SYSFAIL;
+
+  int ret = pthread_create(&worker->thread, &attr, thread_routine, worker);
+
+  asserting_eok(pthread_attr_destroy(&attr));
+
+  assert(ret == 0 || ret == EAGAIN && "pthread_create() failed");
+
+  if (ret != 0) return E_SYSFAIL;
+
+  worker->state = WORKER_RUNNING;
+
+  atomic_fetch_add(&worker->tpool->workers_running, 1);
+
+  return E_OK;
+}
+
+/**
+ * Starts an extra worker when more than `grow_queue_depth` works are
+ * waiting while no worker is idle to take them.
+ */
+static void tpool_grow(tpool_t * tpool, size_t waiting)
+{
+  assert(tpool_is_elastic(tpool));
+
+  if (waiting <= tpool->grow_queue_depth) return;
+  if (atomic_load(&tpool->workers_idle) > 0) return;
+  if (atomic_load(&tpool->workers_running) == tpool->workers_number) return;
+
+  asserting_eok(pthread_mutex_lock(&tpool->resize_mutex));
+  {
+    // no point in starting it once the pool is shutting down
+    bool stopped = work_queue_is_stopped(tpool->work_queues[0]);
+
+    for (size_t i = tpool->workers_min; i < tpool->workers_number && !stopped; i++)
+    {
+      worker_t * worker = &tpool->workers[i];
+
+      if (worker->state == WORKER_RUNNING || worker->state == WORKER_JOINING) continue;
+
+      // out of threads, the running ones carry on
+      worker_start(worker);
+      break;
+    }
+  }
+  asserting_eok(pthread_mutex_unlock(&tpool->resize_mutex));
+}
+
+static work_queue_t * work_queue_create_for(const tpool_config_t * config)
+{
+  switch (config->queue)
+  {
+    case TPOOL_QUEUE_LOCKED:   return work_queue_create();
+    case TPOOL_QUEUE_LOCKFREE: return work_queue_create_lockfree(config->queue_capacity);
+    case TPOOL_QUEUE_BOUNDED:  return work_queue_create_bounded(config->queue_capacity);
+  }
+
+  UNREACHABLE();
+}
+
+size_t tpool_workers_number(const tpool_t * tpool)
+{
+  assert(tpool != NULL);
+
+  return tpool->workers_number;
+}
+
+void tpool_config_init(tpool_config_t * config, size_t threads_number)
+{
+  assert(config != NULL);
+
+  config->threads_number = threads_number;
+
+  config->queue          = TPOOL_QUEUE_LOCKED;
+  config->queue_capacity = TPOOL_DEFAULT_QUEUE_CAPACITY;
+
+  config->priority_aging = TPOOL_DEFAULT_PRIORITY_AGING;
+
+  config->grab_size      = TPOOL_DEFAULT_GRAB_SIZE;
+
+  // nobody could make a work appear while the only CPU is spinning
+  config->idle_spins     = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? TPOOL_DEFAULT_IDLE_SPINS : 0;
+  config->idle_yields    = TPOOL_DEFAULT_IDLE_YIELDS;
+
+  config->affinity       = TPOOL_AFFINITY_NONE;
+  config->cpus           = NULL;
+  config->cpus_number    = 0;
+
+  config->max_threads_number = 0;
+  config->grow_queue_depth   = 0;
+  config->keepalive_ns       = TPOOL_DEFAULT_KEEPALIVE_NS;
+
+  pthread_attr_t attr;
+
+  asserting_eok(pthread_attr_init(&attr));
+  asserting_eok(pthread_attr_getstacksize(&attr, &config->stack_size));
+  asserting_eok(pthread_attr_getguardsize(&attr, &config->guard_size));
+  asserting_eok(pthread_attr_destroy(&attr));
+
+  config->stacks = NULL;
+
+  config->metrics = false;
+
+  config->trace_capacity = 0;
+}
+
+tpool_ret_t tpool_create(tpool_t ** p_tpool, size_t threads_number)
+{
+  tpool_config_t config;
+
+  tpool_config_init(&config, threads_number);
+
+  return tpool_create_ex(p_tpool, &config);
+}
+
+tpool_ret_t tpool_create_ex(tpool_t ** p_tpool, const tpool_config_t * config)
+{
+  CHECK_PARAM(p_tpool != NULL);
+  CHECK_PARAM(config != NULL);
+  CHECK_PARAM(config->threads_number > 0);
+  CHECK_PARAM(config->queue == TPOOL_QUEUE_LOCKED || config->queue == TPOOL_QUEUE_LOCKFREE ||
+              config->queue == TPOOL_QUEUE_BOUNDED);
+  CHECK_PARAM(config->queue == TPOOL_QUEUE_LOCKED || config->queue_capacity > 0);
+  CHECK_PARAM(config->grab_size > 0);
+  CHECK_PARAM(config->affinity >= TPOOL_AFFINITY_NONE && config->affinity <= TPOOL_AFFINITY_NUMA);
+  CHECK_PARAM(config->max_threads_number == 0 || config->max_threads_number >= config->threads_number);
+  CHECK_PARAM(config->stack_size >= PTHREAD_STACK_MIN);
+
+  if (config->affinity == TPOOL_AFFINITY_CPUS)
+  {
+    CHECK_PARAM(config->cpus != NULL && config->cpus_number > 0);
+
+    for (size_t i = 0; i < config->cpus_number; i++)
+    {
+      CHECK_PARAM(topology_cpu_is_usable(config->cpus[i]));
+    }
+  }
+
+  size_t threads_number = config->threads_number;
+  size_t workers_number = config->max_threads_number > 0 ? config->max_threads_number : threads_number;
+
+  tpool_t * tpool = NULL;
+
+  size_t size = sizeof(tpool_t) + sizeof(worker_t) * workers_number;
+
+  TRY_NEW(1, tpool = aligned_alloc(alignof(tpool_t), size));
+
+  if (pthread_mutex_init(&tpool->resize_mutex, NULL) != 0)
+  {
+    free(tpool);
+    return TPOOL_ESYSFAIL;
+  }
+
+  tpool->workers_number = workers_number;
+  tpool->workers_min    = threads_number;
+  tpool->grab_size      = config->grab_size;
+  tpool->idle_spins     = config->idle_spins;
+  tpool->idle_yields    = config->idle_yields;
+  tpool->metrics        = config->metrics;
+  tpool->tracer         = NULL;
+  tpool->records        = NULL;
+  tpool->work_queues    = NULL;
+  tpool->nodes_number   = 1;
+  tpool->topology       = NULL;
+  tpool->completions    = NULL;
+  tpool->timers         = NULL;
+
+  tpool->grow_queue_depth = config->grow_queue_depth;
+  tpool->keepalive_ns     = config->keepalive_ns;
+
+  tpool->affinity         = config->affinity;
+  tpool->cpus             = NULL;
+  tpool->cpus_number      = 0;
+  tpool->stack_size       = config->stack_size;
+  tpool->guard_size       = config->guard_size;
+  tpool->stacks           = config->stacks;
+
+  atomic_init(&tpool->timekeeper,      false);
+  atomic_init(&tpool->workers_running, 0);
+  atomic_init(&tpool->workers_idle,    0);
+
+  for (size_t i = 0; i < workers_number; i++)
+  {
+    worker_t * worker = &tpool->workers[i];
+
+    worker->tpool          = tpool;
+    worker->work_queue     = NULL;
+    worker->node           = 0;
+    worker->deque          = NULL;
+    worker->grabbed        = NULL;
+    worker->grabbed_number = 0;
+    worker->grabbed_next   = 0;
+    worker->seed           = (uint32_t) (i + 1) * 2654435761u;
+    worker->spin_budget    = config->idle_spins;
+    worker->state          = WORKER_VACANT;
+    worker->woken          = false;
+
+    worker_stats_init(&worker->stats);
+  }
+
+  if (config->affinity == TPOOL_AFFINITY_CPUS)
+  {
+    TRY_NEW(1, tpool->cpus = malloc(sizeof(size_t) * config->cpus_number));
+
+    memcpy(tpool->cpus, config->cpus, sizeof(size_t) * config->cpus_number);
+
+    tpool->cpus_number = config->cpus_number;
+  }
+
+  if (config->affinity == TPOOL_AFFINITY_NUMA)
+  {
+    TRY_NEW(1, tpool->topology = topology_create());
+
+    size_t nodes_number = topology_nodes_number(tpool->topology);
+
+    // every node used should have a worker serving its queue
+    tpool->nodes_number = nodes_number < threads_number ? nodes_number : threads_number;
+  }
+
+  TRY_NEW(1, tpool->work_queues = calloc(tpool->nodes_number, sizeof(work_queue_t *)));
+
+  for (size_t i = 0; i < tpool->nodes_number; i++)
+  {
+    TRY_NEW(1, tpool->work_queues[i] = work_queue_create_for(config));
+
+    work_queue_set_aging(tpool->work_queues[i], config->priority_aging);
+  }
+
+  for (size_t i = 0; i < workers_number; i++)
+  {
+    tpool->workers[i].node       = i % tpool->nodes_number;
+    tpool->workers[i].work_queue = tpool->work_queues[tpool->workers[i].node];
+  }
+
+  TRY_NEW(1, tpool->completions = completion_pool_create());
+  TRY_NEW(1, tpool->timers      = timers_create());
+  TRY_NEW(1, tpool->records     = slab_create(RECORD_SIZE, workers_number));
+
+  if (config->trace_capacity > 0)
+  {
+    TRY_NEW(1, tpool->tracer = tracer_create(workers_number, config->trace_capacity));
+  }
+
+  for (size_t i = 0; i < workers_number; i++)
+  {
+    TRY_NEW(1, tpool->workers[i].deque   = work_deque_create());
+    TRY_NEW(1, tpool->workers[i].grabbed = malloc(sizeof(work_t) * config->grab_size));
+  }
+
+  size_t threads_created = 0;
+
+  while (threads_created < threads_number && worker_start(&tpool->workers[threads_created]) == E_OK)
+  {
+    threads_created++;
+  }
+
+  if (threads_created != threads_number) goto rollback;
+
+  *p_tpool = tpool;
+
+  return TPOOL_SUCCESS;
+
+rollback:
+  if (threads_created > 0)
+  {
+    // Here tpool is a valid thread pool,
+    // but with less number of threads then requested.
+    tpool_shutdown(tpool);
+    tpool_join(tpool);
+  }
+
+  tpool_destroy(tpool);
+  return TPOOL_ESYSFAIL;
+
+try_failure_1:
+  tpool_destroy(tpool);
+  return TPOOL_EMEMALLOC;
+}
+
+tpool_ret_t tpool_destroy(tpool_t * tpool)
+{
+  if (tpool != NULL)
+  {
+    for (size_t i = 0; i < tpool->workers_number; i++)
+    {
+      work_deque_destroy(tpool->workers[i].deque);
+      free(tpool->workers[i].grabbed);
+    }
+
+    for (size_t i = 0; tpool->work_queues != NULL && i < tpool->nodes_number; i++)
+    {
+      work_queue_destroy(tpool->work_queues[i]);
+    }
+
+    free(tpool->work_queues);
+    free(tpool->cpus);
+    topology_destroy(tpool->topology);
+    completion_pool_destroy(tpool->completions);
+    timers_destroy(tpool->timers);
+    tracer_destroy(tpool->tracer);
+    slab_destroy(tpool->records);
+
+    asserting_eok(pthread_mutex_destroy(&tpool->resize_mutex));
+
+    free(tpool);
+  }
+
+  return TPOOL_SUCCESS;
+}
+
+/**
+ * Records works submitted by the calling thread at `now`.
+ */
+static void tpool_trace_submits(tpool_t * tpool, uint64_t now, const work_t * works, size_t n)
+{
+  worker_t * worker = current_worker;
+
+  size_t ring = worker != NULL && worker->tpool == tpool ? worker_index(worker) : TRACE_SHARED;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    tracer_record(tpool->tracer, ring, TRACE_SUBMIT, now, works + i);
+  }
+}
+
+/**
+ * Works submitted from the pool's own tasks go to the worker's deque,
+ * bypassing the shared work queue.
+ */
+static tpool_ret_t worker_add_work(worker_t * worker, const work_t * p_work)
+{
+  tpool_t      * tpool      = worker->tpool;
+  work_queue_t * work_queue = worker->work_queue;
+
+  if (work_queue_is_stopped(work_queue))
+  {
+    return TPOOL_EREQREJECTED;
+  }
+
+  uint64_t now = tpool->metrics || tpool->tracer != NULL ? monotonic_ns() : 0;
+
+  work_t work = *p_work;
+
+  if (tpool->metrics && !work_meter(tpool, p_work, now, &work))
+  {
+    return TPOOL_EMEMALLOC;
+  }
+
+  if (work_deque_push(worker->deque, &work) != E_OK)
+  {
+    if (tpool->metrics) tpool_record_free(tpool, work.arg);
+
+    return TPOOL_EMEMALLOC;
+  }
+
+  if (tpool->tracer != NULL) tpool_trace_submits(tpool, now, p_work, 1);
+
+  if (tpool_is_elastic(tpool)) tpool_grow(tpool, 1);
+
+  // let a sleeping worker come and steal it
+  return work_queue_kick(work_queue, 1) == E_OK ? TPOOL_SUCCESS : TPOOL_ESYSFAIL;
+}
+
+static tpool_ret_t worker_add_works(worker_t * worker, const work_t * works, size_t n)
+{
+  tpool_t      * tpool      = worker->tpool;
+  work_queue_t * work_queue = worker->work_queue;
+
+  tpool_ret_t ret = TPOOL_SUCCESS;
+  size_t      pushed = 0;
+
+  if (work_queue_is_stopped(work_queue))
+  {
+    return TPOOL_EREQREJECTED;
+  }
+
+  uint64_t now = tpool->metrics || tpool->tracer != NULL ? monotonic_ns() : 0;
+
+  for (; pushed < n; pushed++)
+  {
+    work_t work = works[pushed];
+
+    if (tpool->metrics && !work_meter(tpool, works + pushed, now, &work))
+    {
+      ret = TPOOL_EMEMALLOC;
+      break;
+    }
+
+    if (work_deque_push(worker->deque, &work) != E_OK)
+    {
+      if (tpool->metrics) tpool_record_free(tpool, work.arg);
+
+      ret = TPOOL_EMEMALLOC;
+      break;
+    }
+  }
+
+  if (tpool->tracer != NULL) tpool_trace_submits(tpool, now, works, pushed);
+
+  if (tpool_is_elastic(tpool)) tpool_grow(tpool, pushed);
+
+  if (work_queue_kick(work_queue, pushed) != E_OK && ret == TPOOL_SUCCESS)
+  {
+    ret = TPOOL_ESYSFAIL;
+  }
+
+  return ret;
+}
+
+static tpool_ret_t tpool_ret_from_push(err_t err)
+{
+  switch (err)
+  {
+    case E_OK:       return TPOOL_SUCCESS;
+    case E_BADREQ:   return TPOOL_EREQREJECTED;
+    case E_MEMALLOC: return TPOOL_EMEMALLOC;
+    case E_SYSFAIL:  return TPOOL_ESYSFAIL;
+    case E_OVERFLOW: return TPOOL_EQUEUEFULL;
+
+    default: UNREACHABLE();
+  }
+}
+
+/**
+ * The work queue of the node the calling thread runs on.
+ */
+static work_queue_t * tpool_local_queue(tpool_t * tpool)
+{
+  if (tpool->nodes_number == 1) return tpool->work_queues[0];
+
+  // the pool may use fewer nodes than the machine has
+  return tpool->work_queues[topology_current_node(tpool->topology) % tpool->nodes_number];
+}
+
+/**
+ * Pushes works wrapped to carry their submission time.
+ */
+static err_t tpool_push_n(work_queue_t * work_queue, work_priority_t priority, bool block,
+                          const work_t * works, size_t n, size_t * p_pushed)
+{
+  return block ? work_queue_push_n_prio(work_queue, priority, works, n, p_pushed)
+               : work_queue_try_push_n_prio(work_queue, priority, works, n, p_pushed);
+}
+
+static err_t tpool_push_metered(tpool_t * tpool, work_queue_t * work_queue, work_priority_t priority, bool block,
+                                const work_t * works, size_t n, uint64_t now, size_t * p_pushed)
+{
+  work_t metered[METERED_BATCH_SIZE];
+
+  err_t err = E_OK;
+
+  *p_pushed = 0;
+
+  while (err == E_OK && *p_pushed < n)
+  {
+    size_t batch   = n - *p_pushed < METERED_BATCH_SIZE ? n - *p_pushed : METERED_BATCH_SIZE;
+    size_t wrapped = 0;
+    size_t pushed  = 0;
+
+    while (wrapped < batch && work_meter(tpool, works + *p_pushed + wrapped, now, metered + wrapped))
+    {
+      wrapped++;
+    }
+
+    if (wrapped > 0)
+    {
+      err = tpool_push_n(work_queue, priority, block, metered, wrapped, &pushed);
+    }
+
+    if (err == E_OK && wrapped < batch) err = E_MEMALLOC;
+
+    for (size_t i = pushed; i < wrapped; i++)
+    {
+      tpool_record_free(tpool, metered[i].arg);
+    }
+
+    *p_pushed += pushed;
+  }
+
+  return err;
+}
+
+/**
+ * Pushes works to the queue, and starts one more worker to take them
+ * if the pool is elastic and busy.
+ */
+static tpool_ret_t tpool_push(tpool_t * tpool, work_queue_t * work_queue, work_priority_t priority,
+                              const work_t * works, size_t n)
+{
+  size_t pushed = 0;
+
+  uint64_t now = tpool->metrics || tpool->tracer != NULL ? monotonic_ns() : 0;
+
+  // threads of the pool are the ones to make room, waiting for it may never end
+  bool block = current_worker == NULL || current_worker->tpool != tpool;
+
+  err_t err = tpool->metrics ? tpool_push_metered(tpool, work_queue, priority, block, works, n, now, &pushed)
+                             : tpool_push_n(work_queue, priority, block, works, n, &pushed);
+
+  if (tpool->tracer != NULL) tpool_trace_submits(tpool, now, works, pushed);
+
+  if (pushed > 0 && tpool_is_elastic(tpool))
+  {
+    tpool_grow(tpool, work_queue_size(work_queue));
+  }
+
+  return tpool_ret_from_push(err);
+}
+
+tpool_ret_t tpool_add_work(tpool_t * tpool, tpool_work_routine_t routine, void * arg)
+{
+  return tpool_add_work_prio(tpool, TPOOL_PRIORITY_NORMAL, routine, arg);
+}
+
+tpool_ret_t tpool_add_work_prio(tpool_t * tpool, tpool_priority_t priority, tpool_work_routine_t routine, void * arg)
+{
+  CHECK_PARAM(tpool != NULL);
+  CHECK_PARAM(priority >= 0 && priority < TPOOL_PRIORITIES_NUMBER);
+  CHECK_PARAM(routine != NULL);
+
+  work_t work =
+  {
+    .routine = routine,
+    .arg     = arg,
+  };
+
+  worker_t * worker = current_worker;
+
+  if (priority == TPOOL_PRIORITY_NORMAL && worker != NULL && worker->tpool == tpool)
+  {
+    return worker_add_work(worker, &work);
+  }
+
+  return tpool_push(tpool, tpool_local_queue(tpool), priority, &work, 1);
+}
+
+tpool_ret_t tpool_add_work_on_node(tpool_t * tpool, size_t node, tpool_work_routine_t routine, void * arg)
+{
+  CHECK_PARAM(tpool != NULL);
+  CHECK_PARAM(node < tpool->nodes_number);
+  CHECK_PARAM(routine != NULL);
 
-  pthread_t      threads[];
-};
+  work_t work =
+  {
+    .routine = routine,
+    .arg     = arg,
+  };
 
-#define CHECK_PARAM(expr)           \
-  do {                              \
-    if (!(expr))                    \
-    {                               \
-      fprintf(stderr, "[TPOOL_EINVARG]: invalid argument at %s(): %s\n", __FUNCTION__, #expr); \
-      return TPOOL_EINVARG;         \
-    }                               \
-  } while (0)
+  return tpool_push(tpool, tpool->work_queues[node], WORK_PRIORITY_DEFAULT, &work, 1);
+}
 
-static void * thread_routine(void * arg)
+size_t tpool_nodes_number(const tpool_t * tpool)
 {
-  work_queue_t * work_queue = arg;
+  assert(tpool != NULL);
 
-  work_t work;
-  err_t  err;
+  return tpool->nodes_number;
+}
+
+tpool_ret_t tpool_add_works(tpool_t * tpool, const tpool_work_t * works, size_t n)
+{
+  CHECK_PARAM(tpool != NULL);
+  CHECK_PARAM(works != NULL || n == 0);
 
-  while ((err = work_queue_pop(work_queue, &work)) != E_BADREQ)
+  for (size_t i = 0; i < n; i++)
   {
-    if (err == E_OK)
-    {
-      work.routine(work.arg);
-    }
-    else
-    {
-      assert(err == E_UNDERFLOW);
-      work_queue_wait_while_no_work(work_queue);
-    }
+    CHECK_PARAM(works[i].routine != NULL);
   }
 
-  return NULL;
+  worker_t * worker = current_worker;
+
+  if (worker != NULL && worker->tpool == tpool)
+  {
+    return worker_add_works(worker, works, n);
+  }
+
+  return tpool_push(tpool, tpool_local_queue(tpool), WORK_PRIORITY_DEFAULT, works, n);
 }
 
-static size_t try_to_create_threads(size_t n, void * context, pthread_t * threads)
+static tpool_ret_t tpool_add_timer(tpool_t * tpool, uint64_t delay_ns, uint64_t period_ns,
+                                   tpool_work_routine_t routine, void * arg, tpool_timer_t ** p_timer)
 {
-  assert(n > 0);
-  assert(context != NULL);
-  assert(threads != NULL);
-  
-  size_t created = 0;
-  int ret = 0;
+  // all the queues stop at once
+  if (work_queue_is_stopped(tpool->work_queues[0]))
+  {
+    return TPOOL_EREQREJECTED;
+  }
 
-  while (created < n && ret == 0)
+  work_t work =
   {
-    ret = pthread_create(threads + created, NULL, thread_routine, context);
+    .routine = routine,
+    .arg     = arg,
+  };
 
-    assert(ret == 0 || ret == EAGAIN && "pthread_create() failed");
+  bool earlier = false;
 
-    if (ret == 0) created++;
+  if (timers_add(tpool->timers, delay_ns, period_ns, &work, p_timer, &earlier) != E_OK)
+  {
+    return TPOOL_EMEMALLOC;
+  }
+
+  // the sleeping timekeeper should wake up earlier, on whichever node it is
+  for (size_t i = 0; earlier && i < tpool->nodes_number; i++)
+  {
+    if (work_queue_kick_timed(tpool->work_queues[i]) != E_OK) return TPOOL_ESYSFAIL;
   }
 
-  return created;
+  return TPOOL_SUCCESS;
 }
 
-tpool_ret_t tpool_create(tpool_t ** p_tpool, size_t threads_number)
+tpool_ret_t tpool_add_work_after(tpool_t * tpool, uint64_t delay_ns,
+                                 tpool_work_routine_t routine, void * arg, tpool_timer_t ** p_timer)
 {
-  CHECK_PARAM(p_tpool != NULL);
-  CHECK_PARAM(threads_number > 0);
+  CHECK_PARAM(tpool != NULL);
+  CHECK_PARAM(routine != NULL);
+
+  return tpool_add_timer(tpool, delay_ns, 0, routine, arg, p_timer);
+}
+
+tpool_ret_t tpool_add_work_every(tpool_t * tpool, uint64_t period_ns,
+                                 tpool_work_routine_t routine, void * arg, tpool_timer_t ** p_timer)
+{
+  CHECK_PARAM(tpool != NULL);
+  CHECK_PARAM(period_ns > 0);
+  CHECK_PARAM(routine != NULL);
+
+  return tpool_add_timer(tpool, period_ns, period_ns, routine, arg, p_timer);
+}
 
-  tpool_t      * tpool = NULL;
-  work_queue_t * queue = NULL;
+tpool_ret_t tpool_timer_cancel(tpool_timer_t * timer)
+{
+  CHECK_PARAM(timer != NULL);
 
-  size_t size = sizeof(tpool_t) + sizeof(pthread_t) * threads_number;
+  return (tpool_ret_t) timers_cancel(timer);
+}
 
-  TRY_NEW(1, tpool = malloc(size));
-  TRY_NEW(1, queue = work_queue_create());
+tpool_ret_t tpool_submit(tpool_t * tpool, tpool_task_routine_t routine, void * arg, tpool_future_t ** p_future)
+{
+  CHECK_PARAM(tpool != NULL);
+  CHECK_PARAM(routine != NULL);
+  CHECK_PARAM(p_future != NULL);
 
-  size_t threads_created = try_to_create_threads(threads_number, queue, tpool->threads);
+  completion_t * completion = completion_acquire(tpool->completions, routine, arg);
 
-  tpool->threads_number = threads_created; // NOT threads_number, see rollback
-  tpool->work_queue     = queue;
+  if (completion == NULL) return TPOOL_EMEMALLOC;
 
-  if (threads_created != threads_number) goto rollback;
+  tpool_ret_t ret = tpool_add_work(tpool, completion_run, completion);
 
-  *p_tpool = tpool;
+  if (ret != TPOOL_SUCCESS)
+  {
+    completion_discard(completion);
+    return ret;
+  }
+
+  *p_future = (tpool_future_t *) completion;
 
   return TPOOL_SUCCESS;
+}
 
-rollback:
-  if (threads_created > 0)
+tpool_ret_t tpool_future_wait(tpool_future_t * future, void ** p_result)
+{
+  CHECK_PARAM(future != NULL);
+
+  completion_t * completion = (completion_t *) future;
+
+  if (completion_wait(completion) != E_OK) return TPOOL_ESYSFAIL;
+
+  if (completion_is_cancelled(completion)) return TPOOL_ECANCELED;
+
+  if (p_result != NULL) *p_result = completion_result(completion);
+
+  return TPOOL_SUCCESS;
+}
+
+tpool_ret_t tpool_future_try_get(tpool_future_t * future, void ** p_result)
+{
+  CHECK_PARAM(future != NULL);
+
+  completion_t * completion = (completion_t *) future;
+
+  if (!completion_is_done(completion)) return TPOOL_ENOTREADY;
+
+  if (completion_is_cancelled(completion)) return TPOOL_ECANCELED;
+
+  if (p_result != NULL) *p_result = completion_result(completion);
+
+  return TPOOL_SUCCESS;
+}
+
+tpool_ret_t tpool_cancel(tpool_future_t * future)
+{
+  CHECK_PARAM(future != NULL);
+
+  return completion_cancel((completion_t *) future) ? TPOOL_SUCCESS : TPOOL_EREQREJECTED;
+}
+
+tpool_ret_t tpool_future_release(tpool_future_t * future)
+{
+  CHECK_PARAM(future != NULL);
+
+  completion_release((completion_t *) future);
+
+  return TPOOL_SUCCESS;
+}
+
+tpool_ret_t tpool_group_create(tpool_t * tpool, tpool_group_t ** p_group)
+{
+  CHECK_PARAM(tpool != NULL);
+  CHECK_PARAM(p_group != NULL);
+
+  tpool_group_t * group = NULL;
+
+  TRY_NEW(1, group = malloc(sizeof(tpool_group_t)));
+  TRY_EOK(2, pthread_mutex_init(&group->mutex, NULL));
+  TRY_EOK(3, pthread_cond_init(&group->done_cv, NULL));
+
+  group->tpool = tpool;
+
+  atomic_init(&group->pending, 0);
+  atomic_init(&group->cancelled, false);
+  atomic_init(&group->helpers, 0);
+
+  *p_group = group;
+
+  return TPOOL_SUCCESS;
+
+try_failure_3: pthread_mutex_destroy(&group->mutex);
+try_failure_2: free(group);
+               return TPOOL_ESYSFAIL;
+try_failure_1: return TPOOL_EMEMALLOC;
+}
+
+tpool_ret_t tpool_group_destroy(tpool_group_t * group)
+{
+  CHECK_PARAM(group != NULL);
+  CHECK_PARAM(atomic_load(&group->pending) == 0);
+
+  asserting_eok(pthread_cond_destroy(&group->done_cv));
+  asserting_eok(pthread_mutex_destroy(&group->mutex));
+
+  free(group);
+
+  return TPOOL_SUCCESS;
+}
+
+void tpool_group_enter(tpool_group_t * group, size_t n)
+{
+  assert(group != NULL);
+
+  atomic_fetch_add(&group->pending, n);
+}
+
+void tpool_group_leave(tpool_group_t * group)
+{
+  assert(group != NULL);
+
+  size_t pending = atomic_load(&group->pending);
+
+  // only the last one touches the mutex, see `tpool_group_s`
+  while (pending > 1)
   {
-    // Here tpool is a valid thread pool,
-    // but with less number of threads then requested.
-    tpool_shutdown(tpool);
-    tpool_join(tpool);
+    if (atomic_compare_exchange_weak(&group->pending, &pending, pending - 1)) return;
   }
 
-  tpool_destroy(tpool);
-  return TPOOL_ESYSFAIL;
+  tpool_t * tpool   = group->tpool;
+  bool      helped  = false;
 
-try_failure_1:
-  tpool_destroy(tpool);
-  return TPOOL_EMEMALLOC;
+  asserting_eok(pthread_mutex_lock(&group->mutex));
+  {
+    if (atomic_fetch_sub(&group->pending, 1) == 1)
+    {
+      asserting_eok(pthread_cond_broadcast(&group->done_cv));
+
+      // pairs with the helper's probe, either it sees the end or it is seen
+      helped = atomic_load(&group->helpers) > 0;
+    }
+  }
+  asserting_eok(pthread_mutex_unlock(&group->mutex));
+
+  // The group may be gone by now. There is no telling the parked helpers
+  // from idle workers, so all of them are woken up.
+  for (size_t i = 0; helped && i < tpool->nodes_number; i++)
+  {
+    work_queue_kick(tpool->work_queues[i], tpool->workers_number);
+  }
 }
 
-tpool_ret_t tpool_destroy(tpool_t * tpool)
+static void group_work_routine(void * arg)
 {
-  if (tpool != NULL)
+  group_work_t work = *(group_work_t *) arg;
+
+  tpool_record_free(work.group->tpool, arg);
+
+  if (!atomic_load_explicit(&work.group->cancelled, memory_order_relaxed))
   {
-    work_queue_destroy(tpool->work_queue);
-    free(tpool);
+    work.routine(work.arg);
   }
 
-  return TPOOL_SUCCESS;
+  tpool_group_leave(work.group);
 }
 
-tpool_ret_t tpool_add_work(tpool_t * tpool, tpool_work_routine_t routine, void * arg)
+tpool_ret_t tpool_group_add_work(tpool_group_t * group, tpool_work_routine_t routine, void * arg)
 {
-  CHECK_PARAM(tpool != NULL);
+  CHECK_PARAM(group != NULL);
   CHECK_PARAM(routine != NULL);
 
-  work_t work =
+  group_work_t * work = tpool_record_alloc(group->tpool);
+
+  if (work == NULL) return TPOOL_EMEMALLOC;
+
+  work->group   = group;
+  work->routine = routine;
+  work->arg     = arg;
+
+  tpool_group_enter(group, 1);
+
+  tpool_ret_t ret = tpool_add_work(group->tpool, group_work_routine, work);
+
+  if (ret != TPOOL_SUCCESS)
   {
-    .routine = routine,
-    .arg     = arg,
+    tpool_record_free(group->tpool, work);
+    tpool_group_leave(group);
+  }
+
+  return ret;
+}
+
+static err_t group_wait(tpool_group_t * group)
+{
+  MUTEX_LOCK(&group->mutex);
+  {
+    while (atomic_load(&group->pending) > 0)
+    {
+      asserting_eok(pthread_cond_wait(&group->done_cv, &group->mutex));
+    }
+  }
+  MUTEX_UNLOCK(&group->mutex);
+
+  return E_OK;
+}
+
+typedef struct group_help_s
+{
+  worker_t      * worker;
+  tpool_group_t * group;
+} group_help_t;
+
+/**
+ * Probe for a worker parking while it waits for a group.
+ */
+static bool worker_should_help(void * context)
+{
+  group_help_t * help = context;
+
+  return atomic_load(&help->group->pending) == 0 || worker_can_steal(help->worker);
+}
+
+/**
+ * Runs works of the pool until the group is done, parks with the idle
+ * workers when there are none.
+ */
+static err_t worker_help_group(worker_t * worker, tpool_group_t * group)
+{
+  work_t work;
+
+  group_help_t help =
+  {
+    .worker = worker,
+    .group  = group,
   };
 
-  switch (work_queue_push(tpool->work_queue, &work))
+  while (atomic_load(&group->pending) > 0)
   {
-    case E_OK:     return TPOOL_SUCCESS;
-    case E_BADREQ: return TPOOL_EREQREJECTED;
+    err_t found = worker_find_work(worker, &work);
 
-    default: UNREACHABLE();
+    if (found == E_OK)
+    {
+      worker_run(worker, &work);
+      continue;
+    }
+
+    // the queue stopped, owners of the deques left run the rest
+    if (found == E_BADREQ) return group_wait(group);
+
+    atomic_fetch_add(&group->helpers, 1);
+
+    err_t err = work_queue_wait_for_work(worker->work_queue, worker_should_help, &help);
+
+    atomic_fetch_sub(&group->helpers, 1);
+
+    if (err != E_OK) return err;
+  }
+
+  // the last completer may still hold the mutex
+  MUTEX_LOCK(&group->mutex);
+  MUTEX_UNLOCK(&group->mutex);
+
+  return E_OK;
+}
+
+tpool_ret_t tpool_group_cancel(tpool_group_t * group)
+{
+  CHECK_PARAM(group != NULL);
+
+  atomic_store_explicit(&group->cancelled, true, memory_order_relaxed);
+
+  return TPOOL_SUCCESS;
+}
+
+tpool_ret_t tpool_group_wait(tpool_group_t * group)
+{
+  CHECK_PARAM(group != NULL);
+
+  worker_t * worker = current_worker;
+
+  err_t err = (worker != NULL && worker->tpool == group->tpool)
+            ? worker_help_group(worker, group)
+            : group_wait(group);
+
+  atomic_store_explicit(&group->cancelled, false, memory_order_relaxed);
+
+  return (tpool_ret_t) err;
+}
+
+static void worker_stats_read(worker_stats_t * worker_stats, tpool_worker_stats_t * stats)
+{
+  stats->idle_spun        = atomic_load_explicit(&worker_stats->idle_spun,        memory_order_relaxed);
+  stats->idle_yielded     = atomic_load_explicit(&worker_stats->idle_yielded,     memory_order_relaxed);
+  stats->idle_parked      = atomic_load_explicit(&worker_stats->idle_parked,      memory_order_relaxed);
+  stats->spurious_wakeups = atomic_load_explicit(&worker_stats->spurious_wakeups, memory_order_relaxed);
+  stats->executed         = atomic_load_explicit(&worker_stats->executed,         memory_order_relaxed);
+  stats->stolen           = atomic_load_explicit(&worker_stats->stolen,           memory_order_relaxed);
+  stats->running_ns       = atomic_load_explicit(&worker_stats->running_ns,       memory_order_relaxed);
+  stats->idle_ns          = atomic_load_explicit(&worker_stats->idle_ns,          memory_order_relaxed);
+  stats->parked_ns        = atomic_load_explicit(&worker_stats->parked_ns,        memory_order_relaxed);
+
+  for (size_t i = 0; i < TPOOL_HISTOGRAM_BUCKETS; i++)
+  {
+    stats->waited.buckets[i] = atomic_load_explicit(&worker_stats->waited[i], memory_order_relaxed);
+    stats->ran.buckets[i]    = atomic_load_explicit(&worker_stats->ran[i],    memory_order_relaxed);
+  }
+}
+
+tpool_ret_t tpool_get_stats(tpool_t * tpool, tpool_stats_t * stats)
+{
+  CHECK_PARAM(tpool != NULL);
+  CHECK_PARAM(stats != NULL);
+
+  memset(stats, 0, sizeof(tpool_stats_t));
+
+  for (size_t i = 0; i < tpool->workers_number; i++)
+  {
+    tpool_worker_stats_t worker_stats;
+
+    worker_stats_read(&tpool->workers[i].stats, &worker_stats);
+
+    stats->idle_spun        += worker_stats.idle_spun;
+    stats->idle_yielded     += worker_stats.idle_yielded;
+    stats->idle_parked      += worker_stats.idle_parked;
+    stats->spurious_wakeups += worker_stats.spurious_wakeups;
+    stats->executed         += worker_stats.executed;
+    stats->stolen           += worker_stats.stolen;
+    stats->running_ns       += worker_stats.running_ns;
+    stats->idle_ns          += worker_stats.idle_ns;
+    stats->parked_ns        += worker_stats.parked_ns;
+
+    for (size_t bucket = 0; bucket < TPOOL_HISTOGRAM_BUCKETS; bucket++)
+    {
+      stats->waited.buckets[bucket] += worker_stats.waited.buckets[bucket];
+      stats->ran.buckets[bucket]    += worker_stats.ran.buckets[bucket];
+    }
+  }
+
+  for (size_t i = 0; i < TPOOL_PRIORITIES_NUMBER; i++)
+  {
+    for (size_t node = 0; node < tpool->nodes_number; node++)
+    {
+      stats->queued[i] += work_queue_size_of(tpool->work_queues[node], i);
+    }
+  }
+
+  stats->threads_running = atomic_load_explicit(&tpool->workers_running, memory_order_relaxed);
+
+  return TPOOL_SUCCESS;
+}
+
+tpool_ret_t tpool_get_worker_stats(tpool_t * tpool, size_t worker, tpool_worker_stats_t * stats)
+{
+  CHECK_PARAM(tpool != NULL);
+  CHECK_PARAM(worker < tpool->workers_number);
+  CHECK_PARAM(stats != NULL);
+
+  worker_stats_read(&tpool->workers[worker].stats, stats);
+
+  return TPOOL_SUCCESS;
+}
+
+tpool_ret_t tpool_trace_dump(tpool_t * tpool, int fd)
+{
+  CHECK_PARAM(tpool != NULL);
+  CHECK_PARAM(fd >= 0);
+
+  if (tpool->tracer != NULL)
+  {
+    return (tpool_ret_t) tracer_dump(tpool->tracer, fd);
   }
+
+  // tracing is off, an empty one is written
+  tracer_t * tracer = tracer_create(0, 0);
+
+  if (tracer == NULL) return TPOOL_EMEMALLOC;
+
+  err_t err = tracer_dump(tracer, fd);
+
+  tracer_destroy(tracer);
+
+  return (tpool_ret_t) err;
 }
 
 tpool_ret_t tpool_shutdown(tpool_t * tpool)
 {
   CHECK_PARAM(tpool != NULL);
 
-  err_t err = work_queue_stop_accepting(tpool->work_queue);
+  err_t err = E_OK;
+
+  for (size_t i = 0; i < tpool->nodes_number; i++)
+  {
+    err_t node_err = work_queue_stop_accepting(tpool->work_queues[i]);
+
+    if (err == E_OK) err = node_err;
+  }
 
   return (tpool_ret_t) err;
 }
@@ -157,12 +1883,34 @@ tpool_ret_t tpool_join(tpool_t * tpool)
 
   bool sysfail = false;
 
-  for (size_t i = 0; i < tpool->threads_number; i++)
+  for (size_t i = 0; i < tpool->workers_number; i++)
   {
-    if (pthread_join(tpool->threads[i], NULL) != 0)
+    worker_t * worker = &tpool->workers[i];
+
+    bool started = false;
+
+    // claimed, so neither a retiring worker nor a growing pool touches it
+    asserting_eok(pthread_mutex_lock(&tpool->resize_mutex));
+    {
+      started = worker->state != WORKER_VACANT;
+
+      if (started) worker->state = WORKER_JOINING;
+    }
+    asserting_eok(pthread_mutex_unlock(&tpool->resize_mutex));
+
+    if (!started) continue;
+
+    if (pthread_join(worker->thread, NULL) != 0)
     {
       sysfail = true;
+      continue;
+    }
+
+    asserting_eok(pthread_mutex_lock(&tpool->resize_mutex));
+    {
+      worker->state = WORKER_VACANT;
     }
+    asserting_eok(pthread_mutex_unlock(&tpool->resize_mutex));
   }
 
   return sysfail ? TPOOL_ESYSFAIL : TPOOL_SUCCESS;
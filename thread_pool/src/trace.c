@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include "trace.h"
+
+#define CACHE_LINE_SIZE 64
+
+#define NS_PER_SECOND 1000000000
+
+/**
+ * Output is written in chunks this large.
+ */
+#define TRACE_BUFFER_SIZE 8192
+
+/**
+ * Longest line of a single event.
+ */
+#define TRACE_LINE_MAX_LENGTH 256
+
+/**
+ * `lap` is odd while the slot is being written, and `2 * index + 2`
+ * once the event of the ring's `index` is in place.
+ */
+typedef struct trace_slot_s
+{
+  atomic_size_t    lap;
+
+  _Atomic uint64_t time_ns;
+  atomic_uintptr_t routine;
+  atomic_uintptr_t arg;
+  atomic_uint      kind;
+} trace_slot_t;
+
+typedef struct trace_ring_s
+{
+  /* recorders of different rings write to different cache lines */
+  alignas(CACHE_LINE_SIZE) atomic_size_t next;
+
+  trace_slot_t * slots;
+} trace_ring_t;
+
+typedef struct trace_event_s
+{
+  uint64_t     time_ns;
+  uintptr_t    routine;
+  uintptr_t    arg;
+  trace_kind_t kind;
+} trace_event_t;
+
+struct tracer_s
+{
+  size_t       workers_number;
+  size_t       mask;
+  uint64_t     origin_ns; // events are dumped relative to it
+
+  trace_ring_t rings[]; // the shared one is the last
+};
+
+typedef struct trace_writer_s
+{
+  int    fd;
+  bool   failed;
+  size_t length;
+  char   buffer[TRACE_BUFFER_SIZE];
+} trace_writer_t;
+
+static uint64_t monotonic_ns(void)
+{
+  struct timespec now;
+
+  asserting_eok(clock_gettime(CLOCK_MONOTONIC, &now));
+
+  return (uint64_t) now.tv_sec * NS_PER_SECOND + (uint64_t) now.tv_nsec;
+}
+
+tracer_t * tracer_create(size_t workers_number, size_t capacity)
+{
+  tracer_t * tracer = NULL;
+
+  size_t slots_no = 2;
+
+  while (slots_no < capacity)
+  {
+    assert(slots_no << 1 != 0 && "capacity is too big");
+    slots_no <<= 1;
+  }
+
+  size_t rings_number = workers_number + 1;
+  size_t rings_created = 0;
+
+  TRY_NEW(1, tracer = aligned_alloc(alignof(tracer_t), sizeof(tracer_t) + sizeof(trace_ring_t) * rings_number));
+
+  for (; rings_created < rings_number; rings_created++)
+  {
+    trace_ring_t * ring = &tracer->rings[rings_created];
+
+    TRY_NEW(2, ring->slots = malloc(sizeof(trace_slot_t) * slots_no));
+
+    atomic_init(&ring->next, 0);
+
+    for (size_t i = 0; i < slots_no; i++)
+    {
+      atomic_init(&ring->slots[i].lap, 0);
+    }
+  }
+
+  tracer->workers_number = workers_number;
+  tracer->mask           = slots_no - 1;
+  tracer->origin_ns      = monotonic_ns();
+
+  return tracer;
+
+try_failure_2:
+  while (rings_created-- > 0)
+  {
+    free(tracer->rings[rings_created].slots);
+  }
+
+  free(tracer);
+try_failure_1: return NULL;
+}
+
+void tracer_destroy(tracer_t * tracer)
+{
+  if (tracer == NULL) return;
+
+  for (size_t i = 0; i <= tracer->workers_number; i++)
+  {
+    free(tracer->rings[i].slots);
+  }
+
+  free(tracer);
+}
+
+void tracer_record(tracer_t * tracer, size_t worker, trace_kind_t kind, uint64_t time_ns, const work_t * p_work)
+{
+  assert(tracer != NULL);
+  assert(worker < tracer->workers_number || worker == TRACE_SHARED);
+  assert(p_work != NULL);
+
+  trace_ring_t * ring  = NULL;
+  size_t         index = 0;
+
+  if (worker == TRACE_SHARED)
+  {
+    ring  = &tracer->rings[tracer->workers_number];
+    index = atomic_fetch_add_explicit(&ring->next, 1, memory_order_relaxed);
+  }
+  else
+  {
+    // the owner is the only writer, no read-modify-write is needed
+    ring  = &tracer->rings[worker];
+    index = atomic_load_explicit(&ring->next, memory_order_relaxed);
+
+    atomic_store_explicit(&ring->next, index + 1, memory_order_relaxed);
+  }
+
+  trace_slot_t * slot = &ring->slots[index & tracer->mask];
+
+  atomic_store_explicit(&slot->lap, 2 * index + 1, memory_order_relaxed);
+
+  // released, so none of them is seen before the slot turns odd
+  atomic_store_explicit(&slot->time_ns, time_ns,                     memory_order_release);
+  atomic_store_explicit(&slot->routine, (uintptr_t) p_work->routine, memory_order_release);
+  atomic_store_explicit(&slot->arg,     (uintptr_t) p_work->arg,     memory_order_release);
+  atomic_store_explicit(&slot->kind,    kind,                        memory_order_release);
+
+  atomic_store_explicit(&slot->lap, 2 * index + 2, memory_order_release);
+}
+
+/**
+ * Fails if the event of the index is not written yet, or was overwritten.
+ */
+static bool trace_slot_read(trace_slot_t * slot, size_t index, trace_event_t * event)
+{
+  size_t lap = 2 * index + 2;
+
+  if (atomic_load_explicit(&slot->lap, memory_order_acquire) != lap) return false;
+
+  // acquired, so the lap is checked again after all of them are read
+  event->time_ns = atomic_load_explicit(&slot->time_ns, memory_order_acquire);
+  event->routine = atomic_load_explicit(&slot->routine, memory_order_acquire);
+  event->arg     = atomic_load_explicit(&slot->arg,     memory_order_acquire);
+  event->kind    = atomic_load_explicit(&slot->kind,    memory_order_acquire);
+
+  return atomic_load_explicit(&slot->lap, memory_order_relaxed) == lap;
+}
+
+static void trace_writer_flush(trace_writer_t * writer)
+{
+  size_t written = 0;
+
+  while (!writer->failed && written < writer->length)
+  {
+    ssize_t ret = write(writer->fd, writer->buffer + written, writer->length - written);
+
+    if (ret >= 0)
+    {
+      written += (size_t) ret;
+    }
+    else if (errno != EINTR)
+    {
+      writer->failed = true;
+    }
+  }
+
+  writer->length = 0;
+}
+
+static void trace_writer_printf(trace_writer_t * writer, const char * format, ...)
+{
+  if (TRACE_BUFFER_SIZE - writer->length < TRACE_LINE_MAX_LENGTH)
+  {
+    trace_writer_flush(writer);
+  }
+
+  va_list args;
+
+  va_start(args, format);
+
+  int length = vsnprintf(writer->buffer + writer->length, TRACE_LINE_MAX_LENGTH, format, args);
+
+  va_end(args);
+
+  assert(length >= 0 && length < TRACE_LINE_MAX_LENGTH);
+
+  writer->length += (size_t) length;
+}
+
+static void trace_write_thread_name(trace_writer_t * writer, size_t tid, const char * name)
+{
+  trace_writer_printf(writer,
+                      ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,"
+                      "\"args\":{\"name\":\"%s\"}}",
+                      tid, name);
+}
+
+static void trace_write_event(trace_writer_t * writer, const tracer_t * tracer, size_t tid,
+                              const trace_event_t * event)
+{
+  static const char * phases[] =
+  {
+    [TRACE_SUBMIT] = "\"cat\":\"submit\",\"ph\":\"i\",\"s\":\"t\"",
+    [TRACE_START]  = "\"cat\":\"work\",\"ph\":\"B\"",
+    [TRACE_END]    = "\"cat\":\"work\",\"ph\":\"E\"",
+  };
+
+  // microseconds, to the nanosecond
+  uint64_t ns = event->time_ns > tracer->origin_ns ? event->time_ns - tracer->origin_ns : 0;
+
+  trace_writer_printf(writer,
+                      ",\n{\"name\":\"0x%" PRIxPTR "\",%s,\"ts\":%" PRIu64 ".%03" PRIu64 ",\"pid\":1,\"tid\":%zu,"
+                      "\"args\":{\"arg\":\"0x%" PRIxPTR "\"}}",
+                      event->routine, phases[event->kind], ns / 1000, ns % 1000, tid, event->arg);
+}
+
+err_t tracer_dump(tracer_t * tracer, int fd)
+{
+  assert(tracer != NULL);
+  assert(fd >= 0);
+
+  trace_writer_t * writer = malloc(sizeof(trace_writer_t));
+
+  if (writer == NULL) return E_MEMALLOC;
+
+  writer->fd     = fd;
+  writer->failed = false;
+  writer->length = 0;
+
+  trace_writer_printf(writer, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+                              "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"tpool\"}}");
+
+  size_t capacity = tracer->mask + 1;
+
+  for (size_t tid = 0; tid <= tracer->workers_number; tid++)
+  {
+    trace_ring_t * ring = &tracer->rings[tid];
+
+    char name[32] = "other threads";
+
+    if (tid < tracer->workers_number) snprintf(name, sizeof(name), "worker %zu", tid);
+
+    trace_write_thread_name(writer, tid, name);
+
+    size_t next  = atomic_load_explicit(&ring->next, memory_order_acquire);
+    size_t first = next > capacity ? next - capacity : 0;
+
+    for (size_t index = first; index < next; index++)
+    {
+      trace_event_t event;
+
+      if (trace_slot_read(&ring->slots[index & tracer->mask], index, &event))
+      {
+        trace_write_event(writer, tracer, tid, &event);
+      }
+    }
+  }
+
+  trace_writer_printf(writer, "\n]}\n");
+  trace_writer_flush(writer);
+
+  bool failed = writer->failed;
+
+  free(writer);
+
+  return failed ? E_SYSFAIL : E_OK;
+}
@@ -0,0 +1,59 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "internals/common.h"
+
+#include "work.h"
+
+typedef enum trace_kind_e
+{
+  TRACE_SUBMIT = 0,
+  TRACE_START,
+  TRACE_END,
+} trace_kind_t;
+
+/**
+ * Events of works kept in a ring per worker, plus one shared by threads
+ * that are not workers. When a ring is full, the oldest events in it
+ * are overwritten.
+ *
+ * Recording takes no locks: a worker's ring is written by the worker
+ * only, the shared one is claimed slot by slot with an atomic counter.
+ * Each slot carries the lap it was written in, so a dump running
+ * concurrently skips the events being overwritten.
+ */
+typedef struct tracer_s tracer_t;
+
+/**
+ * Records of the threads that are not workers.
+ */
+#define TRACE_SHARED SIZE_MAX
+
+/**
+ * `capacity` of every ring is rounded up to a power of two, at least 2.
+ */
+tracer_t * tracer_create(size_t workers_number, size_t capacity);
+
+void tracer_destroy(tracer_t * tracer);
+
+/**
+ * @param worker  The recording worker or TRACE_SHARED. Each worker's
+ *                events should be recorded by a single thread.
+ */
+void tracer_record(tracer_t * tracer, size_t worker, trace_kind_t kind, uint64_t time_ns, const work_t * p_work);
+
+/**
+ * Writes the events as Chrome trace JSON, which Perfetto opens too.
+ * Works run are duration events on their worker's track, submissions
+ * are instant events on the submitter's track.
+ *
+ * @retval E_OK       Written.
+ * @retval E_MEMALLOC Failed to allocate memory, nothing is written.
+ * @retval E_SYSFAIL  Writing failed, the output may be partial.
+ */
+err_t tracer_dump(tracer_t * tracer, int fd);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef WORK_H
+#define WORK_H
+
+#include "tpool.h"
+
+/* Works are passed through the public API as they are, with no conversion. */
+
+typedef tpool_work_routine_t work_routine_t;
+
+typedef tpool_work_t work_t;
+
+typedef tpool_priority_t work_priority_t;
+
+#define WORK_PRIORITY_HIGH    TPOOL_PRIORITY_HIGH
+#define WORK_PRIORITY_DEFAULT TPOOL_PRIORITY_NORMAL
+#define WORK_PRIORITIES       TPOOL_PRIORITIES_NUMBER
+
+#endif
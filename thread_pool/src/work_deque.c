@@ -0,0 +1,231 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+
+#include "work_deque.h"
+
+#define CACHE_LINE_SIZE 64
+
+#define WORK_DEQUE_INITIAL_CAPACITY 64
+
+/**
+ * Thieves may read a slot while the owner overwrites it (the read value
+ * is discarded then), so slots are accessed atomically.
+ */
+typedef struct work_slot_s
+{
+  _Atomic(work_routine_t)   routine;
+  _Atomic(void *)           arg;
+} work_slot_t;
+
+typedef struct work_array_s work_array_t;
+
+struct work_array_s
+{
+  size_t         mask;
+  work_array_t * previous; // replaced one, kept till destroy
+
+  work_slot_t    slots[];
+};
+
+struct work_deque_s
+{
+  alignas(CACHE_LINE_SIZE) atomic_size_t top;    // stolen from
+  alignas(CACHE_LINE_SIZE) atomic_size_t bottom; // pushed to and popped from
+
+  _Atomic(work_array_t *) array;
+};
+
+static work_array_t * work_array_create(size_t capacity, work_array_t * previous)
+{
+  work_array_t * array = malloc(sizeof(work_array_t) + capacity * sizeof(work_slot_t));
+
+  if (array != NULL)
+  {
+    array->mask     = capacity - 1;
+    array->previous = previous;
+  }
+
+  return array;
+}
+
+static void work_array_put(work_array_t * array, size_t index, const work_t * p_work)
+{
+  work_slot_t * slot = &array->slots[index & array->mask];
+
+  atomic_store_explicit(&slot->routine, p_work->routine, memory_order_relaxed);
+  atomic_store_explicit(&slot->arg,     p_work->arg,     memory_order_relaxed);
+}
+
+static void work_array_get(work_array_t * array, size_t index, work_t * p_work)
+{
+  work_slot_t * slot = &array->slots[index & array->mask];
+
+  p_work->routine = atomic_load_explicit(&slot->routine, memory_order_relaxed);
+  p_work->arg     = atomic_load_explicit(&slot->arg,     memory_order_relaxed);
+}
+
+work_deque_t * work_deque_create(void)
+{
+  work_deque_t * deque = NULL;
+  work_array_t * array = NULL;
+
+  TRY_NEW(1, deque = aligned_alloc(alignof(work_deque_t), sizeof(work_deque_t)));
+  TRY_NEW(2, array = work_array_create(WORK_DEQUE_INITIAL_CAPACITY, NULL));
+
+  atomic_init(&deque->top,    0);
+  atomic_init(&deque->bottom, 0);
+  atomic_init(&deque->array,  array);
+
+  return deque;
+
+try_failure_2: free(deque);
+try_failure_1: return NULL;
+}
+
+void work_deque_destroy(work_deque_t * deque)
+{
+  if (deque == NULL) return;
+
+  work_array_t * array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+  while (array != NULL)
+  {
+    work_array_t * previous = array->previous;
+
+    free(array);
+    array = previous;
+  }
+
+  free(deque);
+}
+
+static work_array_t * work_deque_grow(work_deque_t * deque, work_array_t * array, size_t top, size_t bottom)
+{
+  size_t capacity = (array->mask + 1) * 2;
+
+  work_array_t * grown = work_array_create(capacity, array);
+
+  if (grown == NULL) return NULL;
+
+  for (size_t i = top; i != bottom; i++)
+  {
+    work_t work;
+
+    work_array_get(array, i, &work);
+    work_array_put(grown, i, &work);
+  }
+
+  atomic_store_explicit(&deque->array, grown, memory_order_release);
+
+  return grown;
+}
+
+err_t work_deque_push(work_deque_t * deque, const work_t * p_work)
+{
+  assert(deque  != NULL);
+  assert(p_work != NULL);
+
+  size_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+  size_t top    = atomic_load_explicit(&deque->top,    memory_order_acquire);
+
+  work_array_t * array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+  if (bottom - top > array->mask)
+  {
+    TRUE_OR_RETURN(array = work_deque_grow(deque, array, top, bottom), E_MEMALLOC);
+  }
+
+  work_array_put(array, bottom, p_work);
+
+  atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+
+  return E_OK;
+}
+
+err_t work_deque_pop(work_deque_t * deque, work_t * p_work)
+{
+  assert(deque  != NULL);
+  assert(p_work != NULL);
+
+  size_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+  size_t top    = atomic_load_explicit(&deque->top,    memory_order_relaxed);
+
+  if (bottom == top) return E_UNDERFLOW; // fast path, no thief can make it non-empty
+
+  bottom--;
+
+  work_array_t * array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+  atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+
+  top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+  err_t err = E_OK;
+
+  if ((intptr_t) (bottom - top) < 0)
+  {
+    // a thief took the last one
+    err = E_UNDERFLOW;
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+  }
+  else
+  {
+    work_array_get(array, bottom, p_work);
+
+    if (bottom == top)
+    {
+      // the last one, race against thieves for it
+      if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                   memory_order_seq_cst, memory_order_relaxed))
+      {
+        err = E_UNDERFLOW;
+      }
+
+      atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+  }
+
+  return err;
+}
+
+err_t work_deque_steal(work_deque_t * deque, work_t * p_work)
+{
+  assert(deque  != NULL);
+  assert(p_work != NULL);
+
+  while (true)
+  {
+    size_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+
+    atomic_thread_fence(memory_order_seq_cst);
+
+    size_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+    if ((intptr_t) (bottom - top) <= 0) return E_UNDERFLOW;
+
+    work_array_t * array = atomic_load_explicit(&deque->array, memory_order_acquire);
+
+    work_array_get(array, top, p_work);
+
+    if (atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                memory_order_seq_cst, memory_order_relaxed))
+    {
+      return E_OK;
+    }
+
+    // lost the race to another thief or to the owner, look again
+  }
+}
+
+bool work_deque_is_empty(work_deque_t * deque)
+{
+  assert(deque != NULL);
+
+  size_t top    = atomic_load(&deque->top);
+  size_t bottom = atomic_load(&deque->bottom);
+
+  return (intptr_t) (bottom - top) <= 0;
+}
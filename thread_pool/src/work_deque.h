@@ -0,0 +1,52 @@
+#ifndef WORK_DEQUE_H
+#define WORK_DEQUE_H
+
+#include <stdbool.h>
+
+#include "internals/common.h"
+
+#include "work.h"
+
+/**
+ * Chase-Lev work-stealing deque of works.
+ *
+ * Only the owner thread pushes and pops (LIFO end), any thread may
+ * steal (FIFO end). The deque grows on demand, replaced arrays are kept
+ * till it is destroyed, since thieves may still be reading them.
+ */
+typedef struct work_deque_s work_deque_t;
+
+work_deque_t * work_deque_create(void);
+
+void work_deque_destroy(work_deque_t * deque);
+
+/**
+ * Owner only.
+ *
+ * @retval E_OK        Work is pushed.
+ * @retval E_MEMALLOC  Failed to grow.
+ */
+err_t work_deque_push(work_deque_t * deque, const work_t * p_work);
+
+/**
+ * Owner only, pops the most recently pushed work.
+ *
+ * @retval E_OK        Work is popped.
+ * @retval E_UNDERFLOW Deque is empty.
+ */
+err_t work_deque_pop(work_deque_t * deque, work_t * p_work);
+
+/**
+ * Steals the least recently pushed work.
+ *
+ * @retval E_OK        Work is stolen.
+ * @retval E_UNDERFLOW Deque is empty.
+ */
+err_t work_deque_steal(work_deque_t * deque, work_t * p_work);
+
+/**
+ * The result may be outdated as soon as it is returned.
+ */
+bool work_deque_is_empty(work_deque_t * deque);
+
+#endif
@@ -1,160 +1,645 @@
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <assert.h>
 
 #include "fifo/fifo.h"
 
+#include "parking.h"
+#include "work_ring.h"
 #include "work_queue.h"
 
+typedef enum work_queue_kind_e
+{
+  WORK_QUEUE_LOCKED,
+  WORK_QUEUE_LOCKFREE,
+} work_queue_kind_t;
+
+/**
+ * Every priority has its own storage, indexed by the priority.
+ *
+ * WORK_QUEUE_LOCKED keeps works in `fifos` guarded by `mutex`.
+ * If `capacity` is not 0, it holds no more than that many works of all
+ * priorities, pushers wait on `room` while it is full.
+ *
+ * WORK_QUEUE_LOCKFREE keeps works in `rings`.
+ * `pushers` counts pushes in flight, so the queue is not reported as
+ * drained (E_BADREQ) while a push started before `stopped_accepting`
+ * is yet to land.
+ *
+ * Threads waiting for works sleep in `parking`, pushing `n` works
+ * wakes up at most `n` of them.
+ */
 struct work_queue_s
 {
-  fifo_t * fifo;
+  work_queue_kind_t kind;
+
+  fifo_t      * fifos[WORK_PRIORITIES];
+  work_ring_t * rings[WORK_PRIORITIES];
+
+  atomic_size_t lengths[WORK_PRIORITIES]; // of `fifos`, written under `mutex`
 
   pthread_mutex_t mutex;
-  pthread_cond_t  no_work_cv;
 
-  bool stopped_accepting;
+  size_t         capacity;
+  size_t         depth;        // of all `fifos`, written under `mutex`
+  pthread_cond_t room;
+  size_t         room_waiters;
+
+  size_t        aging;
+  atomic_size_t pops;
+
+  parking_t * parking;
+
+  atomic_bool   stopped_accepting;
+  atomic_size_t pushers;
 };
 
+typedef struct wait_context_s
+{
+  work_queue_t       * work_queue;
+
+  work_queue_probe_t   has_work_elsewhere;
+  void               * context;
+} wait_context_t;
+
+/**
+ * Number of works stored in one segment of the underlying fifo.
+ */
+#define WORK_QUEUE_SEGMENT_CAPACITY 64
+
+#define CACHE_LINE_SIZE 64
+
 #define WORK_QUEUE_LOCK(queue)   MUTEX_LOCK(&queue->mutex)
 #define WORK_QUEUE_UNLOCK(queue) MUTEX_UNLOCK(&queue->mutex)
 
-work_queue_t * work_queue_create(void)
+/**
+ * Segments take whole cache lines, so pushers filling the tail segment
+ * share no line with data around it in the heap.
+ */
+static void * work_queue_segment_alloc(size_t size, void * context)
+{
+  (void) context;
+
+  return aligned_alloc(CACHE_LINE_SIZE, (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE);
+}
+
+static void work_queue_segment_free(void * memory, size_t size, void * context)
+{
+  (void) size;
+  (void) context;
+
+  free(memory);
+}
+
+static void work_queue_destroy_storage(work_queue_t * work_queue)
+{
+  for (size_t i = 0; i < WORK_PRIORITIES; i++)
+  {
+    if (work_queue->fifos[i] != NULL)
+    {
+      asserting_eok(fifo_destroy(work_queue->fifos[i]));
+    }
+
+    work_ring_destroy(work_queue->rings[i]);
+  }
+}
+
+static work_queue_t * work_queue_create_of_kind(work_queue_kind_t kind, size_t capacity)
 {
   work_queue_t * work_queue = NULL;
 
   TRY_NEW(1, work_queue = malloc(sizeof(work_queue_t)));
-  TRY_EOK(2, fifo_create_for_object_size(&work_queue->fifo, sizeof(work_t)));
-  TRY_EOK(3, pthread_mutex_init(&work_queue->mutex, NULL));
-  TRY_EOK(4, pthread_cond_init(&work_queue->no_work_cv, NULL));
 
-  work_queue->stopped_accepting = false;
+  work_queue->kind = kind;
+
+  for (size_t i = 0; i < WORK_PRIORITIES; i++)
+  {
+    work_queue->fifos[i] = NULL;
+    work_queue->rings[i] = NULL;
+
+    atomic_init(&work_queue->lengths[i], 0);
+  }
+
+  fifo_config_t fifo_config;
+
+  fifo_config_init(&fifo_config, sizeof(work_t));
+
+  fifo_config.segment_capacity = WORK_QUEUE_SEGMENT_CAPACITY;
+
+  fifo_config.allocator.alloc = work_queue_segment_alloc;
+  fifo_config.allocator.free  = work_queue_segment_free;
+
+  for (size_t i = 0; i < WORK_PRIORITIES; i++)
+  {
+    if (kind == WORK_QUEUE_LOCKED)
+    {
+      TRY_EOK(2, fifo_create(&work_queue->fifos[i], &fifo_config));
+    }
+    else
+    {
+      TRY_NEW(2, work_queue->rings[i] = work_ring_create(capacity));
+    }
+  }
+
+  work_queue->capacity     = kind == WORK_QUEUE_LOCKED ? capacity : 0;
+  work_queue->depth        = 0;
+  work_queue->room_waiters = 0;
+
+  TRY_EOK(2, pthread_mutex_init(&work_queue->mutex, NULL));
+  TRY_EOK(3, pthread_cond_init(&work_queue->room, NULL));
+  TRY_NEW(4, work_queue->parking = parking_create());
+
+  work_queue->aging = 0;
+  atomic_init(&work_queue->pops, 0);
+
+  atomic_init(&work_queue->stopped_accepting, false);
+  atomic_init(&work_queue->pushers, 0);
 
   return work_queue;
 
-try_failure_4: pthread_mutex_destroy(&work_queue->mutex);
-try_failure_3: fifo_destroy(work_queue->fifo);
-try_failure_2: free(work_queue);
+try_failure_4: pthread_cond_destroy(&work_queue->room);
+try_failure_3: pthread_mutex_destroy(&work_queue->mutex);
+try_failure_2: work_queue_destroy_storage(work_queue);
+               free(work_queue);
 try_failure_1: return NULL;
 }
 
+work_queue_t * work_queue_create(void)
+{
+  return work_queue_create_of_kind(WORK_QUEUE_LOCKED, 0);
+}
+
+work_queue_t * work_queue_create_bounded(size_t capacity)
+{
+  assert(capacity > 0);
+
+  return work_queue_create_of_kind(WORK_QUEUE_LOCKED, capacity);
+}
+
+work_queue_t * work_queue_create_lockfree(size_t capacity)
+{
+  assert(capacity > 0);
+
+  return work_queue_create_of_kind(WORK_QUEUE_LOCKFREE, capacity);
+}
+
 void work_queue_destroy(work_queue_t * work_queue)
 {
   if (work_queue == NULL) return;
 
-  asserting_eok(fifo_destroy(work_queue->fifo));
-  
+  work_queue_destroy_storage(work_queue);
+  parking_destroy(work_queue->parking);
+
+  asserting_eok(pthread_cond_destroy(&work_queue->room));
   asserting_eok(pthread_mutex_destroy(&work_queue->mutex));
-  asserting_eok(pthread_cond_destroy(&work_queue->no_work_cv));
 
   free(work_queue);
 }
 
-err_t work_queue_wait_while_no_work(work_queue_t * work_queue)
+void work_queue_set_aging(work_queue_t * work_queue, size_t aging)
 {
   assert(work_queue != NULL);
 
-  WORK_QUEUE_LOCK(work_queue);
+  work_queue->aging = aging;
+}
+
+static bool work_queue_is_empty_of(work_queue_t * work_queue, work_priority_t priority)
+{
+  switch (work_queue->kind)
   {
-    while (fifo_is_empty(work_queue->fifo) && !work_queue->stopped_accepting)
-    {
-      asserting_eok(pthread_cond_wait(&work_queue->no_work_cv, &work_queue->mutex));
-    }
+    case WORK_QUEUE_LOCKED:   return atomic_load(&work_queue->lengths[priority]) == 0;
+    case WORK_QUEUE_LOCKFREE: return work_ring_is_empty(work_queue->rings[priority]);
   }
-  WORK_QUEUE_UNLOCK(work_queue);
 
-  return E_OK;
+  UNREACHABLE();
 }
 
-err_t work_queue_push(work_queue_t * work_queue, const work_t * p_work)
+static bool work_queue_is_empty(work_queue_t * work_queue)
+{
+  for (size_t i = 0; i < WORK_PRIORITIES; i++)
+  {
+    if (!work_queue_is_empty_of(work_queue, i)) return false;
+  }
+
+  return true;
+}
+
+static bool work_queue_should_park(void * context)
+{
+  wait_context_t * wait = context;
+
+  if (!work_queue_is_empty(wait->work_queue))            return false;
+  if (atomic_load(&wait->work_queue->stopped_accepting)) return false;
+
+  if (wait->has_work_elsewhere != NULL && wait->has_work_elsewhere(wait->context)) return false;
+
+  return true;
+}
+
+err_t work_queue_wait_for_work(work_queue_t * work_queue, work_queue_probe_t has_work_elsewhere, void * context)
+{
+  return work_queue_wait_for_work_until(work_queue, has_work_elsewhere, context, NULL);
+}
+
+err_t work_queue_wait_for_work_until(work_queue_t * work_queue, work_queue_probe_t has_work_elsewhere, void * context,
+                                     const struct timespec * deadline)
 {
   assert(work_queue != NULL);
-  assert(p_work     != NULL);
 
-  err_t ret = E_OK;
+  wait_context_t wait =
+  {
+    .work_queue         = work_queue,
+    .has_work_elsewhere = has_work_elsewhere,
+    .context            = context,
+  };
 
-  WORK_QUEUE_LOCK(work_queue);
+  return parking_park_until(work_queue->parking, work_queue_should_park, &wait, deadline);
+}
+
+err_t work_queue_wait_for_work_timeout(work_queue_t * work_queue, work_queue_probe_t has_work_elsewhere,
+                                       void * context, const struct timespec * deadline)
+{
+  assert(work_queue != NULL);
+
+  wait_context_t wait =
+  {
+    .work_queue         = work_queue,
+    .has_work_elsewhere = has_work_elsewhere,
+    .context            = context,
+  };
+
+  return parking_park_timeout(work_queue->parking, work_queue_should_park, &wait, deadline);
+}
+
+err_t work_queue_wait_while_no_work(work_queue_t * work_queue)
+{
+  return work_queue_wait_for_work(work_queue, NULL, NULL);
+}
 
-  bool should_wakeup = fifo_is_empty(work_queue->fifo);
+static bool work_queue_is_full(work_queue_t * work_queue)
+{
+  return work_queue->capacity > 0 && work_queue->depth == work_queue->capacity;
+}
 
-  if (work_queue->stopped_accepting)
+/**
+ * Waits with the lock held till the bounded queue has room. Works pushed
+ * by the caller so far are handed to parked threads first, as the room
+ * may never appear otherwise.
+ *
+ * @param[in,out] p_published  Works counted in `lengths` and unparked for.
+ */
+static err_t work_queue_wait_for_room(work_queue_t * work_queue, work_priority_t priority,
+                                      size_t pushed, size_t * p_published)
+{
+  if (pushed > *p_published)
   {
-    ret = E_BADREQ;
-    goto finish;
+    // pairs with the parker's check in `work_queue_should_park()`
+    atomic_fetch_add(&work_queue->lengths[priority], pushed - *p_published);
+
+    err_t err = parking_unpark(work_queue->parking, pushed - *p_published);
+
+    *p_published = pushed;
+
+    return err;
   }
 
-  if (fifo_enqueue(work_queue->fifo, p_work) != FIFO_SUCCESS)
+  work_queue->room_waiters++;
   {
-    ret = E_MEMALLOC;
-    goto finish;
+    asserting_eok(pthread_cond_wait(&work_queue->room, &work_queue->mutex));
   }
+  work_queue->room_waiters--;
+
+  return E_OK;
+}
 
-  if (should_wakeup) 
+/**
+ * @param[in]  block        Whether to wait for room in the full bounded queue.
+ * @param[out] p_published  Works already unparked for.
+ */
+static err_t work_queue_locked_push_n(work_queue_t * work_queue, work_priority_t priority, bool block,
+                                      const work_t * works, size_t n, size_t * p_pushed, size_t * p_published)
+{
+  fifo_t * fifo = work_queue->fifos[priority];
+
+  err_t  ret       = E_OK;
+  size_t pushed    = 0;
+  size_t published = 0;
+
+  WORK_QUEUE_LOCK(work_queue);
   {
-    if (pthread_cond_broadcast(&work_queue->no_work_cv) != 0)
+    while (ret == E_OK && pushed < n)
     {
-      ret = E_SYSFAIL;
-      goto finish;
+      if (atomic_load_explicit(&work_queue->stopped_accepting, memory_order_relaxed))
+      {
+        ret = E_BADREQ;
+      }
+      else if (work_queue_is_full(work_queue))
+      {
+        ret = block ? work_queue_wait_for_room(work_queue, priority, pushed, &published) : E_OVERFLOW;
+      }
+      else if (fifo_enqueue(fifo, works + pushed) != FIFO_SUCCESS)
+      {
+        ret = E_MEMALLOC;
+      }
+      else
+      {
+        work_queue->depth++;
+        pushed++;
+      }
     }
+
+    // pairs with the parker's check in `work_queue_should_park()`
+    atomic_fetch_add(&work_queue->lengths[priority], pushed - published);
   }
+  WORK_QUEUE_UNLOCK(work_queue);
 
-  assert(ret == E_OK);
+  *p_pushed    = pushed;
+  *p_published = published;
 
-finish:
-  WORK_QUEUE_UNLOCK(work_queue);
+  return ret;
+}
+
+static err_t work_queue_lockfree_push_n(work_queue_t * work_queue, work_priority_t priority,
+                                        const work_t * works, size_t n, size_t * p_pushed)
+{
+  work_ring_t * ring = work_queue->rings[priority];
+
+  err_t  ret    = E_OK;
+  size_t pushed = 0;
+
+  atomic_fetch_add(&work_queue->pushers, 1);
+  {
+    if (atomic_load(&work_queue->stopped_accepting))
+    {
+      ret = E_BADREQ;
+    }
+
+    for (; ret == E_OK && pushed < n; pushed++)
+    {
+      if ((ret = work_ring_push(ring, works + pushed)) != E_OK) break;
+    }
+  }
+  atomic_fetch_sub(&work_queue->pushers, 1);
+
+  *p_pushed = pushed;
 
   return ret;
 }
 
-err_t work_queue_pop(work_queue_t * work_queue, work_t * p_work)
+static err_t work_queue_push_n_with(work_queue_t * work_queue, work_priority_t priority, bool block,
+                                    const work_t * works, size_t n, size_t * p_pushed)
 {
   assert(work_queue != NULL);
-  assert(p_work     != NULL);
+  assert(priority   <  WORK_PRIORITIES);
+  assert(works      != NULL || n == 0);
+  assert(p_pushed   != NULL);
+
+  err_t  ret       = E_OK;
+  size_t published = 0;
+
+  switch (work_queue->kind)
+  {
+    case WORK_QUEUE_LOCKED:
+      ret = work_queue_locked_push_n(work_queue, priority, block, works, n, p_pushed, &published);
+      break;
 
-  err_t err = E_OK;
+    case WORK_QUEUE_LOCKFREE:
+      ret = work_queue_lockfree_push_n(work_queue, priority, works, n, p_pushed);
+      break;
+  }
+
+  // one thread per pushed work, the works are already visible to them
+  err_t err = parking_unpark(work_queue->parking, *p_pushed - published);
+
+  return ret == E_OK ? err : ret;
+}
+
+err_t work_queue_push_n_prio(work_queue_t * work_queue, work_priority_t priority,
+                             const work_t * works, size_t n, size_t * p_pushed)
+{
+  return work_queue_push_n_with(work_queue, priority, true, works, n, p_pushed);
+}
+
+err_t work_queue_try_push_n_prio(work_queue_t * work_queue, work_priority_t priority,
+                                 const work_t * works, size_t n, size_t * p_pushed)
+{
+  return work_queue_push_n_with(work_queue, priority, false, works, n, p_pushed);
+}
+
+err_t work_queue_push_n(work_queue_t * work_queue, const work_t * works, size_t n, size_t * p_pushed)
+{
+  return work_queue_push_n_prio(work_queue, WORK_PRIORITY_DEFAULT, works, n, p_pushed);
+}
+
+err_t work_queue_push(work_queue_t * work_queue, const work_t * p_work)
+{
+  assert(p_work != NULL);
+
+  size_t pushed = 0;
+
+  return work_queue_push_n(work_queue, p_work, 1, &pushed);
+}
+
+err_t work_queue_try_push(work_queue_t * work_queue, const work_t * p_work)
+{
+  assert(p_work != NULL);
+
+  size_t pushed = 0;
+
+  return work_queue_try_push_n_prio(work_queue, WORK_PRIORITY_DEFAULT, p_work, 1, &pushed);
+}
+
+/**
+ * Priorities in the order they are served by the next pop.
+ */
+static void work_queue_pop_order(work_queue_t * work_queue, work_priority_t order[WORK_PRIORITIES])
+{
+  bool aged = false;
+
+  if (work_queue->aging > 0)
+  {
+    size_t pops = atomic_fetch_add_explicit(&work_queue->pops, 1, memory_order_relaxed) + 1;
+
+    aged = pops % work_queue->aging == 0;
+  }
+
+  for (size_t i = 0; i < WORK_PRIORITIES; i++)
+  {
+    order[i] = aged ? WORK_PRIORITIES - 1 - i : i;
+  }
+}
+
+static err_t work_queue_locked_pop_n(work_queue_t * work_queue, work_t * works, size_t n, size_t * p_popped)
+{
+  err_t  err    = E_OK;
+  size_t popped = 0;
+
+  work_priority_t order[WORK_PRIORITIES];
+
+  work_queue_pop_order(work_queue, order);
 
   WORK_QUEUE_LOCK(work_queue);
   {
-    bool is_empty = fifo_is_empty(work_queue->fifo);
-    
-    if (is_empty && work_queue->stopped_accepting)
+    for (size_t i = 0; i < WORK_PRIORITIES && popped < n; i++)
     {
-      err = E_BADREQ;
+      fifo_t * fifo  = work_queue->fifos[order[i]];
+      size_t   first = popped;
+
+      for (; popped < n && !fifo_is_empty(fifo); popped++)
+      {
+        asserting_eok(fifo_dequeue(fifo, works + popped));
+      }
+
+      atomic_fetch_sub_explicit(&work_queue->lengths[order[i]], popped - first, memory_order_relaxed);
     }
-    else if (is_empty)
+
+    work_queue->depth -= popped;
+
+    // a pusher per popped work
+    for (size_t i = 0; i < popped && i < work_queue->room_waiters; i++)
     {
-      err = E_UNDERFLOW;
+      asserting_eok(pthread_cond_signal(&work_queue->room));
     }
-    else
+
+    if (popped == 0)
     {
-      asserting_eok(fifo_dequeue(work_queue->fifo, p_work));
+      bool stopped = atomic_load_explicit(&work_queue->stopped_accepting, memory_order_relaxed);
+
+      err = stopped ? E_BADREQ : E_UNDERFLOW;
     }
   }
   WORK_QUEUE_UNLOCK(work_queue);
 
+  *p_popped = popped;
+
   return err;
 }
 
+static err_t work_queue_lockfree_pop_n(work_queue_t * work_queue, work_t * works, size_t n, size_t * p_popped)
+{
+  // The order matters: once no pushes are in flight after the queue
+  // stopped accepting, nothing can be pushed anymore, so the ring
+  // being empty afterwards means it is drained for good.
+  bool stopped   = atomic_load(&work_queue->stopped_accepting);
+  bool no_pushes = atomic_load(&work_queue->pushers) == 0;
+
+  size_t popped = 0;
+
+  work_priority_t order[WORK_PRIORITIES];
+
+  work_queue_pop_order(work_queue, order);
+
+  for (size_t i = 0; i < WORK_PRIORITIES && popped < n; i++)
+  {
+    work_ring_t * ring = work_queue->rings[order[i]];
+
+    while (popped < n && work_ring_pop(ring, works + popped) == E_OK)
+    {
+      popped++;
+    }
+  }
+
+  *p_popped = popped;
+
+  if (popped > 0) return E_OK;
+
+  return (stopped && no_pushes) ? E_BADREQ : E_UNDERFLOW;
+}
+
+err_t work_queue_pop_n(work_queue_t * work_queue, work_t * works, size_t n, size_t * p_popped)
+{
+  assert(work_queue != NULL);
+  assert(works      != NULL);
+  assert(n          >  0);
+  assert(p_popped   != NULL);
+
+  switch (work_queue->kind)
+  {
+    case WORK_QUEUE_LOCKED:   return work_queue_locked_pop_n(work_queue, works, n, p_popped);
+    case WORK_QUEUE_LOCKFREE: return work_queue_lockfree_pop_n(work_queue, works, n, p_popped);
+  }
+
+  UNREACHABLE();
+}
+
+err_t work_queue_pop(work_queue_t * work_queue, work_t * p_work)
+{
+  size_t popped = 0;
+
+  return work_queue_pop_n(work_queue, p_work, 1, &popped);
+}
+
+size_t work_queue_size_of(work_queue_t * work_queue, work_priority_t priority)
+{
+  assert(work_queue != NULL);
+  assert(priority   <  WORK_PRIORITIES);
+
+  switch (work_queue->kind)
+  {
+    case WORK_QUEUE_LOCKED:   return atomic_load_explicit(&work_queue->lengths[priority], memory_order_relaxed);
+    case WORK_QUEUE_LOCKFREE: return work_ring_size(work_queue->rings[priority]);
+  }
+
+  UNREACHABLE();
+}
+
+size_t work_queue_size(work_queue_t * work_queue)
+{
+  size_t size = 0;
+
+  for (size_t i = 0; i < WORK_PRIORITIES; i++)
+  {
+    size += work_queue_size_of(work_queue, i);
+  }
+
+  return size;
+}
+
+err_t work_queue_kick(work_queue_t * work_queue, size_t n)
+{
+  assert(work_queue != NULL);
+
+  // Works elsewhere may be published with a release store only, which
+  // could otherwise be reordered after the check for waiters.
+  atomic_thread_fence(memory_order_seq_cst);
+
+  return parking_unpark(work_queue->parking, n);
+}
+
+err_t work_queue_kick_timed(work_queue_t * work_queue)
+{
+  assert(work_queue != NULL);
+
+  return parking_unpark_timed(work_queue->parking);
+}
+
+bool work_queue_is_stopped(work_queue_t * work_queue)
+{
+  assert(work_queue != NULL);
+
+  return atomic_load(&work_queue->stopped_accepting);
+}
+
 err_t work_queue_stop_accepting(work_queue_t * work_queue)
 {
   assert(work_queue != NULL);
-  err_t err = E_OK;
 
-  WORK_QUEUE_LOCK(work_queue);
+  // pairs with the parker's check in `work_queue_should_park()`
+  bool was_stopped = atomic_exchange(&work_queue->stopped_accepting, true);
+
+  if (was_stopped) return E_OK;
+
+  if (work_queue->capacity > 0)
   {
-    if (!work_queue->stopped_accepting)
+    // pushers waiting for room give up
+    WORK_QUEUE_LOCK(work_queue);
     {
-      work_queue->stopped_accepting = true;
-
-      if (pthread_cond_broadcast(&work_queue->no_work_cv) != 0)
-      {
-        err = E_SYSFAIL;
-      }
+      asserting_eok(pthread_cond_broadcast(&work_queue->room));
     }
+    WORK_QUEUE_UNLOCK(work_queue);
   }
-  WORK_QUEUE_UNLOCK(work_queue);
 
-  return err;
+  return parking_unpark_all(work_queue->parking);
 }
-
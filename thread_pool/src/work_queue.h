@@ -3,28 +3,139 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <time.h>
 
 #include "internals/common.h"
 
-typedef void (* work_routine_t)(void * arg);
-
-typedef struct work_s
-{
-  work_routine_t   routine;
-  void           * arg;
-} work_t;
+#include "work.h"
 
 typedef struct work_queue_s work_queue_t;
 
 work_queue_t * work_queue_create(void);
 
+/**
+ * Creates a work queue holding at most `capacity` works of all priorities.
+ *
+ * Pushing to the full queue blocks till works are popped, or fails with
+ * E_BADREQ once the queue stops accepting.
+ */
+work_queue_t * work_queue_create_bounded(size_t capacity);
+
+/**
+ * Creates a work queue backed by a lock-free bounded ring.
+ *
+ * Pushing to the full queue fails with E_OVERFLOW.
+ */
+work_queue_t * work_queue_create_lockfree(size_t capacity);
+
 void work_queue_destroy(work_queue_t * work_queue);
 
 err_t work_queue_push(work_queue_t * work_queue, const work_t * p_work);
+
+/**
+ * Same as `work_queue_push()`, but fails with E_OVERFLOW instead of
+ * blocking while the bounded queue is full.
+ */
+err_t work_queue_try_push(work_queue_t * work_queue, const work_t * p_work);
 err_t work_queue_pop(work_queue_t * work_queue, work_t * p_work);
 
+/**
+ * Every `aging`-th pop serves lower priorities first, 0 disables it.
+ * Should be set before the queue is shared.
+ */
+void work_queue_set_aging(work_queue_t * work_queue, size_t aging);
+
+/**
+ * Pushes works at WORK_PRIORITY_DEFAULT.
+ */
+err_t work_queue_push_n(work_queue_t * work_queue, const work_t * works, size_t n, size_t * p_pushed);
+
+/**
+ * Pushes works in order under one lock, wakes up at most `n` waiters.
+ *
+ * On failure, `*p_pushed` tells how many leading works are pushed.
+ */
+err_t work_queue_push_n_prio(work_queue_t * work_queue, work_priority_t priority,
+                             const work_t * works, size_t n, size_t * p_pushed);
+
+/**
+ * Same as `work_queue_push_n_prio()`, but fails with E_OVERFLOW instead of
+ * blocking while the bounded queue is full.
+ */
+err_t work_queue_try_push_n_prio(work_queue_t * work_queue, work_priority_t priority,
+                                 const work_t * works, size_t n, size_t * p_pushed);
+
+/**
+ * Pops up to `n` works under one lock, higher priorities first,
+ * each priority in order.
+ *
+ * Succeeds if at least one work is popped, `*p_popped` tells how many.
+ */
+err_t work_queue_pop_n(work_queue_t * work_queue, work_t * works, size_t n, size_t * p_popped);
+
+/**
+ * Number of works in the queue, may be outdated as soon as it is returned.
+ */
+size_t work_queue_size(work_queue_t * work_queue);
+
+/**
+ * Number of works of the priority, may be outdated as soon as it is returned.
+ */
+size_t work_queue_size_of(work_queue_t * work_queue, work_priority_t priority);
+
+/**
+ * Tells whether there are works the waiter could take outside of the queue.
+ */
+typedef bool (* work_queue_probe_t)(void * context);
+
+/**
+ * Blocks while the queue is empty and accepts works.
+ *
+ * Every waiting thread sleeps on its own, pushing `n` works wakes up
+ * no more than `n` of them.
+ */
 err_t work_queue_wait_while_no_work(work_queue_t * work_queue);
+
+/**
+ * Same as `work_queue_wait_while_no_work()`, but also does not block
+ * while `has_work_elsewhere(context)` is true. The probe is called after
+ * the thread announced itself as a waiter, so works that appear elsewhere
+ * before `work_queue_kick()` is called are never missed.
+ */
+err_t work_queue_wait_for_work(work_queue_t * work_queue, work_queue_probe_t has_work_elsewhere, void * context);
+
+/**
+ * Same as `work_queue_wait_for_work()`, but blocks no longer than until
+ * `deadline` (CLOCK_REALTIME). Only such a waiter is woken up by
+ * `work_queue_kick_timed()`.
+ */
+err_t work_queue_wait_for_work_until(work_queue_t * work_queue, work_queue_probe_t has_work_elsewhere, void * context,
+                                     const struct timespec * deadline);
+
+/**
+ * Same as `work_queue_wait_for_work_until()`, but the waiter is not
+ * the one `work_queue_kick_timed()` wakes up.
+ */
+err_t work_queue_wait_for_work_timeout(work_queue_t * work_queue, work_queue_probe_t has_work_elsewhere,
+                                       void * context, const struct timespec * deadline);
+
 err_t work_queue_stop_accepting(work_queue_t * work_queue);
 
+bool work_queue_is_stopped(work_queue_t * work_queue);
+
+/**
+ * Wakes up to `n` threads waiting in `work_queue_wait_while_no_work()`,
+ * if there are any, though the queue may have no works.
+ *
+ * Used to hand the waiters works kept outside of the queue.
+ */
+err_t work_queue_kick(work_queue_t * work_queue, size_t n);
+
+/**
+ * Wakes up the thread waiting with a deadline, so it could wait for
+ * an earlier one. Any other waiter is woken up if there is no such thread.
+ */
+err_t work_queue_kick_timed(work_queue_t * work_queue);
+
 #endif
 
@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+
+#include "work_ring.h"
+
+#define CACHE_LINE_SIZE 64
+
+typedef struct work_cell_s
+{
+  atomic_size_t sequence;
+  work_t        work;
+} work_cell_t;
+
+struct work_ring_s
+{
+  /* producers and consumers spin on different cache lines */
+  alignas(CACHE_LINE_SIZE) atomic_size_t enqueue_pos;
+  alignas(CACHE_LINE_SIZE) atomic_size_t dequeue_pos;
+
+  alignas(CACHE_LINE_SIZE) size_t mask;
+  work_cell_t * cells;
+};
+
+work_ring_t * work_ring_create(size_t capacity)
+{
+  work_ring_t * ring = NULL;
+
+  size_t cells_no = 2;
+
+  while (cells_no < capacity)
+  {
+    assert(cells_no << 1 != 0 && "capacity is too big");
+    cells_no <<= 1;
+  }
+
+  TRY_NEW(1, ring = aligned_alloc(alignof(work_ring_t), sizeof(work_ring_t)));
+  TRY_NEW(2, ring->cells = malloc(cells_no * sizeof(work_cell_t)));
+
+  for (size_t i = 0; i < cells_no; i++)
+  {
+    atomic_init(&ring->cells[i].sequence, i);
+  }
+
+  ring->mask = cells_no - 1;
+
+  atomic_init(&ring->enqueue_pos, 0);
+  atomic_init(&ring->dequeue_pos, 0);
+
+  return ring;
+
+try_failure_2: free(ring);
+try_failure_1: return NULL;
+}
+
+void work_ring_destroy(work_ring_t * ring)
+{
+  if (ring == NULL) return;
+
+  free(ring->cells);
+  free(ring);
+}
+
+err_t work_ring_push(work_ring_t * ring, const work_t * p_work)
+{
+  assert(ring   != NULL);
+  assert(p_work != NULL);
+
+  work_cell_t * cell = NULL;
+
+  size_t pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+
+  while (true)
+  {
+    cell = &ring->cells[pos & ring->mask];
+
+    size_t   sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    intptr_t diff     = (intptr_t) sequence - (intptr_t) pos;
+
+    if (diff == 0)
+    {
+      // the cell is free for this lap, try to claim it
+      if (atomic_compare_exchange_weak(&ring->enqueue_pos, &pos, pos + 1)) break;
+    }
+    else if (diff < 0)
+    {
+      // the cell still holds a work from the previous lap
+      return E_OVERFLOW;
+    }
+    else
+    {
+      pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+    }
+  }
+
+  cell->work = *p_work;
+
+  atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+
+  return E_OK;
+}
+
+err_t work_ring_pop(work_ring_t * ring, work_t * p_work)
+{
+  assert(ring   != NULL);
+  assert(p_work != NULL);
+
+  work_cell_t * cell = NULL;
+
+  size_t pos = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+
+  while (true)
+  {
+    cell = &ring->cells[pos & ring->mask];
+
+    size_t   sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    intptr_t diff     = (intptr_t) sequence - (intptr_t) (pos + 1);
+
+    if (diff == 0)
+    {
+      // the cell is published for this lap, try to claim it
+      if (atomic_compare_exchange_weak(&ring->dequeue_pos, &pos, pos + 1)) break;
+    }
+    else if (diff < 0)
+    {
+      // nothing was published to the cell yet
+      return E_UNDERFLOW;
+    }
+    else
+    {
+      pos = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+    }
+  }
+
+  *p_work = cell->work;
+
+  atomic_store_explicit(&cell->sequence, pos + ring->mask + 1, memory_order_release);
+
+  return E_OK;
+}
+
+bool work_ring_is_empty(work_ring_t * ring)
+{
+  assert(ring != NULL);
+
+  size_t dequeue_pos = atomic_load(&ring->dequeue_pos);
+  size_t enqueue_pos = atomic_load(&ring->enqueue_pos);
+
+  return enqueue_pos == dequeue_pos;
+}
+
+size_t work_ring_size(work_ring_t * ring)
+{
+  assert(ring != NULL);
+
+  size_t dequeue_pos = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+  size_t enqueue_pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+
+  // positions are read apart, so dequeue_pos may be ahead
+  return (intptr_t) (enqueue_pos - dequeue_pos) > 0 ? enqueue_pos - dequeue_pos : 0;
+}
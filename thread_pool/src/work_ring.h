@@ -0,0 +1,48 @@
+#ifndef WORK_RING_H
+#define WORK_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "internals/common.h"
+
+#include "work.h"
+
+/**
+ * Bounded multi-producer/multi-consumer lock-free ring of works.
+ *
+ * Each cell carries a sequence number telling whether it is ready
+ * to be written or read for the current lap (D. Vyukov's design).
+ */
+typedef struct work_ring_s work_ring_t;
+
+/**
+ * `capacity` is rounded up to a power of two, at least 2.
+ */
+work_ring_t * work_ring_create(size_t capacity);
+
+void work_ring_destroy(work_ring_t * ring);
+
+/**
+ * @retval E_OK        Work is pushed.
+ * @retval E_OVERFLOW  Ring is full.
+ */
+err_t work_ring_push(work_ring_t * ring, const work_t * p_work);
+
+/**
+ * @retval E_OK        Work is popped.
+ * @retval E_UNDERFLOW Ring is empty.
+ */
+err_t work_ring_pop(work_ring_t * ring, work_t * p_work);
+
+/**
+ * The result may be outdated as soon as it is returned.
+ */
+bool work_ring_is_empty(work_ring_t * ring);
+
+/**
+ * The result may be outdated as soon as it is returned.
+ */
+size_t work_ring_size(work_ring_t * ring);
+
+#endif
@@ -0,0 +1,159 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+
+extern "C"
+{
+  #include "slab.h"
+}
+
+/******************************************************/
+
+static const size_t CACHE_LINE = 64;
+
+/******************************************************/
+
+TEST(Slab, allocates_distinct_aligned_objects_on_own_cache_lines)
+{
+  slab_t * slab = slab_create(24, 1);
+
+  ASSERT_NE(slab, nullptr);
+
+  std::vector<uintptr_t> objects;
+
+  for (size_t i = 0; i < 200; i++)
+  {
+    void * object = slab_alloc(slab, i % 2 ? slab_cache(slab, 0) : NULL);
+
+    ASSERT_NE(object, nullptr);
+    EXPECT_EQ((uintptr_t) object % alignof(max_align_t), 0u);
+
+    memset(object, 0xff, 24);
+
+    objects.push_back((uintptr_t) object);
+  }
+
+  std::sort(objects.begin(), objects.end());
+
+  for (size_t i = 1; i < objects.size(); i++)
+  {
+    EXPECT_GE(objects[i] - objects[i - 1], CACHE_LINE);
+  }
+
+  slab_destroy(slab);
+}
+
+TEST(Slab, reuses_objects_freed_by_the_owner)
+{
+  slab_t * slab = slab_create(16, 1);
+
+  slab_cache_t * cache = slab_cache(slab, 0);
+
+  void * object = slab_alloc(slab, cache);
+
+  slab_free(slab, cache, object);
+
+  EXPECT_EQ(slab_alloc(slab, cache), object);
+
+  slab_destroy(slab);
+}
+
+TEST(Slab, returns_objects_freed_by_others_to_the_owner)
+{
+  slab_t * slab = slab_create(16, 2);
+
+  slab_cache_t * owner = slab_cache(slab, 0);
+  slab_cache_t * other = slab_cache(slab, 1);
+
+  std::set<void *> allocated;
+
+  // more than the owner's cache holds locally, so it has to take them back
+  for (size_t i = 0; i < 100; i++)
+  {
+    allocated.insert(slab_alloc(slab, owner));
+  }
+
+  for (void * object : allocated)
+  {
+    slab_free(slab, other, object);
+  }
+
+  slab_cache_flush(slab, other);
+
+  // they come back once the ones the owner holds run out
+  size_t reused = 0;
+
+  for (size_t i = 0; i < 200; i++)
+  {
+    reused += allocated.count(slab_alloc(slab, owner));
+  }
+
+  EXPECT_EQ(reused, allocated.size());
+
+  slab_destroy(slab);
+}
+
+TEST(Slab, passes_objects_between_threads)
+{
+  const size_t THREADS = 4;
+  const size_t ROUNDS  = 10000;
+
+  slab_t * slab = slab_create(sizeof(size_t), THREADS);
+
+  std::vector<std::atomic<size_t *>> mailboxes(THREADS);
+  std::vector<std::thread>           threads;
+
+  for (auto & mailbox : mailboxes) mailbox = nullptr;
+
+  // each thread allocates objects the next one frees
+  for (size_t t = 0; t < THREADS; t++)
+  {
+    threads.emplace_back([&, t]
+    {
+      slab_cache_t * cache = slab_cache(slab, t);
+
+      auto & outbox = mailboxes[(t + 1) % THREADS];
+      auto & inbox  = mailboxes[t];
+
+      size_t sent     = 0;
+      size_t received = 0;
+
+      while (sent < ROUNDS || received < ROUNDS)
+      {
+        size_t * object = inbox.exchange(nullptr);
+
+        if (object != nullptr)
+        {
+          EXPECT_EQ(*object, received++);
+          slab_free(slab, cache, object);
+        }
+
+        if (sent < ROUNDS && outbox.load() == nullptr)
+        {
+          size_t * fresh = (size_t *) slab_alloc(slab, t % 2 ? cache : NULL);
+
+          ASSERT_NE(fresh, nullptr);
+
+          *fresh = sent++;
+          outbox.store(fresh);
+        }
+
+        std::this_thread::yield();
+      }
+
+      slab_cache_flush(slab, cache);
+    });
+  }
+
+  for (auto & thread : threads) thread.join();
+
+  slab_destroy(slab);
+}
@@ -0,0 +1,142 @@
+#include "gtest/gtest.h"
+
+#include <vector>
+
+extern "C"
+{
+  #include "timer_wheel.h"
+}
+
+/******************************************************/
+
+static std::vector<uint64_t> Expiries(wheel_timer_t * expired)
+{
+  std::vector<uint64_t> expiries;
+
+  for (; expired != NULL; expired = expired->next)
+  {
+    expiries.push_back(expired->expiry);
+  }
+
+  return expiries;
+}
+
+/******************************************************/
+
+TEST(TimerWheel, creates_empty_wheel)
+{
+  timer_wheel_t * wheel = timer_wheel_create(1000);
+
+  ASSERT_NE(wheel, nullptr);
+
+  EXPECT_TRUE(timer_wheel_is_empty(wheel));
+  EXPECT_EQ(timer_wheel_next_event(wheel), UINT64_MAX);
+  EXPECT_EQ(timer_wheel_advance(wheel, 100000), nullptr);
+
+  timer_wheel_destroy(wheel);
+}
+
+TEST(TimerWheel, expires_timers_at_their_ticks)
+{
+  const uint64_t START = 123456;
+
+  // spread over every level, and beyond the wheel's range
+  const uint64_t DELAYS[] = { 1, 2, 63, 64, 65, 100, 4095, 4096, 5000,
+                              262143, 262144, 300000, 16777215, 16777216, 50000000 };
+
+  const size_t N = sizeof(DELAYS) / sizeof(DELAYS[0]);
+
+  timer_wheel_t * wheel = timer_wheel_create(START);
+
+  ASSERT_NE(wheel, nullptr);
+
+  std::vector<wheel_timer_t> timers(N);
+
+  for (size_t i = 0; i < N; i++)
+  {
+    timer_wheel_insert(wheel, &timers[i], START + DELAYS[i]);
+  }
+
+  EXPECT_FALSE(timer_wheel_is_empty(wheel));
+
+  for (size_t i = 0; i < N; i++)
+  {
+    uint64_t expiry = START + DELAYS[i];
+
+    // the tick before its expiry, and at it
+    std::vector<uint64_t> expired = Expiries(timer_wheel_advance(wheel, expiry - 1));
+
+    for (uint64_t e : expired)
+    {
+      EXPECT_LT(e, expiry);
+    }
+
+    EXPECT_LE(timer_wheel_next_event(wheel), expiry);
+    EXPECT_EQ(Expiries(timer_wheel_advance(wheel, expiry)), std::vector<uint64_t>({ expiry }));
+  }
+
+  EXPECT_TRUE(timer_wheel_is_empty(wheel));
+
+  timer_wheel_destroy(wheel);
+}
+
+TEST(TimerWheel, expires_due_timers_on_next_tick)
+{
+  timer_wheel_t * wheel = timer_wheel_create(100);
+
+  ASSERT_NE(wheel, nullptr);
+
+  wheel_timer_t past, now;
+
+  timer_wheel_insert(wheel, &past, 50);
+  timer_wheel_insert(wheel, &now,  100);
+
+  EXPECT_EQ(timer_wheel_next_event(wheel), 101u);
+  EXPECT_EQ(Expiries(timer_wheel_advance(wheel, 101)).size(), 2u);
+
+  timer_wheel_destroy(wheel);
+}
+
+TEST(TimerWheel, removes_timers)
+{
+  timer_wheel_t * wheel = timer_wheel_create(0);
+
+  ASSERT_NE(wheel, nullptr);
+
+  wheel_timer_t near, far, kept;
+
+  timer_wheel_insert(wheel, &near, 10);
+  timer_wheel_insert(wheel, &far,  100000);
+  timer_wheel_insert(wheel, &kept, 10);
+
+  EXPECT_EQ(timer_wheel_next_event(wheel), 10u);
+
+  timer_wheel_remove(wheel, &near);
+  timer_wheel_remove(wheel, &far);
+
+  EXPECT_EQ(Expiries(timer_wheel_advance(wheel, 1000000)), std::vector<uint64_t>({ 10 }));
+  EXPECT_TRUE(timer_wheel_is_empty(wheel));
+
+  timer_wheel_destroy(wheel);
+}
+
+TEST(TimerWheel, expires_in_order_of_ticks)
+{
+  timer_wheel_t * wheel = timer_wheel_create(0);
+
+  ASSERT_NE(wheel, nullptr);
+
+  std::vector<wheel_timer_t> timers(300);
+
+  for (size_t i = 0; i < timers.size(); i++)
+  {
+    timer_wheel_insert(wheel, &timers[i], (i * 7919) % 10000 + 1);
+  }
+
+  std::vector<uint64_t> expired = Expiries(timer_wheel_advance(wheel, 10000));
+
+  EXPECT_EQ(expired.size(), timers.size());
+  EXPECT_TRUE(std::is_sorted(expired.begin(), expired.end()));
+
+  timer_wheel_destroy(wheel);
+}
@@ -0,0 +1,69 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <thread>
+
+extern "C"
+{
+  #include "timers.h"
+}
+
+/******************************************************/
+
+static void dummy_work_routine(void *)
+{
+  // nothing
+}
+
+/******************************************************/
+
+TEST(Timers, retries_works_the_full_queue_rejects)
+{
+  timers_t     * timers = timers_create();
+  work_queue_t * queue  = work_queue_create_lockfree(1);
+
+  ASSERT_NE(timers, nullptr);
+  ASSERT_NE(queue,  nullptr);
+
+  work_t filler = { dummy_work_routine, (void *) 1 };
+  work_t timed  = { dummy_work_routine, (void *) 2 };
+  work_t temp;
+
+  size_t fillers = 0;
+
+  // the ring may be bigger than asked for
+  while (work_queue_push(queue, &filler) == E_OK) fillers++;
+
+  bool earlier = false;
+
+  ASSERT_EQ(timers_add(timers, 0, 0, &timed, NULL, &earlier), E_OK);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+  // the work does not fit, but the timer is not lost
+  timers_poll(timers, queue);
+
+  EXPECT_EQ(timers_armed(timers), 1u);
+  EXPECT_EQ(work_queue_size(queue), fillers);
+
+  ASSERT_EQ(work_queue_pop(queue, &temp), E_OK);
+  EXPECT_EQ(temp.arg, filler.arg);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+  timers_poll(timers, queue);
+
+  EXPECT_EQ(timers_armed(timers), 0u);
+
+  for (size_t i = 1; i < fillers; i++)
+  {
+    ASSERT_EQ(work_queue_pop(queue, &temp), E_OK);
+    EXPECT_EQ(temp.arg, filler.arg);
+  }
+
+  ASSERT_EQ(work_queue_pop(queue, &temp), E_OK);
+  EXPECT_EQ(temp.arg, timed.arg);
+
+  work_queue_destroy(queue);
+  timers_destroy(timers);
+}
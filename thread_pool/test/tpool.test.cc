@@ -1,5 +1,19 @@
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sched.h>
+#include <pthread.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
 extern "C"
 {
   #include "tpool.h"
@@ -115,3 +129,2142 @@ TEST(TPoolMultiThreaded, rejects_works_after_shutdown)
   tpool_join_then_destroy(tpool);
 }
 
+
+TEST(TPool, handles_invalid_config)
+{
+  tpool_t * tpool = NULL;
+  tpool_config_t config;
+
+  EXPECT_EQ(tpool_create_ex(&tpool, NULL), TPOOL_EINVARG);
+
+  tpool_config_init(&config, 0);
+  EXPECT_EQ(tpool_create_ex(&tpool, &config), TPOOL_EINVARG);
+
+  tpool_config_init(&config, 4);
+  config.queue          = TPOOL_QUEUE_LOCKFREE;
+  config.queue_capacity = 0;
+  EXPECT_EQ(tpool_create_ex(&tpool, &config), TPOOL_EINVARG);
+
+  tpool_config_init(&config, 4);
+  config.queue          = TPOOL_QUEUE_BOUNDED;
+  config.queue_capacity = 0;
+  EXPECT_EQ(tpool_create_ex(&tpool, &config), TPOOL_EINVARG);
+
+  tpool_config_init(&config, 4);
+  config.grab_size = 0;
+  EXPECT_EQ(tpool_create_ex(&tpool, &config), TPOOL_EINVARG);
+}
+
+TEST(TPoolLockFree, executes_all_works)
+{
+  const size_t TOTAL_WORKS_NO = 1000;
+
+  std::atomic<size_t> done { 0 };
+
+  tpool_t * tpool = NULL;
+  tpool_config_t config;
+
+  tpool_config_init(&config, 8);
+  config.queue          = TPOOL_QUEUE_LOCKFREE;
+  config.queue_capacity = 2 * TOTAL_WORKS_NO;
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  auto work_routine = [](void * context)
+    {
+      auto * counter = (std::atomic<size_t> *) context;
+
+      (*counter)++;
+    };
+
+  for (size_t i = 0; i < TOTAL_WORKS_NO; i++)
+  {
+    EXPECT_EQ(tpool_add_work(tpool, work_routine, &done), TPOOL_SUCCESS);
+  }
+
+  tpool_shutdown(tpool);
+
+  EXPECT_EQ(tpool_add_work(tpool, work_routine, &done), TPOOL_EREQREJECTED);
+
+  tpool_join_then_destroy(tpool);
+
+  EXPECT_EQ(done, TOTAL_WORKS_NO);
+}
+
+TEST(TPoolBounded, holds_submitters_back_while_queue_is_full)
+{
+  const size_t SUBMITTERS_NO  = 4;
+  const size_t WORKS_NO       = 2000; // per submitter
+  const size_t QUEUE_CAPACITY = 8;
+
+  struct context_t
+  {
+    std::atomic<size_t> submitted;
+    std::atomic<size_t> done;
+    std::atomic<size_t> most_ahead; // submitted but not done
+  };
+
+  static context_t context;
+
+  context.submitted  = 0;
+  context.done       = 0;
+  context.most_ahead = 0;
+
+  tpool_t * tpool = NULL;
+  tpool_config_t config;
+
+  tpool_config_init(&config, 2);
+  config.queue          = TPOOL_QUEUE_BOUNDED;
+  config.queue_capacity = QUEUE_CAPACITY;
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  auto work_routine = [](void *)
+    {
+      context.done++;
+    };
+
+  std::vector<std::thread> submitters;
+
+  for (size_t t = 0; t < SUBMITTERS_NO; t++)
+  {
+    submitters.emplace_back([&]
+    {
+      for (size_t i = 0; i < WORKS_NO; i++)
+      {
+        // counted in advance, so it is never behind `done`
+        context.submitted++;
+
+        EXPECT_EQ(tpool_add_work(tpool, work_routine, NULL), TPOOL_SUCCESS);
+
+        size_t done  = context.done;
+        size_t ahead = context.submitted - done;
+        size_t most  = context.most_ahead;
+
+        while (ahead > most && !context.most_ahead.compare_exchange_weak(most, ahead)) {}
+      }
+    });
+  }
+
+  for (auto & submitter : submitters) submitter.join();
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+
+  EXPECT_EQ(context.done, SUBMITTERS_NO * WORKS_NO);
+
+  // queued, grabbed from the queue by both threads, and being submitted
+  EXPECT_LE(context.most_ahead, 2 * QUEUE_CAPACITY + SUBMITTERS_NO);
+}
+
+TEST(TPoolBounded, rejects_works_of_its_threads_while_queue_is_full)
+{
+  const size_t THREADS_NO     = 2;
+  const size_t QUEUE_CAPACITY = 2;
+
+  struct context_t
+  {
+    std::atomic<size_t> inside;
+    std::atomic<bool>   filled;
+    std::atomic<size_t> tried;
+    std::atomic<size_t> rejected;
+    std::atomic<size_t> done;
+  };
+
+  static context_t context;
+
+  context.inside   = 0;
+  context.tried    = 0;
+  context.filled   = false;
+  context.rejected = 0;
+  context.done     = 0;
+
+  tpool_t * tpool = NULL;
+  tpool_config_t config;
+
+  tpool_config_init(&config, THREADS_NO);
+  config.queue          = TPOOL_QUEUE_BOUNDED;
+  config.queue_capacity = QUEUE_CAPACITY;
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  static tpool_t * pool;
+
+  pool = tpool;
+
+  auto work_routine = [](void *)
+    {
+      context.done++;
+    };
+
+  // every thread of the pool submits to the full queue nobody else drains
+  auto submitter_routine = [](void *)
+    {
+      context.inside++;
+
+      while (!context.filled) sched_yield();
+
+      tpool_ret_t ret = tpool_add_work_prio(pool, TPOOL_PRIORITY_HIGH, [](void *) { context.done++; }, NULL);
+
+      EXPECT_EQ(ret, TPOOL_EQUEUEFULL);
+
+      if (ret == TPOOL_EQUEUEFULL) context.rejected++;
+
+      // nobody drains the queue before all of them tried
+      context.tried++;
+
+      while (context.tried < THREADS_NO) sched_yield();
+    };
+
+  for (size_t i = 0; i < THREADS_NO; i++)
+  {
+    ASSERT_EQ(tpool_add_work(tpool, submitter_routine, NULL), TPOOL_SUCCESS);
+
+    while (context.inside <= i) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  for (size_t i = 0; i < QUEUE_CAPACITY; i++)
+  {
+    ASSERT_EQ(tpool_add_work(tpool, work_routine, NULL), TPOOL_SUCCESS);
+  }
+
+  context.filled = true;
+
+  while (context.tried < THREADS_NO) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+
+  EXPECT_EQ(context.rejected, THREADS_NO);
+  EXPECT_EQ(context.done, QUEUE_CAPACITY);
+}
+
+TEST(TPoolBounded, fires_timers_while_queue_is_full)
+{
+  const size_t QUEUE_CAPACITY = 2;
+
+  struct context_t
+  {
+    std::atomic<bool>   started;
+    std::atomic<bool>   released;
+    std::atomic<size_t> fired;
+  };
+
+  static context_t context;
+
+  context.started  = false;
+  context.released = false;
+  context.fired    = 0;
+
+  tpool_t * tpool = NULL;
+  tpool_config_t config;
+
+  // the only thread polls the timers right after the blocker, with the queue full
+  tpool_config_init(&config, 1);
+  config.queue          = TPOOL_QUEUE_BOUNDED;
+  config.queue_capacity = QUEUE_CAPACITY;
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  auto blocker = [](void *)
+    {
+      context.started = true;
+
+      while (!context.released) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    };
+
+  auto filler = [](void *) {};
+
+  auto timed = [](void *)
+    {
+      context.fired++;
+    };
+
+  ASSERT_EQ(tpool_add_work(tpool, blocker, NULL), TPOOL_SUCCESS);
+
+  while (!context.started) std::this_thread::yield();
+
+  for (size_t i = 0; i < QUEUE_CAPACITY; i++)
+  {
+    ASSERT_EQ(tpool_add_work(tpool, filler, NULL), TPOOL_SUCCESS);
+  }
+
+  ASSERT_EQ(tpool_add_work_after(tpool, 1000000, timed, NULL, NULL), TPOOL_SUCCESS);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+  context.released = true;
+
+  // timers are not held up by the poller either
+  tpool_timer_t * timer = NULL;
+
+  ASSERT_EQ(tpool_add_work_every(tpool, 1000000, timed, NULL, &timer), TPOOL_SUCCESS);
+
+  for (size_t i = 0; i < 2000 && context.fired < 3; i++)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  EXPECT_GE(context.fired, 3u);
+
+  EXPECT_EQ(tpool_timer_cancel(timer), TPOOL_SUCCESS);
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolMultiThreaded, executes_works_submitted_from_works)
+{
+  struct context_t
+  {
+    tpool_t             * tpool;
+    std::atomic<size_t>   done;
+  };
+
+  const size_t DEPTH    = 12;
+  const size_t WORKS_NO = (1 << (DEPTH + 1)) - 1;
+
+  static context_t context;
+
+  context.done = 0;
+
+  ASSERT_EQ(tpool_create(&context.tpool, 4), TPOOL_SUCCESS);
+
+  static void (* spawn)(void *) = [](void * arg)
+    {
+      size_t depth = (size_t) arg;
+
+      if (depth > 0)
+      {
+        EXPECT_EQ(tpool_add_work(context.tpool, spawn, (void *) (depth - 1)), TPOOL_SUCCESS);
+        EXPECT_EQ(tpool_add_work(context.tpool, spawn, (void *) (depth - 1)), TPOOL_SUCCESS);
+      }
+
+      context.done++;
+    };
+
+  EXPECT_EQ(tpool_add_work(context.tpool, spawn, (void *) DEPTH), TPOOL_SUCCESS);
+
+  while (context.done < WORKS_NO)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  tpool_shutdown(context.tpool);
+  tpool_join_then_destroy(context.tpool);
+
+  EXPECT_EQ(context.done, WORKS_NO);
+}
+
+TEST(TPool, handles_invalid_batch)
+{
+  tpool_t * tpool = NULL;
+
+  tpool_work_t works[] = { { [](void *) {}, NULL }, { NULL, NULL } };
+
+  EXPECT_EQ(tpool_add_works(NULL, works, 1), TPOOL_EINVARG);
+
+  ASSERT_EQ(tpool_create(&tpool, 2), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_add_works(tpool, NULL, 1), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_add_works(tpool, works, 2), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_add_works(tpool, NULL, 0), TPOOL_SUCCESS);
+
+  tpool_shutdown(tpool);
+
+  EXPECT_EQ(tpool_add_works(tpool, works, 1), TPOOL_EREQREJECTED);
+
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolSingleThreaded, executes_batch_in_fifo)
+{
+  const size_t TOTAL_WORKS_NO = 100;
+
+  tpool_t * tpool = NULL;
+
+  ASSERT_EQ(tpool_create(&tpool, 1), TPOOL_SUCCESS);
+
+  static std::vector<size_t> executed;
+
+  executed.clear();
+
+  std::vector<tpool_work_t> works;
+
+  for (size_t i = 0; i < TOTAL_WORKS_NO; i++)
+  {
+    works.push_back({ [](void * arg) { executed.push_back((size_t) arg); }, (void *) i });
+  }
+
+  EXPECT_EQ(tpool_add_works(tpool, works.data(), works.size()), TPOOL_SUCCESS);
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+
+  ASSERT_EQ(executed.size(), TOTAL_WORKS_NO);
+
+  for (size_t i = 0; i < TOTAL_WORKS_NO; i++)
+  {
+    EXPECT_EQ(executed[i], i);
+  }
+}
+
+TEST(TPoolMultiThreaded, executes_batches_submitted_from_works)
+{
+  const size_t FAN_OUT = 64;
+
+  static tpool_t * tpool;
+  static std::atomic<size_t> done;
+
+  done = 0;
+
+  ASSERT_EQ(tpool_create(&tpool, 4), TPOOL_SUCCESS);
+
+  auto leaf = [](void *) { done++; };
+
+  auto root = [](void * arg)
+    {
+      auto leaf = (tpool_work_routine_t) arg;
+
+      std::vector<tpool_work_t> works(FAN_OUT, tpool_work_t { leaf, NULL });
+
+      EXPECT_EQ(tpool_add_works(tpool, works.data(), works.size()), TPOOL_SUCCESS);
+    };
+
+  for (size_t i = 0; i < 4; i++)
+  {
+    EXPECT_EQ(tpool_add_work(tpool, root, (void *) +leaf), TPOOL_SUCCESS);
+  }
+
+  while (done < 4 * FAN_OUT)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+
+  EXPECT_EQ(done, 4 * FAN_OUT);
+}
+
+TEST(TPoolSingleThreaded, executes_all_works_in_fifo_grabbing_many)
+{
+  tpool_t * tpool = NULL;
+  tpool_config_t config;
+
+  tpool_config_init(&config, 1);
+  config.grab_size = 7;
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  static std::vector<size_t> executed;
+
+  executed.clear();
+
+  for (size_t i = 0; i < 100; i++)
+  {
+    EXPECT_EQ(tpool_add_work(tpool, [](void * arg) { executed.push_back((size_t) arg); }, (void *) i),
+              TPOOL_SUCCESS);
+  }
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+
+  ASSERT_EQ(executed.size(), 100);
+
+  for (size_t i = 0; i < 100; i++)
+  {
+    EXPECT_EQ(executed[i], i);
+  }
+}
+
+TEST(TPool, counts_how_idle_periods_ended)
+{
+  tpool_t * tpool = NULL;
+  tpool_stats_t stats;
+  tpool_config_t config;
+
+  tpool_config_init(&config, 2);
+  config.idle_spins  = 0;
+  config.idle_yields = 0;
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_get_stats(NULL, &stats), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_get_stats(tpool, NULL),  TPOOL_EINVARG);
+
+  for (size_t i = 0; i < 10; i++)
+  {
+    EXPECT_EQ(tpool_add_work(tpool, [](void *) {}, NULL), TPOOL_SUCCESS);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+
+  tpool_shutdown(tpool);
+  tpool_join(tpool);
+
+  ASSERT_EQ(tpool_get_stats(tpool, &stats), TPOOL_SUCCESS);
+
+  // with no spinning and no yielding every idle period ends parked
+  EXPECT_GE(stats.idle_parked, 10);
+  EXPECT_EQ(stats.idle_spun,    0);
+  EXPECT_EQ(stats.idle_yielded, 0);
+
+  tpool_destroy(tpool);
+}
+
+TEST(TPoolMultiThreaded, executes_all_works_while_spinning)
+{
+  const size_t TOTAL_WORKS_NO = 1000;
+
+  static std::atomic<size_t> done;
+
+  tpool_t * tpool = NULL;
+  tpool_config_t config;
+
+  done = 0;
+
+  tpool_config_init(&config, 4);
+  config.idle_spins  = 1 << 16;
+  config.idle_yields = 16;
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  for (size_t i = 0; i < TOTAL_WORKS_NO; i++)
+  {
+    EXPECT_EQ(tpool_add_work(tpool, [](void *) { done++; }, NULL), TPOOL_SUCCESS);
+  }
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+
+  EXPECT_EQ(done, TOTAL_WORKS_NO);
+}
+
+TEST(TPoolFuture, handles_invalid_arguments)
+{
+  tpool_t        * tpool  = NULL;
+  tpool_future_t * future = NULL;
+
+  auto task = [](void * arg) -> void * { return arg; };
+
+  ASSERT_EQ(tpool_create(&tpool, 1), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_submit(NULL,  task, NULL, &future), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_submit(tpool, NULL, NULL, &future), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_submit(tpool, task, NULL, NULL),    TPOOL_EINVARG);
+
+  EXPECT_EQ(tpool_future_wait(NULL, NULL),    TPOOL_EINVARG);
+  EXPECT_EQ(tpool_future_try_get(NULL, NULL), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_future_release(NULL),       TPOOL_EINVARG);
+
+  tpool_shutdown(tpool);
+
+  EXPECT_EQ(tpool_submit(tpool, task, NULL, &future), TPOOL_EREQREJECTED);
+
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolFuture, waits_for_results)
+{
+  const size_t TASKS_NUMBER = 1000;
+
+  tpool_t * tpool = NULL;
+
+  std::vector<tpool_future_t *> futures(TASKS_NUMBER);
+  std::vector<size_t>           args(TASKS_NUMBER);
+
+  auto square = [](void * arg) -> void *
+    {
+      size_t x = *(size_t *) arg;
+
+      return (void *) (x * x);
+    };
+
+  ASSERT_EQ(tpool_create(&tpool, 4), TPOOL_SUCCESS);
+
+  for (size_t i = 0; i < TASKS_NUMBER; i++)
+  {
+    args[i] = i;
+    ASSERT_EQ(tpool_submit(tpool, square, &args[i], &futures[i]), TPOOL_SUCCESS);
+  }
+
+  for (size_t i = 0; i < TASKS_NUMBER; i++)
+  {
+    void * result = NULL;
+
+    EXPECT_EQ(tpool_future_wait(futures[i], &result), TPOOL_SUCCESS);
+    EXPECT_EQ((size_t) result, i * i);
+
+    // the result stays available until the future is released
+    EXPECT_EQ(tpool_future_try_get(futures[i], &result), TPOOL_SUCCESS);
+    EXPECT_EQ((size_t) result, i * i);
+
+    EXPECT_EQ(tpool_future_release(futures[i]), TPOOL_SUCCESS);
+  }
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolFuture, reports_not_ready_until_done)
+{
+  static std::atomic<bool> may_finish;
+
+  may_finish = false;
+
+  tpool_t        * tpool  = NULL;
+  tpool_future_t * future = NULL;
+
+  auto task = [](void *) -> void *
+    {
+      while (!may_finish)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+
+      return (void *) 42;
+    };
+
+  ASSERT_EQ(tpool_create(&tpool, 1), TPOOL_SUCCESS);
+  ASSERT_EQ(tpool_submit(tpool, task, NULL, &future), TPOOL_SUCCESS);
+
+  void * result = NULL;
+
+  EXPECT_EQ(tpool_future_try_get(future, &result), TPOOL_ENOTREADY);
+  EXPECT_EQ(result, (void *) NULL);
+
+  may_finish = true;
+
+  EXPECT_EQ(tpool_future_wait(future, &result), TPOOL_SUCCESS);
+  EXPECT_EQ(result, (void *) 42);
+
+  tpool_future_release(future);
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolFuture, recycles_futures_released_before_done)
+{
+  const size_t TASKS_NUMBER = 1000;
+
+  static std::atomic<size_t> done;
+
+  done = 0;
+
+  tpool_t * tpool = NULL;
+
+  auto task = [](void *) -> void * { done++; return NULL; };
+
+  ASSERT_EQ(tpool_create(&tpool, 4), TPOOL_SUCCESS);
+
+  for (size_t i = 0; i < TASKS_NUMBER; i++)
+  {
+    tpool_future_t * future = NULL;
+
+    ASSERT_EQ(tpool_submit(tpool, task, NULL, &future), TPOOL_SUCCESS);
+    EXPECT_EQ(tpool_future_release(future), TPOOL_SUCCESS);
+  }
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+
+  EXPECT_EQ(done, TASKS_NUMBER);
+}
+
+TEST(TPoolGroup, handles_invalid_arguments)
+{
+  tpool_t       * tpool = NULL;
+  tpool_group_t * group = NULL;
+
+  auto work = [](void *) {};
+
+  ASSERT_EQ(tpool_create(&tpool, 1), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_group_create(NULL, &group), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_group_create(tpool, NULL),  TPOOL_EINVARG);
+
+  EXPECT_EQ(tpool_group_add_work(NULL, work, NULL), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_group_wait(NULL),    TPOOL_EINVARG);
+  EXPECT_EQ(tpool_group_destroy(NULL), TPOOL_EINVARG);
+
+  ASSERT_EQ(tpool_group_create(tpool, &group), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_group_add_work(group, NULL, NULL), TPOOL_EINVARG);
+
+  tpool_shutdown(tpool);
+
+  // a rejected work is not waited for
+  EXPECT_EQ(tpool_group_add_work(group, work, NULL), TPOOL_EREQREJECTED);
+  EXPECT_EQ(tpool_group_wait(group),    TPOOL_SUCCESS);
+  EXPECT_EQ(tpool_group_destroy(group), TPOOL_SUCCESS);
+
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolGroup, waits_for_all_works)
+{
+  const size_t WORKS_NUMBER = 1000;
+
+  static std::atomic<size_t> done;
+
+  done = 0;
+
+  tpool_t       * tpool = NULL;
+  tpool_group_t * group = NULL;
+
+  auto work = [](void *) { done++; };
+
+  ASSERT_EQ(tpool_create(&tpool, 4), TPOOL_SUCCESS);
+  ASSERT_EQ(tpool_group_create(tpool, &group), TPOOL_SUCCESS);
+
+  // the group may be reused once waited for
+  for (size_t round = 1; round <= 3; round++)
+  {
+    for (size_t i = 0; i < WORKS_NUMBER; i++)
+    {
+      ASSERT_EQ(tpool_group_add_work(group, work, NULL), TPOOL_SUCCESS);
+    }
+
+    EXPECT_EQ(tpool_group_wait(group), TPOOL_SUCCESS);
+    EXPECT_EQ(done, round * WORKS_NUMBER);
+  }
+
+  EXPECT_EQ(tpool_group_destroy(group), TPOOL_SUCCESS);
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+}
+
+/**
+ * Each work waits for its two halves, nesting deeper than threads number.
+ */
+static tpool_t * fib_tpool;
+
+struct fib_s
+{
+  size_t n;
+  size_t result;
+};
+
+static void fib(void * arg)
+{
+  fib_s * task = (fib_s *) arg;
+
+  if (task->n < 2)
+  {
+    task->result = task->n;
+    return;
+  }
+
+  fib_s left  = { task->n - 1, 0 };
+  fib_s right = { task->n - 2, 0 };
+
+  tpool_group_t * group = NULL;
+
+  ASSERT_EQ(tpool_group_create(fib_tpool, &group), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_group_add_work(group, fib, &left),  TPOOL_SUCCESS);
+  EXPECT_EQ(tpool_group_add_work(group, fib, &right), TPOOL_SUCCESS);
+  EXPECT_EQ(tpool_group_wait(group), TPOOL_SUCCESS);
+
+  tpool_group_destroy(group);
+
+  task->result = left.result + right.result;
+}
+
+TEST(TPoolGroup, helps_while_waiting_on_worker)
+{
+  for (size_t threads_number : { 1, 2, 4 })
+  {
+    tpool_group_t * group = NULL;
+
+    fib_s task = { 18, 0 };
+
+    ASSERT_EQ(tpool_create(&fib_tpool, threads_number), TPOOL_SUCCESS);
+    ASSERT_EQ(tpool_group_create(fib_tpool, &group), TPOOL_SUCCESS);
+
+    ASSERT_EQ(tpool_group_add_work(group, fib, &task), TPOOL_SUCCESS);
+    EXPECT_EQ(tpool_group_wait(group), TPOOL_SUCCESS);
+    EXPECT_EQ(task.result, 2584u);
+
+    tpool_group_destroy(group);
+
+    tpool_shutdown(fib_tpool);
+    tpool_join_then_destroy(fib_tpool);
+  }
+}
+
+/**
+ * The root waits for its child, which spawns a grandchild only after the
+ * root parked and then keeps its own worker busy, so the waiting worker
+ * has to wake up and steal the grandchild.
+ */
+using steady_clock = std::chrono::steady_clock;
+
+static struct
+{
+  tpool_group_t             * children;
+  std::atomic<bool>           child_started;
+  std::atomic<bool>           grandchild_started;
+  steady_clock::time_point    spawned;
+  steady_clock::duration      latency;
+  std::atomic<bool>           done;
+  size_t                      round;
+} steal_context;
+
+static void steal_grandchild(void *)
+{
+  steal_context.latency            = steady_clock::now() - steal_context.spawned;
+  steal_context.grandchild_started = true;
+}
+
+static void steal_child(void *)
+{
+  steal_context.child_started = true;
+
+  // let the root park on the group, spawning a bit later each round
+  std::this_thread::sleep_for(std::chrono::microseconds(2000 + 100 * steal_context.round));
+
+  steal_context.spawned = steady_clock::now();
+
+  EXPECT_EQ(tpool_group_add_work(steal_context.children, steal_grandchild, NULL), TPOOL_SUCCESS);
+
+  while (!steal_context.grandchild_started) sched_yield();
+}
+
+static void steal_root(void *)
+{
+  EXPECT_EQ(tpool_group_add_work(steal_context.children, steal_child, NULL), TPOOL_SUCCESS);
+
+  while (!steal_context.child_started) sched_yield();
+
+  EXPECT_EQ(tpool_group_wait(steal_context.children), TPOOL_SUCCESS);
+
+  steal_context.done = true;
+}
+
+TEST(TPoolGroup, steals_works_spawned_while_waiting)
+{
+  const size_t ROUNDS_NUMBER = 21;
+
+  tpool_t * tpool = NULL;
+
+  ASSERT_EQ(tpool_create(&tpool, 2), TPOOL_SUCCESS);
+  ASSERT_EQ(tpool_group_create(tpool, &steal_context.children), TPOOL_SUCCESS);
+
+  std::vector<long> latencies; // in microseconds
+
+  for (size_t round = 0; round < ROUNDS_NUMBER; round++)
+  {
+    steal_context.child_started      = false;
+    steal_context.grandchild_started = false;
+    steal_context.done               = false;
+    steal_context.round              = round;
+
+    ASSERT_EQ(tpool_add_work(tpool, steal_root, NULL), TPOOL_SUCCESS);
+
+    while (!steal_context.done) std::this_thread::sleep_for(std::chrono::microseconds(100));
+
+    latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(steal_context.latency).count());
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+
+  // a waiter napping on the group instead loses half a millisecond or so
+  EXPECT_LT(latencies[ROUNDS_NUMBER / 2], 250);
+
+  EXPECT_EQ(tpool_group_destroy(steal_context.children), TPOOL_SUCCESS);
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolParallel, handles_invalid_arguments)
+{
+  tpool_t * tpool = NULL;
+
+  auto body   = [](size_t, size_t, void *) {};
+  auto reduce = [](size_t, size_t, void *, void *) {};
+  auto join   = [](void *, const void *, void *) {};
+
+  size_t result = 0;
+
+  ASSERT_EQ(tpool_create(&tpool, 1), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_parallel_for(NULL,  0, 1, 0, body, NULL), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_parallel_for(tpool, 1, 0, 0, body, NULL), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_parallel_for(tpool, 0, 1, 0, NULL, NULL), TPOOL_EINVARG);
+
+  EXPECT_EQ(tpool_parallel_reduce(NULL,  0, 1, 0, &result, sizeof(result), reduce, join, NULL), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_parallel_reduce(tpool, 1, 0, 0, &result, sizeof(result), reduce, join, NULL), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_parallel_reduce(tpool, 0, 1, 0, NULL,    sizeof(result), reduce, join, NULL), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_parallel_reduce(tpool, 0, 1, 0, &result, 0,              reduce, join, NULL), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_parallel_reduce(tpool, 0, 1, 0, &result, sizeof(result), NULL,   join, NULL), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_parallel_reduce(tpool, 0, 1, 0, &result, sizeof(result), reduce, NULL, NULL), TPOOL_EINVARG);
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolParallel, visits_each_index_once)
+{
+  const size_t SIZE = 100000;
+
+  tpool_t * tpool = NULL;
+
+  std::vector<std::atomic<int>> visits(SIZE);
+
+  auto body = [](size_t begin, size_t end, void * context)
+    {
+      auto & visits = *(std::vector<std::atomic<int>> *) context;
+
+      for (size_t i = begin; i < end; i++) visits[i]++;
+    };
+
+  ASSERT_EQ(tpool_create(&tpool, 4), TPOOL_SUCCESS);
+
+  for (size_t grain : std::vector<size_t> { 0, 1, 7, 1000, SIZE, 2 * SIZE })
+  {
+    EXPECT_EQ(tpool_parallel_for(tpool, 10, SIZE, grain, body, &visits), TPOOL_SUCCESS);
+  }
+
+  for (size_t i = 0; i < SIZE; i++)
+  {
+    ASSERT_EQ(visits[i], i < 10 ? 0 : 6) << "at " << i;
+  }
+
+  tpool_shutdown(tpool);
+
+  // the caller does it all once the pool is shut down
+  EXPECT_EQ(tpool_parallel_for(tpool, 0, SIZE, 0, body, &visits), TPOOL_SUCCESS);
+  EXPECT_EQ(visits[0], 1);
+
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolParallel, reduces_in_order)
+{
+  const size_t SIZE = 10000;
+
+  tpool_t * tpool = NULL;
+
+  // concatenation is associative, but not commutative
+  struct span_s { size_t first, last, count; bool valid; };
+
+  auto reduce = [](size_t begin, size_t end, void * partial, void *)
+    {
+      span_s * span = (span_s *) partial;
+
+      for (size_t i = begin; i < end; i++)
+      {
+        if (span->count > 0 && span->last + 1 != i) span->valid = false;
+        if (span->count == 0) span->first = i;
+
+        span->last = i;
+        span->count++;
+      }
+    };
+
+  auto join = [](void * partial, const void * other, void *)
+    {
+      span_s       * left  = (span_s *) partial;
+      const span_s * right = (const span_s *) other;
+
+      if (right->count == 0) return;
+
+      if (left->count == 0) { *left = *right; return; }
+
+      left->valid = left->valid && right->valid && left->last + 1 == right->first;
+      left->last   = right->last;
+      left->count += right->count;
+    };
+
+  ASSERT_EQ(tpool_create(&tpool, 4), TPOOL_SUCCESS);
+
+  for (size_t grain : std::vector<size_t> { 0, 1, 3, 64, SIZE })
+  {
+    span_s span = { 0, 0, 0, true };
+
+    EXPECT_EQ(tpool_parallel_reduce(tpool, 0, SIZE, grain, &span, sizeof(span), reduce, join, NULL), TPOOL_SUCCESS);
+
+    EXPECT_TRUE(span.valid);
+    EXPECT_EQ(span.first, 0u);
+    EXPECT_EQ(span.last,  SIZE - 1);
+    EXPECT_EQ(span.count, SIZE);
+  }
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolParallel, nests_in_works)
+{
+  const size_t ROWS = 64, COLUMNS = 1000;
+
+  static tpool_t * tpool;
+
+  static std::vector<size_t> sums;
+
+  sums.assign(ROWS, 0);
+
+  auto row = [](size_t begin, size_t end, void *)
+    {
+      auto add = [](size_t begin, size_t end, void * partial, void *)
+        {
+          for (size_t i = begin; i < end; i++) *(size_t *) partial += i;
+        };
+
+      auto join = [](void * partial, const void * other, void *)
+        {
+          *(size_t *) partial += *(const size_t *) other;
+        };
+
+      for (size_t r = begin; r < end; r++)
+      {
+        EXPECT_EQ(tpool_parallel_reduce(tpool, 0, COLUMNS, 0, &sums[r], sizeof(size_t), add, join, NULL), TPOOL_SUCCESS);
+      }
+    };
+
+  ASSERT_EQ(tpool_create(&tpool, 2), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_parallel_for(tpool, 0, ROWS, 1, row, NULL), TPOOL_SUCCESS);
+
+  for (size_t r = 0; r < ROWS; r++)
+  {
+    EXPECT_EQ(sums[r], COLUMNS * (COLUMNS - 1) / 2);
+  }
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolGraph, handles_invalid_arguments)
+{
+  tpool_t       * tpool = NULL;
+  tpool_graph_t * graph = NULL;
+
+  auto work = [](void *) {};
+
+  size_t a = 0, b = 0;
+
+  ASSERT_EQ(tpool_create(&tpool, 1), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_graph_create(NULL, &graph), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_graph_create(tpool, NULL),  TPOOL_EINVARG);
+
+  EXPECT_EQ(tpool_graph_add_node(NULL, work, NULL, &a), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_graph_add_edge(NULL, 0, 0), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_graph_run(NULL),     TPOOL_EINVARG);
+  EXPECT_EQ(tpool_graph_destroy(NULL), TPOOL_EINVARG);
+
+  ASSERT_EQ(tpool_graph_create(tpool, &graph), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_graph_run(graph), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_graph_add_node(graph, NULL, NULL, &a), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_graph_add_node(graph, work, NULL, &a), TPOOL_SUCCESS);
+  EXPECT_EQ(tpool_graph_add_node(graph, work, NULL, &b), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_graph_add_edge(graph, a, 2), TPOOL_EINVARG);
+
+  // a cycle is reported once run
+  EXPECT_EQ(tpool_graph_add_edge(graph, a, b), TPOOL_SUCCESS);
+  EXPECT_EQ(tpool_graph_add_edge(graph, b, a), TPOOL_SUCCESS);
+  EXPECT_EQ(tpool_graph_run(graph), TPOOL_EINVARG);
+
+  EXPECT_EQ(tpool_graph_destroy(graph), TPOOL_SUCCESS);
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+}
+
+/**
+ * Every node checks that its predecessors are already done.
+ */
+struct graph_check_s
+{
+  std::atomic<size_t>          runs;
+  std::vector<graph_check_s *> predecessors;
+  std::atomic<bool>            failed;
+};
+
+static void graph_check(void * arg)
+{
+  graph_check_s * node = (graph_check_s *) arg;
+
+  size_t run = node->runs + 1;
+
+  for (graph_check_s * predecessor : node->predecessors)
+  {
+    if (predecessor->runs != run) node->failed = true;
+  }
+
+  node->runs = run;
+}
+
+TEST(TPoolGraph, runs_nodes_after_predecessors)
+{
+  const size_t LAYERS = 8, WIDTH = 16, RUNS = 20;
+
+  tpool_t       * tpool = NULL;
+  tpool_graph_t * graph = NULL;
+
+  std::vector<graph_check_s> nodes(LAYERS * WIDTH);
+  std::vector<size_t>        ids(LAYERS * WIDTH);
+
+  ASSERT_EQ(tpool_create(&tpool, 4), TPOOL_SUCCESS);
+  ASSERT_EQ(tpool_graph_create(tpool, &graph), TPOOL_SUCCESS);
+
+  for (size_t i = 0; i < nodes.size(); i++)
+  {
+    nodes[i].runs   = 0;
+    nodes[i].failed = false;
+
+    ASSERT_EQ(tpool_graph_add_node(graph, graph_check, &nodes[i], &ids[i]), TPOOL_SUCCESS);
+  }
+
+  // each node depends on two nodes of the previous layer
+  for (size_t layer = 1; layer < LAYERS; layer++)
+  {
+    for (size_t i = 0; i < WIDTH; i++)
+    {
+      size_t to = layer * WIDTH + i;
+
+      for (size_t from : { (layer - 1) * WIDTH + i, (layer - 1) * WIDTH + (i * 7 + 3) % WIDTH })
+      {
+        nodes[to].predecessors.push_back(&nodes[from]);
+        ASSERT_EQ(tpool_graph_add_edge(graph, ids[from], ids[to]), TPOOL_SUCCESS);
+      }
+    }
+  }
+
+  for (size_t run = 1; run <= RUNS; run++)
+  {
+    EXPECT_EQ(tpool_graph_run(graph), TPOOL_SUCCESS);
+
+    for (graph_check_s & node : nodes)
+    {
+      ASSERT_EQ(node.runs, run);
+      ASSERT_FALSE(node.failed);
+    }
+  }
+
+  EXPECT_EQ(tpool_graph_destroy(graph), TPOOL_SUCCESS);
+
+  tpool_shutdown(tpool);
+
+  // the caller runs the graph itself once the pool is shut down
+  graph_check_s first, second;
+
+  first.runs = second.runs = 0;
+  first.failed = second.failed = false;
+  second.predecessors.push_back(&first);
+
+  size_t a = 0, b = 0;
+
+  ASSERT_EQ(tpool_graph_create(tpool, &graph), TPOOL_SUCCESS);
+  ASSERT_EQ(tpool_graph_add_node(graph, graph_check, &second, &b), TPOOL_SUCCESS);
+  ASSERT_EQ(tpool_graph_add_node(graph, graph_check, &first,  &a), TPOOL_SUCCESS);
+  ASSERT_EQ(tpool_graph_add_edge(graph, a, b), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_graph_run(graph), TPOOL_SUCCESS);
+  EXPECT_EQ(second.runs, 1u);
+  EXPECT_FALSE(second.failed);
+
+  EXPECT_EQ(tpool_graph_destroy(graph), TPOOL_SUCCESS);
+
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolPriority, executes_higher_priorities_first)
+{
+  static std::atomic<bool> may_start;
+  static std::vector<int>  order;
+
+  may_start = false;
+  order.clear();
+
+  tpool_t      * tpool = NULL;
+  tpool_config_t config;
+
+  auto gate = [](void *) { while (!may_start) std::this_thread::sleep_for(std::chrono::milliseconds(1)); };
+  auto log  = [](void * arg) { order.push_back((int) (intptr_t) arg); };
+
+  tpool_config_init(&config, 1);
+  config.priority_aging = 0;
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_add_work_prio(tpool, TPOOL_PRIORITIES_NUMBER, log, NULL), TPOOL_EINVARG);
+
+  ASSERT_EQ(tpool_add_work(tpool, gate, NULL), TPOOL_SUCCESS);
+
+  // let the only thread take the gate, so nothing else is taken with it
+  while (true)
+  {
+    tpool_stats_t stats;
+
+    ASSERT_EQ(tpool_get_stats(tpool, &stats), TPOOL_SUCCESS);
+
+    if (stats.queued[TPOOL_PRIORITY_NORMAL] == 0) break;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  for (intptr_t i = 0; i < 3; i++)
+  {
+    ASSERT_EQ(tpool_add_work_prio(tpool, TPOOL_PRIORITY_LOW,    log, (void *) (20 + i)), TPOOL_SUCCESS);
+    ASSERT_EQ(tpool_add_work_prio(tpool, TPOOL_PRIORITY_NORMAL, log, (void *) (10 + i)), TPOOL_SUCCESS);
+    ASSERT_EQ(tpool_add_work_prio(tpool, TPOOL_PRIORITY_HIGH,   log, (void *) (0  + i)), TPOOL_SUCCESS);
+  }
+
+  tpool_stats_t stats;
+
+  ASSERT_EQ(tpool_get_stats(tpool, &stats), TPOOL_SUCCESS);
+
+  EXPECT_EQ(stats.queued[TPOOL_PRIORITY_HIGH],   3u);
+  EXPECT_EQ(stats.queued[TPOOL_PRIORITY_NORMAL], 3u);
+  EXPECT_EQ(stats.queued[TPOOL_PRIORITY_LOW],    3u);
+
+  may_start = true;
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+
+  EXPECT_EQ(order, std::vector<int>({ 0, 1, 2, 10, 11, 12, 20, 21, 22 }));
+}
+
+TEST(TPoolTimer, handles_invalid_arguments)
+{
+  tpool_t * tpool = NULL;
+
+  auto work = [](void *) {};
+
+  ASSERT_EQ(tpool_create(&tpool, 1), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_add_work_after(NULL,  0, work, NULL, NULL), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_add_work_after(tpool, 0, NULL, NULL, NULL), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_add_work_every(NULL,  1, work, NULL, NULL), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_add_work_every(tpool, 0, work, NULL, NULL), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_add_work_every(tpool, 1, NULL, NULL, NULL), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_timer_cancel(NULL), TPOOL_EINVARG);
+
+  tpool_shutdown(tpool);
+
+  EXPECT_EQ(tpool_add_work_after(tpool, 0, work, NULL, NULL), TPOOL_EREQREJECTED);
+  EXPECT_EQ(tpool_add_work_every(tpool, 1, work, NULL, NULL), TPOOL_EREQREJECTED);
+
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolTimer, executes_works_after_delays)
+{
+  using clock = std::chrono::steady_clock;
+
+  static std::vector<int>   order;
+  static std::atomic<int>   done;
+  static clock::time_point  fired[3];
+
+  order.clear();
+  done = 0;
+
+  tpool_t       * tpool  = NULL;
+  tpool_timer_t * timer  = NULL;
+
+  auto work = [](void * arg)
+    {
+      int i = (int) (intptr_t) arg;
+
+      fired[i] = clock::now();
+      order.push_back(i);
+      done++;
+    };
+
+  auto cancelled = [](void *) { ADD_FAILURE() << "cancelled timer fired"; };
+
+  ASSERT_EQ(tpool_create(&tpool, 1), TPOOL_SUCCESS);
+
+  clock::time_point start = clock::now();
+
+  ASSERT_EQ(tpool_add_work_after(tpool, 30000000, work, (void *) 2, NULL),   TPOOL_SUCCESS);
+  ASSERT_EQ(tpool_add_work_after(tpool, 10000000, work, (void *) 0, NULL),   TPOOL_SUCCESS);
+  ASSERT_EQ(tpool_add_work_after(tpool, 20000000, work, (void *) 1, &timer), TPOOL_SUCCESS);
+
+  tpool_timer_t * doomed = NULL;
+
+  ASSERT_EQ(tpool_add_work_after(tpool, 15000000, cancelled, NULL, &doomed), TPOOL_SUCCESS);
+  EXPECT_EQ(tpool_timer_cancel(doomed), TPOOL_SUCCESS);
+
+  while (done < 3)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  EXPECT_EQ(order, std::vector<int>({ 0, 1, 2 }));
+
+  for (int i = 0; i < 3; i++)
+  {
+    EXPECT_GE(fired[i] - start, std::chrono::milliseconds(10 * (i + 1)));
+  }
+
+  // fired timers with handles are released by cancelling
+  EXPECT_EQ(tpool_timer_cancel(timer), TPOOL_SUCCESS);
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolTimer, executes_works_periodically)
+{
+  static std::atomic<int> ticks, busy_ticks;
+
+  ticks = busy_ticks = 0;
+
+  tpool_t       * tpool = NULL;
+  tpool_timer_t * timer = NULL;
+
+  auto tick      = [](void *) { ticks++; };
+  auto busy_tick = [](void *) { busy_ticks++; };
+
+  ASSERT_EQ(tpool_create(&tpool, 2), TPOOL_SUCCESS);
+
+  ASSERT_EQ(tpool_add_work_every(tpool, 2000000, tick, NULL, &timer), TPOOL_SUCCESS);
+
+  // left till the pool is destroyed
+  ASSERT_EQ(tpool_add_work_every(tpool, 1000000, busy_tick, NULL, NULL), TPOOL_SUCCESS);
+
+  while (ticks < 5)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  EXPECT_EQ(tpool_timer_cancel(timer), TPOOL_SUCCESS);
+
+  int cancelled_at = ticks;
+
+  // keep the pool busy, timers are polled between works
+  auto spin = [](void *) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); };
+
+  int before = busy_ticks;
+
+  for (int i = 0; i < 50; i++)
+  {
+    ASSERT_EQ(tpool_add_work(tpool, spin, NULL), TPOOL_SUCCESS);
+    ASSERT_EQ(tpool_add_work(tpool, spin, NULL), TPOOL_SUCCESS);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  EXPECT_GT(busy_ticks, before);
+
+  // a work enqueued before cancelling may still run
+  EXPECT_LE(ticks, cancelled_at + 1);
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolCancel, skips_cancelled_futures)
+{
+  static std::atomic<bool> may_start;
+  static std::atomic<int>  executed;
+
+  may_start = false;
+  executed  = 0;
+
+  tpool_t        * tpool = NULL;
+  tpool_future_t * kept  = NULL;
+  tpool_future_t * doomed[100];
+
+  auto gate = [](void *) { while (!may_start) std::this_thread::sleep_for(std::chrono::milliseconds(1)); };
+  auto task = [](void * arg) -> void * { executed++; return arg; };
+
+  ASSERT_EQ(tpool_create(&tpool, 1), TPOOL_SUCCESS);
+  ASSERT_EQ(tpool_add_work(tpool, gate, NULL), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_cancel(NULL), TPOOL_EINVARG);
+
+  for (tpool_future_t *& future : doomed)
+  {
+    ASSERT_EQ(tpool_submit(tpool, task, NULL, &future), TPOOL_SUCCESS);
+  }
+
+  ASSERT_EQ(tpool_submit(tpool, task, (void *) 7, &kept), TPOOL_SUCCESS);
+
+  for (tpool_future_t * future : doomed)
+  {
+    void * result = (void *) 1;
+
+    EXPECT_EQ(tpool_cancel(future), TPOOL_SUCCESS);
+    EXPECT_EQ(tpool_cancel(future), TPOOL_SUCCESS);
+
+    // no need to wait for the work to be taken
+    EXPECT_EQ(tpool_future_wait(future, &result),    TPOOL_ECANCELED);
+    EXPECT_EQ(tpool_future_try_get(future, &result), TPOOL_ECANCELED);
+    EXPECT_EQ(result, (void *) 1);
+
+    EXPECT_EQ(tpool_future_release(future), TPOOL_SUCCESS);
+  }
+
+  may_start = true;
+
+  void * result = NULL;
+
+  EXPECT_EQ(tpool_future_wait(kept, &result), TPOOL_SUCCESS);
+  EXPECT_EQ(result, (void *) 7);
+
+  // too late once done
+  EXPECT_EQ(tpool_cancel(kept), TPOOL_EREQREJECTED);
+  EXPECT_EQ(tpool_future_wait(kept, &result), TPOOL_SUCCESS);
+
+  tpool_future_release(kept);
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+
+  EXPECT_EQ(executed, 1);
+}
+
+TEST(TPoolCancel, wakes_up_waiters_of_cancelled_future)
+{
+  static std::atomic<bool> may_start;
+
+  may_start = false;
+
+  tpool_t        * tpool  = NULL;
+  tpool_future_t * future = NULL;
+
+  auto gate = [](void *) { while (!may_start) std::this_thread::sleep_for(std::chrono::milliseconds(1)); };
+  auto task = [](void *) -> void * { ADD_FAILURE() << "cancelled work executed"; return NULL; };
+
+  ASSERT_EQ(tpool_create(&tpool, 1), TPOOL_SUCCESS);
+  ASSERT_EQ(tpool_add_work(tpool, gate, NULL), TPOOL_SUCCESS);
+  ASSERT_EQ(tpool_submit(tpool, task, NULL, &future), TPOOL_SUCCESS);
+
+  std::thread waiter([future]() { EXPECT_EQ(tpool_future_wait(future, NULL), TPOOL_ECANCELED); });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  EXPECT_EQ(tpool_cancel(future), TPOOL_SUCCESS);
+
+  waiter.join();
+
+  tpool_future_release(future);
+
+  may_start = true;
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolCancel, skips_works_of_cancelled_group)
+{
+  static std::atomic<bool> may_start;
+  static std::atomic<int>  executed;
+  static std::atomic<int>  blocked;
+
+  may_start = false;
+  executed  = 0;
+  blocked   = 0;
+
+  tpool_t       * tpool = NULL;
+  tpool_group_t * group = NULL;
+
+  auto gate = [](void *)
+  {
+    blocked++;
+
+    while (!may_start) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  };
+  auto work = [](void *) { executed++; };
+
+  ASSERT_EQ(tpool_create(&tpool, 2), TPOOL_SUCCESS);
+  ASSERT_EQ(tpool_group_create(tpool, &group), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_group_cancel(NULL), TPOOL_EINVARG);
+
+  // one by one, or a worker may grab both gates and leave the other one free
+  for (int i = 1; i <= 2; i++)
+  {
+    ASSERT_EQ(tpool_add_work(tpool, gate, NULL), TPOOL_SUCCESS);
+
+    while (blocked < i) std::this_thread::yield();
+  }
+
+  for (int i = 0; i < 1000; i++)
+  {
+    ASSERT_EQ(tpool_group_add_work(group, work, NULL), TPOOL_SUCCESS);
+  }
+
+  EXPECT_EQ(tpool_group_cancel(group), TPOOL_SUCCESS);
+
+  may_start = true;
+
+  EXPECT_EQ(tpool_group_wait(group), TPOOL_SUCCESS);
+  EXPECT_EQ(executed, 0);
+
+  // the group accepts works again once waited for
+  ASSERT_EQ(tpool_group_add_work(group, work, NULL), TPOOL_SUCCESS);
+  EXPECT_EQ(tpool_group_wait(group), TPOOL_SUCCESS);
+  EXPECT_EQ(executed, 1);
+
+  tpool_group_destroy(group);
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolAffinity, handles_invalid_arguments)
+{
+  tpool_t * tpool = NULL;
+
+  tpool_config_t config;
+
+  tpool_config_init(&config, 2);
+
+  config.affinity = TPOOL_AFFINITY_CPUS;
+
+  EXPECT_EQ(tpool_create_ex(&tpool, &config), TPOOL_EINVARG);
+
+  size_t unusable = CPU_SETSIZE;
+
+  config.cpus        = &unusable;
+  config.cpus_number = 1;
+
+  EXPECT_EQ(tpool_create_ex(&tpool, &config), TPOOL_EINVARG);
+
+  config.affinity = (tpool_affinity_t) 42;
+
+  EXPECT_EQ(tpool_create_ex(&tpool, &config), TPOOL_EINVARG);
+
+  ASSERT_EQ(tpool_create(&tpool, 1), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_nodes_number(tpool), 1u);
+  EXPECT_EQ(tpool_add_work_on_node(NULL, 0, [](void *) {}, NULL), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_add_work_on_node(tpool, 1, [](void *) {}, NULL), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_add_work_on_node(tpool, 0, NULL, NULL),          TPOOL_EINVARG);
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolAffinity, runs_threads_on_given_cpus)
+{
+  static std::atomic<int> executed;
+  static std::atomic<int> misplaced;
+  static size_t           cpu;
+
+  executed  = 0;
+  misplaced = 0;
+
+  cpu_set_t allowed;
+
+  ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+
+  for (cpu = 0; !CPU_ISSET(cpu, &allowed); cpu++) {}
+
+  tpool_t * tpool = NULL;
+
+  tpool_config_t config;
+
+  tpool_config_init(&config, 4);
+
+  config.affinity    = TPOOL_AFFINITY_CPUS;
+  config.cpus        = &cpu;
+  config.cpus_number = 1;
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  auto work = [](void *)
+  {
+    if ((size_t) sched_getcpu() != cpu) misplaced++;
+
+    executed++;
+  };
+
+  for (int i = 0; i < 1000; i++)
+  {
+    ASSERT_EQ(tpool_add_work(tpool, work, NULL), TPOOL_SUCCESS);
+  }
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+
+  EXPECT_EQ(executed,  1000);
+  EXPECT_EQ(misplaced, 0);
+}
+
+TEST(TPoolAffinity, executes_all_works_spread_across_nodes)
+{
+  static std::atomic<int> executed;
+
+  executed = 0;
+
+  tpool_t * tpool = NULL;
+
+  tpool_config_t config;
+
+  tpool_config_init(&config, 4);
+
+  config.affinity = TPOOL_AFFINITY_NUMA;
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  size_t nodes_number = tpool_nodes_number(tpool);
+
+  EXPECT_GE(nodes_number, 1u);
+  EXPECT_LE(nodes_number, 4u);
+
+  auto work = [](void *) { executed++; };
+
+  for (size_t i = 0; i < 1000; i++)
+  {
+    ASSERT_EQ(tpool_add_work_on_node(tpool, i % nodes_number, work, NULL), TPOOL_SUCCESS);
+    ASSERT_EQ(tpool_add_work(tpool, work, NULL), TPOOL_SUCCESS);
+  }
+
+  tpool_shutdown(tpool);
+
+  EXPECT_EQ(tpool_add_work_on_node(tpool, 0, work, NULL), TPOOL_EREQREJECTED);
+
+  tpool_join_then_destroy(tpool);
+
+  EXPECT_EQ(executed, 2000);
+}
+
+TEST(TPoolElastic, handles_invalid_arguments)
+{
+  tpool_t * tpool = NULL;
+
+  tpool_config_t config;
+
+  tpool_config_init(&config, 4);
+
+  config.max_threads_number = 2;
+
+  EXPECT_EQ(tpool_create_ex(&tpool, &config), TPOOL_EINVARG);
+}
+
+static size_t elastic_threads_running(tpool_t * tpool)
+{
+  tpool_stats_t stats;
+
+  EXPECT_EQ(tpool_get_stats(tpool, &stats), TPOOL_SUCCESS);
+
+  return stats.threads_running;
+}
+
+TEST(TPoolElastic, grows_while_works_block_then_shrinks)
+{
+  static std::atomic<bool> may_finish;
+  static std::atomic<int>  started;
+
+  may_finish = false;
+  started    = 0;
+
+  tpool_t * tpool = NULL;
+
+  tpool_config_t config;
+
+  tpool_config_init(&config, 1);
+
+  config.max_threads_number = 4;
+  config.keepalive_ns       = 20000000; // 20 ms
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  EXPECT_EQ(elastic_threads_running(tpool), 1u);
+
+  auto blocking = [](void *)
+  {
+    started++;
+
+    while (!may_finish) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  };
+
+  for (int i = 0; i < 4; i++)
+  {
+    ASSERT_EQ(tpool_add_work(tpool, blocking, NULL), TPOOL_SUCCESS);
+  }
+
+  // all of them block at once, so there is a thread for each one
+  while (started < 4) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  EXPECT_EQ(elastic_threads_running(tpool), 4u);
+
+  may_finish = true;
+
+  while (elastic_threads_running(tpool) > 1) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  // the pool grows again when needed
+  may_finish = false;
+  started    = 0;
+
+  for (int i = 0; i < 4; i++)
+  {
+    ASSERT_EQ(tpool_add_work(tpool, blocking, NULL), TPOOL_SUCCESS);
+  }
+
+  while (started < 4) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  may_finish = true;
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolElastic, executes_all_works_while_resizing)
+{
+  static std::atomic<int> executed;
+
+  executed = 0;
+
+  tpool_t * tpool = NULL;
+
+  tpool_config_t config;
+
+  tpool_config_init(&config, 2);
+
+  config.max_threads_number = 8;
+  config.keepalive_ns       = 1000000; // 1 ms
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  auto work = [](void *)
+  {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+    executed++;
+  };
+
+  for (int round = 0; round < 10; round++)
+  {
+    for (int i = 0; i < 100; i++)
+    {
+      ASSERT_EQ(tpool_add_work(tpool, work, NULL), TPOOL_SUCCESS);
+    }
+
+    // long enough for extra threads to retire
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+
+  EXPECT_EQ(executed, 1000);
+}
+
+TEST(TPoolStack, handles_invalid_arguments)
+{
+  tpool_t * tpool = NULL;
+
+  tpool_config_t config;
+
+  tpool_config_init(&config, 2);
+
+  EXPECT_GT(config.stack_size, 0u);
+  EXPECT_EQ(config.stacks, nullptr);
+
+  config.stack_size = 1;
+
+  EXPECT_EQ(tpool_create_ex(&tpool, &config), TPOOL_EINVARG);
+}
+
+TEST(TPoolStack, runs_threads_on_small_stacks)
+{
+  static std::atomic<int> executed;
+  static std::atomic<int> misplaced;
+  static size_t           stack_size;
+  static size_t           default_size;
+
+  executed   = 0;
+  misplaced  = 0;
+  stack_size = 4 * PTHREAD_STACK_MIN;
+
+  tpool_t * tpool = NULL;
+
+  tpool_config_t config;
+
+  tpool_config_init(&config, 4);
+
+  default_size      = config.stack_size;
+  config.stack_size = stack_size;
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  auto work = [](void *)
+  {
+    pthread_attr_t attr;
+    size_t         size = 0;
+
+    pthread_getattr_np(pthread_self(), &attr);
+    pthread_attr_getstacksize(&attr, &size);
+    pthread_attr_destroy(&attr);
+
+    // sanitizers may enlarge it
+    if (size < stack_size || size >= default_size) misplaced++;
+
+    executed++;
+  };
+
+  for (int i = 0; i < 100; i++)
+  {
+    ASSERT_EQ(tpool_add_work(tpool, work, NULL), TPOOL_SUCCESS);
+  }
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+
+  EXPECT_EQ(executed,  100);
+  EXPECT_EQ(misplaced, 0);
+}
+
+TEST(TPoolStack, runs_threads_on_given_stacks)
+{
+  static std::atomic<int> executed;
+  static std::atomic<int> misplaced;
+  static char *           stacks;
+  static size_t           stacks_size;
+
+  const size_t threads_number = 4;
+  const size_t stack_size     = 1 << 20; // enough for sanitizers too
+
+  executed    = 0;
+  misplaced   = 0;
+  stacks_size = threads_number * stack_size;
+  stacks      = (char *) aligned_alloc(4096, stacks_size);
+
+  ASSERT_NE(stacks, nullptr);
+
+  tpool_t * tpool = NULL;
+
+  tpool_config_t config;
+
+  tpool_config_init(&config, threads_number);
+
+  config.stack_size = stack_size;
+  config.stacks     = stacks;
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  auto work = [](void *)
+  {
+    char local = 0;
+
+    if (&local < stacks || &local >= stacks + stacks_size) misplaced++;
+
+    executed++;
+  };
+
+  for (int i = 0; i < 100; i++)
+  {
+    ASSERT_EQ(tpool_add_work(tpool, work, NULL), TPOOL_SUCCESS);
+  }
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+
+  free(stacks);
+
+  EXPECT_EQ(executed,  100);
+  EXPECT_EQ(misplaced, 0);
+}
+
+static size_t histogram_total(const tpool_histogram_t & histogram)
+{
+  size_t total = 0;
+
+  for (size_t count : histogram.buckets) total += count;
+
+  return total;
+}
+
+TEST(TPoolMetrics, counts_executed_works)
+{
+  tpool_t * tpool = NULL;
+
+  tpool_stats_t        stats;
+  tpool_worker_stats_t worker_stats;
+
+  ASSERT_EQ(tpool_create(&tpool, 4), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_get_worker_stats(NULL, 0, &worker_stats), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_get_worker_stats(tpool, 4, &worker_stats), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_get_worker_stats(tpool, 0, NULL),          TPOOL_EINVARG);
+
+  for (size_t i = 0; i < 1000; i++)
+  {
+    ASSERT_EQ(tpool_add_work(tpool, [](void *) {}, NULL), TPOOL_SUCCESS);
+  }
+
+  tpool_shutdown(tpool);
+  tpool_join(tpool);
+
+  ASSERT_EQ(tpool_get_stats(tpool, &stats), TPOOL_SUCCESS);
+
+  EXPECT_EQ(stats.executed, 1000u);
+
+  size_t executed = 0;
+
+  for (size_t i = 0; i < 4; i++)
+  {
+    ASSERT_EQ(tpool_get_worker_stats(tpool, i, &worker_stats), TPOOL_SUCCESS);
+
+    executed += worker_stats.executed;
+  }
+
+  EXPECT_EQ(executed, 1000u);
+
+  // measured with metrics on only
+  EXPECT_EQ(stats.running_ns, 0u);
+  EXPECT_EQ(stats.idle_ns,    0u);
+  EXPECT_EQ(histogram_total(stats.waited), 0u);
+  EXPECT_EQ(histogram_total(stats.ran),    0u);
+
+  tpool_destroy(tpool);
+}
+
+TEST(TPoolMetrics, measures_waits_and_runs)
+{
+  tpool_t * tpool = NULL;
+
+  tpool_stats_t  stats;
+  tpool_config_t config;
+
+  tpool_config_init(&config, 1);
+
+  config.metrics = true;
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  auto nap = [](void *) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); };
+
+  for (size_t i = 0; i < 20; i++)
+  {
+    ASSERT_EQ(tpool_add_work(tpool, nap, NULL), TPOOL_SUCCESS);
+  }
+
+  tpool_shutdown(tpool);
+  tpool_join(tpool);
+
+  ASSERT_EQ(tpool_get_stats(tpool, &stats), TPOOL_SUCCESS);
+
+  EXPECT_EQ(stats.executed, 20u);
+  EXPECT_EQ(histogram_total(stats.waited), 20u);
+  EXPECT_EQ(histogram_total(stats.ran),    20u);
+
+  EXPECT_GE(stats.running_ns, 20000000u);
+
+  // none of them ran for less than a millisecond
+  for (size_t i = 0; i < 19; i++)
+  {
+    EXPECT_EQ(stats.ran.buckets[i], 0u);
+  }
+
+  // the last one waited for the others to run
+  size_t waited_long = 0;
+
+  for (size_t i = 24; i < TPOOL_HISTOGRAM_BUCKETS; i++)
+  {
+    waited_long += stats.waited.buckets[i];
+  }
+
+  EXPECT_GE(waited_long, 1u);
+
+  tpool_destroy(tpool);
+}
+
+TEST(TPoolMetrics, measures_works_submitted_every_way)
+{
+  static tpool_t * tpool;
+
+  tpool_stats_t  stats;
+  tpool_config_t config;
+
+  tpool_config_init(&config, 2);
+
+  config.metrics = true;
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  std::vector<tpool_work_t> works(200, tpool_work_t { [](void *) {}, NULL });
+
+  ASSERT_EQ(tpool_add_works(tpool, works.data(), works.size()), TPOOL_SUCCESS);
+
+  // spawned ones go to the worker's own deque
+  auto spawner = [](void *)
+  {
+    tpool_work_t spawned[2] = { { [](void *) {}, NULL }, { [](void *) {}, NULL } };
+
+    tpool_add_work(tpool, [](void *) {}, NULL);
+    tpool_add_works(tpool, spawned, 2);
+  };
+
+  for (size_t i = 0; i < 100; i++)
+  {
+    ASSERT_EQ(tpool_add_work_prio(tpool, TPOOL_PRIORITY_HIGH, spawner, NULL), TPOOL_SUCCESS);
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  tpool_shutdown(tpool);
+  tpool_join(tpool);
+
+  ASSERT_EQ(tpool_get_stats(tpool, &stats), TPOOL_SUCCESS);
+
+  EXPECT_EQ(stats.executed, 600u);
+  EXPECT_EQ(histogram_total(stats.waited), 600u);
+  EXPECT_EQ(histogram_total(stats.ran),    600u);
+
+  tpool_destroy(tpool);
+}
+
+static std::string trace_dump(tpool_t * tpool)
+{
+  FILE * file = tmpfile();
+
+  EXPECT_NE(file, nullptr);
+  EXPECT_EQ(tpool_trace_dump(tpool, fileno(file)), TPOOL_SUCCESS);
+
+  std::string trace;
+
+  char buffer[4096];
+
+  rewind(file);
+
+  for (size_t n; (n = fread(buffer, 1, sizeof(buffer), file)) > 0; ) trace.append(buffer, n);
+
+  fclose(file);
+
+  return trace;
+}
+
+static size_t occurrences(const std::string & text, const std::string & pattern)
+{
+  size_t count = 0;
+
+  for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1)) count++;
+
+  return count;
+}
+
+static void traced_routine(void *) {}
+
+TEST(TPoolTrace, invalid_arguments)
+{
+  tpool_t * tpool = NULL;
+
+  ASSERT_EQ(tpool_create(&tpool, 1), TPOOL_SUCCESS);
+
+  EXPECT_EQ(tpool_trace_dump(NULL, STDOUT_FILENO), TPOOL_EINVARG);
+  EXPECT_EQ(tpool_trace_dump(tpool, -1),           TPOOL_EINVARG);
+
+  tpool_shutdown(tpool);
+  tpool_join_then_destroy(tpool);
+}
+
+TEST(TPoolTrace, writes_no_events_unless_configured)
+{
+  tpool_t * tpool = NULL;
+
+  ASSERT_EQ(tpool_create(&tpool, 2), TPOOL_SUCCESS);
+
+  for (size_t i = 0; i < 10; i++)
+  {
+    ASSERT_EQ(tpool_add_work(tpool, traced_routine, NULL), TPOOL_SUCCESS);
+  }
+
+  tpool_shutdown(tpool);
+  tpool_join(tpool);
+
+  std::string trace = trace_dump(tpool);
+
+  EXPECT_EQ(trace.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0), 0u);
+  EXPECT_EQ(trace.substr(trace.size() - 4), "\n]}\n");
+  EXPECT_EQ(occurrences(trace, "\"ph\":\"B\""), 0u);
+
+  tpool_destroy(tpool);
+}
+
+TEST(TPoolTrace, records_submits_starts_and_ends)
+{
+  static tpool_t * tpool;
+
+  tpool_config_t config;
+
+  tpool_config_init(&config, 2);
+
+  config.trace_capacity = 1024;
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  // 100 from outside, 100 more from inside
+  for (size_t i = 0; i < 100; i++)
+  {
+    auto spawner = [](void *) { tpool_add_work(tpool, traced_routine, NULL); };
+
+    ASSERT_EQ(tpool_add_work(tpool, spawner, NULL), TPOOL_SUCCESS);
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  tpool_shutdown(tpool);
+  tpool_join(tpool);
+
+  std::string trace = trace_dump(tpool);
+
+  EXPECT_EQ(occurrences(trace, "\"ph\":\"i\""), 200u);
+  EXPECT_EQ(occurrences(trace, "\"ph\":\"B\""), 200u);
+  EXPECT_EQ(occurrences(trace, "\"ph\":\"E\""), 200u);
+
+  char name[64];
+
+  snprintf(name, sizeof(name), "\"name\":\"%p\",\"cat\":\"work\",\"ph\":\"B\"", (void *) traced_routine);
+
+  EXPECT_EQ(occurrences(trace, name), 100u);
+
+  EXPECT_EQ(occurrences(trace, "\"name\":\"worker 1\""),      1u);
+  EXPECT_EQ(occurrences(trace, "\"name\":\"other threads\""), 1u);
+
+  tpool_destroy(tpool);
+}
+
+TEST(TPoolTrace, keeps_latest_events_and_dumps_while_running)
+{
+  tpool_t * tpool = NULL;
+
+  tpool_config_t config;
+
+  tpool_config_init(&config, 2);
+
+  config.trace_capacity = 16;
+
+  ASSERT_EQ(tpool_create_ex(&tpool, &config), TPOOL_SUCCESS);
+
+  std::thread submitter([tpool]
+  {
+    for (size_t i = 0; i < 10000; i++)
+    {
+      tpool_add_work(tpool, traced_routine, NULL);
+    }
+  });
+
+  for (size_t i = 0; i < 10; i++)
+  {
+    std::string trace = trace_dump(tpool);
+
+    EXPECT_EQ(trace.substr(trace.size() - 4), "\n]}\n");
+    EXPECT_LE(occurrences(trace, "\"ph\":\"i\""), 16u);
+  }
+
+  submitter.join();
+
+  tpool_shutdown(tpool);
+  tpool_join(tpool);
+
+  std::string trace = trace_dump(tpool);
+
+  EXPECT_EQ(occurrences(trace, "\"ph\":\"i\""), 16u);
+  EXPECT_LE(occurrences(trace, "\"ph\":\"B\""), 2u * 8);
+
+  tpool_destroy(tpool);
+}
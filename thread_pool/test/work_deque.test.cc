@@ -0,0 +1,159 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+extern "C"
+{
+  #include "work_deque.h"
+}
+
+/******************************************************/
+
+static void dummy_work_routine(void *)
+{
+  // nothing
+}
+
+static work_t DequeWork(size_t n)
+{
+  return work_t { dummy_work_routine, (void *) n };
+}
+
+/******************************************************/
+
+TEST(WorkDeque, creates_empty_deque)
+{
+  work_t temp;
+  work_deque_t * deque = work_deque_create();
+
+  ASSERT_NE(deque, nullptr);
+
+  EXPECT_TRUE(work_deque_is_empty(deque));
+  EXPECT_EQ(work_deque_pop(deque, &temp),   E_UNDERFLOW);
+  EXPECT_EQ(work_deque_steal(deque, &temp), E_UNDERFLOW);
+
+  work_deque_destroy(deque);
+}
+
+TEST(WorkDeque, owner_pops_in_lifo_thieves_steal_in_fifo)
+{
+  work_t temp;
+  work_deque_t * deque = work_deque_create();
+
+  ASSERT_NE(deque, nullptr);
+
+  for (size_t i = 0; i < 4; i++)
+  {
+    work_t work = DequeWork(i);
+    EXPECT_EQ(work_deque_push(deque, &work), E_OK);
+  }
+
+  EXPECT_EQ(work_deque_pop(deque, &temp), E_OK);
+  EXPECT_EQ(temp.arg, (void *) 3);
+
+  EXPECT_EQ(work_deque_steal(deque, &temp), E_OK);
+  EXPECT_EQ(temp.arg, (void *) 0);
+
+  EXPECT_EQ(work_deque_pop(deque, &temp), E_OK);
+  EXPECT_EQ(temp.arg, (void *) 2);
+
+  EXPECT_EQ(work_deque_steal(deque, &temp), E_OK);
+  EXPECT_EQ(temp.arg, (void *) 1);
+
+  EXPECT_TRUE(work_deque_is_empty(deque));
+
+  work_deque_destroy(deque);
+}
+
+TEST(WorkDeque, grows_preserving_works)
+{
+  const size_t WORKS_NO = 1000;
+
+  work_t temp;
+  work_deque_t * deque = work_deque_create();
+
+  ASSERT_NE(deque, nullptr);
+
+  for (size_t i = 0; i < WORKS_NO; i++)
+  {
+    work_t work = DequeWork(i);
+    ASSERT_EQ(work_deque_push(deque, &work), E_OK);
+  }
+
+  for (size_t i = 0; i < WORKS_NO / 2; i++)
+  {
+    EXPECT_EQ(work_deque_steal(deque, &temp), E_OK);
+    EXPECT_EQ(temp.arg, (void *) i);
+  }
+
+  for (size_t i = WORKS_NO; i > WORKS_NO / 2; i--)
+  {
+    EXPECT_EQ(work_deque_pop(deque, &temp), E_OK);
+    EXPECT_EQ(temp.arg, (void *) (i - 1));
+  }
+
+  EXPECT_TRUE(work_deque_is_empty(deque));
+
+  work_deque_destroy(deque);
+}
+
+TEST(WorkDeque, every_work_is_taken_once_under_stealing)
+{
+  const size_t THIEVES_NO = 3;
+  const size_t WORKS_NO   = 100000;
+
+  work_deque_t * deque = work_deque_create();
+
+  ASSERT_NE(deque, nullptr);
+
+  std::vector<std::atomic<int>> seen(WORKS_NO);
+  std::vector<std::thread> thieves;
+  std::atomic<bool> done { false };
+
+  for (size_t t = 0; t < THIEVES_NO; t++)
+  {
+    thieves.emplace_back([&]() {
+      work_t temp;
+
+      while (!done || !work_deque_is_empty(deque))
+      {
+        if (work_deque_steal(deque, &temp) == E_OK)
+        {
+          seen[(size_t) temp.arg]++;
+        }
+      }
+    });
+  }
+
+  for (size_t i = 0; i < WORKS_NO; i++)
+  {
+    work_t work = DequeWork(i);
+    ASSERT_EQ(work_deque_push(deque, &work), E_OK);
+
+    if (i % 3 == 0)
+    {
+      work_t temp;
+
+      if (work_deque_pop(deque, &temp) == E_OK)
+      {
+        seen[(size_t) temp.arg]++;
+      }
+    }
+  }
+
+  done = true;
+
+  for (auto & thief : thieves)
+  {
+    thief.join();
+  }
+
+  for (size_t i = 0; i < WORKS_NO; i++)
+  {
+    EXPECT_EQ(seen[i], 1);
+  }
+
+  work_deque_destroy(deque);
+}
@@ -1,6 +1,9 @@
 #include "gtest/gtest.h"
 
+#include <atomic>
+#include <chrono>
 #include <thread>
+#include <vector>
 
 extern "C"
 {
@@ -239,3 +242,448 @@ TEST_F(WorkQueue, returns_works_before_stop_accepting)
   work_queue_destroy(queue);
 }
 
+
+TEST_F(WorkQueue, lockfree_preserves_fifo)
+{
+  work_t temp;
+  work_queue_t * queue = work_queue_create_lockfree(16);
+
+  ASSERT_NE(queue, nullptr);
+
+  EXPECT_EQ(work_queue_pop(queue, &temp), E_UNDERFLOW);
+
+  for (size_t tries = 0; tries < 10; tries++)
+  {
+    for (size_t i = 0; i < 11; i++)
+    {
+      EXPECT_EQ(work_queue_push(queue, DummyWork(tries * 11 + i)), E_OK);
+    }
+
+    for (size_t i = 0; i < 11; i++)
+    {
+      EXPECT_EQ(work_queue_pop(queue, &temp), E_OK);
+      EXPECT_EQ(*DummyWork(tries * 11 + i), temp);
+    }
+  }
+
+  work_queue_destroy(queue);
+}
+
+TEST_F(WorkQueue, lockfree_overflows_when_full)
+{
+  work_t temp;
+  work_queue_t * queue = work_queue_create_lockfree(4);
+
+  ASSERT_NE(queue, nullptr);
+
+  for (size_t i = 0; i < 4; i++)
+  {
+    EXPECT_EQ(work_queue_push(queue, DummyWork(i)), E_OK);
+  }
+
+  EXPECT_EQ(work_queue_push(queue, DummyWork(4)), E_OVERFLOW);
+
+  EXPECT_EQ(work_queue_pop(queue, &temp), E_OK);
+  EXPECT_EQ(*DummyWork(0), temp);
+
+  EXPECT_EQ(work_queue_push(queue, DummyWork(4)), E_OK);
+
+  work_queue_destroy(queue);
+}
+
+TEST_F(WorkQueue, lockfree_returns_works_before_stop_accepting)
+{
+  work_t temp;
+  work_queue_t * queue = work_queue_create_lockfree(16);
+
+  ASSERT_NE(queue, nullptr);
+
+  ASSERT_EQ(work_queue_push(queue, DummyWork(0)), E_OK);
+
+  work_queue_stop_accepting(queue);
+
+  EXPECT_EQ(work_queue_push(queue, DummyWork(1)), E_BADREQ);
+
+  EXPECT_EQ(work_queue_pop(queue, &temp), E_OK);
+  EXPECT_EQ(temp, *DummyWork(0));
+
+  EXPECT_EQ(work_queue_pop(queue, &temp), E_BADREQ);
+
+  work_queue_destroy(queue);
+}
+
+TEST_F(WorkQueue, lockfree_delivers_every_work_once_under_contention)
+{
+  const size_t THREADS_NO = 4;
+  const size_t PER_THREAD = 20000;
+
+  work_queue_t * queue = work_queue_create_lockfree(64);
+
+  ASSERT_NE(queue, nullptr);
+
+  std::vector<std::atomic<int>> seen(THREADS_NO * PER_THREAD);
+  std::vector<std::thread> threads;
+
+  for (size_t t = 0; t < THREADS_NO; t++)
+  {
+    threads.emplace_back([&, t]() {
+      for (size_t i = 0; i < PER_THREAD; i++)
+      {
+        work_t work = { dummy_work_routine, (void *) (t * PER_THREAD + i) };
+
+        while (work_queue_push(queue, &work) == E_OVERFLOW)
+        {
+          std::this_thread::yield();
+        }
+      }
+    });
+
+    threads.emplace_back([&]() {
+      work_t temp;
+      err_t  err;
+
+      while ((err = work_queue_pop(queue, &temp)) != E_BADREQ)
+      {
+        if (err == E_OK)
+        {
+          seen[(size_t) temp.arg]++;
+        }
+        else
+        {
+          work_queue_wait_while_no_work(queue);
+        }
+      }
+    });
+  }
+
+  for (size_t t = 0; t < THREADS_NO; t++)
+  {
+    threads[2 * t].join();
+  }
+
+  work_queue_stop_accepting(queue);
+
+  for (size_t t = 0; t < THREADS_NO; t++)
+  {
+    threads[2 * t + 1].join();
+  }
+
+  for (size_t i = 0; i < seen.size(); i++)
+  {
+    EXPECT_EQ(seen[i], 1);
+  }
+
+  work_queue_destroy(queue);
+}
+
+TEST_F(WorkQueue, pushes_batch_in_order)
+{
+  work_t temp;
+  size_t pushed = 0;
+
+  for (auto create : { +[]() { return work_queue_create(); },
+                       +[]() { return work_queue_create_lockfree(64); } })
+  {
+    work_queue_t * queue = create();
+
+    ASSERT_NE(queue, nullptr);
+
+    EXPECT_EQ(work_queue_push_n(queue, DummyWork(0), 10, &pushed), E_OK);
+    EXPECT_EQ(pushed, 10);
+
+    for (size_t i = 0; i < 10; i++)
+    {
+      EXPECT_EQ(work_queue_pop(queue, &temp), E_OK);
+      EXPECT_EQ(*DummyWork(i), temp);
+    }
+
+    EXPECT_EQ(work_queue_pop(queue, &temp), E_UNDERFLOW);
+
+    work_queue_stop_accepting(queue);
+
+    EXPECT_EQ(work_queue_push_n(queue, DummyWork(0), 10, &pushed), E_BADREQ);
+    EXPECT_EQ(pushed, 0);
+
+    work_queue_destroy(queue);
+  }
+}
+
+TEST_F(WorkQueue, lockfree_pushes_batch_partially_when_full)
+{
+  size_t pushed = 0;
+
+  work_queue_t * queue = work_queue_create_lockfree(8);
+
+  ASSERT_NE(queue, nullptr);
+
+  EXPECT_EQ(work_queue_push_n(queue, DummyWork(0), 10, &pushed), E_OVERFLOW);
+  EXPECT_EQ(pushed, 8);
+
+  work_queue_destroy(queue);
+}
+
+TEST_F(WorkQueue, pops_batch_in_order)
+{
+  work_t temp[8];
+  size_t popped = 0;
+
+  for (auto create : { +[]() { return work_queue_create(); },
+                       +[]() { return work_queue_create_lockfree(64); } })
+  {
+    work_queue_t * queue = create();
+
+    ASSERT_NE(queue, nullptr);
+
+    EXPECT_EQ(work_queue_pop_n(queue, temp, 8, &popped), E_UNDERFLOW);
+    EXPECT_EQ(popped, 0);
+
+    for (size_t i = 0; i < 10; i++)
+    {
+      ASSERT_EQ(work_queue_push(queue, DummyWork(i)), E_OK);
+    }
+
+    EXPECT_EQ(work_queue_size(queue), 10);
+
+    EXPECT_EQ(work_queue_pop_n(queue, temp, 8, &popped), E_OK);
+    EXPECT_EQ(popped, 8);
+
+    for (size_t i = 0; i < 8; i++)
+    {
+      EXPECT_EQ(*DummyWork(i), temp[i]);
+    }
+
+    EXPECT_EQ(work_queue_size(queue), 2);
+
+    work_queue_stop_accepting(queue);
+
+    EXPECT_EQ(work_queue_pop_n(queue, temp, 8, &popped), E_OK);
+    EXPECT_EQ(popped, 2);
+
+    EXPECT_EQ(*DummyWork(8), temp[0]);
+    EXPECT_EQ(*DummyWork(9), temp[1]);
+
+    EXPECT_EQ(work_queue_pop_n(queue, temp, 8, &popped), E_BADREQ);
+    EXPECT_EQ(popped, 0);
+
+    work_queue_destroy(queue);
+  }
+}
+
+TEST_F(WorkQueue, pushing_wakes_up_one_waiter_per_work)
+{
+  const size_t WAITERS_NO = 4;
+
+  work_queue_t * queue = work_queue_create();
+
+  ASSERT_NE(queue, nullptr);
+
+  std::atomic<size_t> woken { 0 };
+  std::vector<std::thread> waiters;
+
+  for (size_t i = 0; i < WAITERS_NO; i++)
+  {
+    waiters.emplace_back([&]() {
+      work_queue_wait_while_no_work(queue);
+      woken++;
+    });
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(woken, 0);
+
+  ASSERT_EQ(work_queue_push(queue, DummyWork(0)), E_OK);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  // the woken one has not popped the work, so nobody else parks
+  EXPECT_EQ(woken, 1);
+
+  work_queue_stop_accepting(queue);
+
+  for (auto & waiter : waiters)
+  {
+    waiter.join();
+  }
+
+  EXPECT_EQ(woken, WAITERS_NO);
+
+  work_queue_destroy(queue);
+}
+
+TEST_F(WorkQueue, pops_higher_priorities_first)
+{
+  work_t temp[8];
+  size_t pushed = 0, popped = 0;
+
+  for (auto create : { +[]() { return work_queue_create(); },
+                       +[]() { return work_queue_create_lockfree(64); } })
+  {
+    work_queue_t * queue = create();
+
+    ASSERT_NE(queue, nullptr);
+
+    // works 0..2 are low, 3..5 are normal, 6..7 are high
+    EXPECT_EQ(work_queue_push_n_prio(queue, TPOOL_PRIORITY_LOW,    DummyWork(0), 3, &pushed), E_OK);
+    EXPECT_EQ(work_queue_push_n_prio(queue, TPOOL_PRIORITY_NORMAL, DummyWork(3), 3, &pushed), E_OK);
+    EXPECT_EQ(work_queue_push_n_prio(queue, TPOOL_PRIORITY_HIGH,   DummyWork(6), 2, &pushed), E_OK);
+
+    EXPECT_EQ(work_queue_size_of(queue, TPOOL_PRIORITY_LOW),    3);
+    EXPECT_EQ(work_queue_size_of(queue, TPOOL_PRIORITY_NORMAL), 3);
+    EXPECT_EQ(work_queue_size_of(queue, TPOOL_PRIORITY_HIGH),   2);
+    EXPECT_EQ(work_queue_size(queue), 8);
+
+    EXPECT_EQ(work_queue_pop_n(queue, temp, 3, &popped), E_OK);
+    EXPECT_EQ(popped, 3);
+
+    EXPECT_EQ(*DummyWork(6), temp[0]);
+    EXPECT_EQ(*DummyWork(7), temp[1]);
+    EXPECT_EQ(*DummyWork(3), temp[2]);
+
+    EXPECT_EQ(work_queue_pop_n(queue, temp, 8, &popped), E_OK);
+    EXPECT_EQ(popped, 5);
+
+    for (size_t i = 0; i < 5; i++)
+    {
+      EXPECT_EQ(*DummyWork(i < 2 ? 4 + i : i - 2), temp[i]);
+    }
+
+    work_queue_destroy(queue);
+  }
+}
+
+TEST_F(WorkQueue, ages_lower_priorities)
+{
+  work_t temp;
+  size_t pushed = 0;
+
+  for (auto create : { +[]() { return work_queue_create(); },
+                       +[]() { return work_queue_create_lockfree(64); } })
+  {
+    work_queue_t * queue = create();
+
+    ASSERT_NE(queue, nullptr);
+
+    work_queue_set_aging(queue, 4);
+
+    EXPECT_EQ(work_queue_push_n_prio(queue, TPOOL_PRIORITY_HIGH, DummyWork(0), 10, &pushed), E_OK);
+    EXPECT_EQ(work_queue_push_n_prio(queue, TPOOL_PRIORITY_LOW,  DummyWork(10), 2, &pushed), E_OK);
+
+    // every 4th pop serves the low priority first
+    for (size_t i = 1; i <= 12; i++)
+    {
+      EXPECT_EQ(work_queue_pop(queue, &temp), E_OK);
+
+      size_t expected = i % 4 == 0 ? 10 + i / 4 - 1 : i - 1 - i / 4;
+
+      if (i > 8) expected = i - 3; // low ones are drained by then
+
+      EXPECT_EQ(*DummyWork(expected), temp) << "pop " << i;
+    }
+
+    work_queue_destroy(queue);
+  }
+}
+
+TEST_F(WorkQueue, bounded_blocks_pushing_while_full)
+{
+  work_t temp;
+  work_queue_t * queue = work_queue_create_bounded(4);
+
+  ASSERT_NE(queue, nullptr);
+
+  // the capacity is shared by all priorities
+  for (size_t i = 0; i < 4; i++)
+  {
+    size_t pushed = 0;
+
+    EXPECT_EQ(work_queue_push_n_prio(queue, i % 2 ? TPOOL_PRIORITY_HIGH : TPOOL_PRIORITY_LOW,
+                                     DummyWork(i), 1, &pushed), E_OK);
+  }
+
+  std::atomic<bool> pushed { false };
+
+  std::thread pusher([&]
+  {
+    EXPECT_EQ(work_queue_push(queue, DummyWork(4)), E_OK);
+    pushed = true;
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  EXPECT_FALSE(pushed);
+  EXPECT_EQ(work_queue_size(queue), 4u);
+
+  EXPECT_EQ(work_queue_pop(queue, &temp), E_OK);
+
+  pusher.join();
+
+  EXPECT_TRUE(pushed);
+  EXPECT_EQ(work_queue_size(queue), 4u);
+
+  work_queue_destroy(queue);
+}
+
+TEST_F(WorkQueue, bounded_pushes_batches_bigger_than_capacity)
+{
+  const size_t WORKS_NUMBER = 1000;
+
+  work_queue_t * queue = work_queue_create_bounded(8);
+
+  ASSERT_NE(queue, nullptr);
+
+  // the waiter has to be woken up for the works pushed before the queue got full
+  std::thread popper([&]
+  {
+    work_t temp;
+
+    for (size_t i = 0; i < WORKS_NUMBER; i++)
+    {
+      while (work_queue_pop(queue, &temp) != E_OK)
+      {
+        EXPECT_EQ(work_queue_wait_while_no_work(queue), E_OK);
+      }
+
+      EXPECT_EQ(temp, *DummyWork(i));
+    }
+  });
+
+  std::vector<work_t> works;
+
+  for (size_t i = 0; i < WORKS_NUMBER; i++) works.push_back(*DummyWork(i));
+
+  size_t pushed = 0;
+
+  EXPECT_EQ(work_queue_push_n(queue, works.data(), WORKS_NUMBER, &pushed), E_OK);
+  EXPECT_EQ(pushed, WORKS_NUMBER);
+
+  popper.join();
+
+  work_queue_destroy(queue);
+}
+
+TEST_F(WorkQueue, bounded_rejects_blocked_pushes_on_stop_accepting)
+{
+  work_t temp;
+  work_queue_t * queue = work_queue_create_bounded(1);
+
+  ASSERT_NE(queue, nullptr);
+
+  ASSERT_EQ(work_queue_push(queue, DummyWork(0)), E_OK);
+
+  std::thread pusher([&]
+  {
+    EXPECT_EQ(work_queue_push(queue, DummyWork(1)), E_BADREQ);
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  work_queue_stop_accepting(queue);
+
+  pusher.join();
+
+  EXPECT_EQ(work_queue_pop(queue, &temp), E_OK);
+  EXPECT_EQ(temp, *DummyWork(0));
+
+  EXPECT_EQ(work_queue_pop(queue, &temp), E_BADREQ);
+
+  work_queue_destroy(queue);
+}